@@ -0,0 +1,703 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dotcrawl.h"
+#include "rainbow.h"
+#include "blend.h"
+#include "blur.h"
+#include "motion.h"
+#include "packed.h"
+#include "runs.h"
+#include "tiles.h"
+#include "cpu.h"
+
+// Microbenchmarks of the row kernels at every bit depth, the mask kernels and the motion search,
+// run over whole synthetic frames the way the filters run them. Every variant is timed against the
+// scalar kernel of its bit depth and its output is compared with the scalar output byte for byte.
+//
+// Usage: bench [-t seconds] [kernel]
+// Only kernels whose name contains the optional kernel argument are run.
+
+typedef void (*GenericFunc)(void);
+
+// Synthetic YUV 4:4:4 frames with half size chroma planes for the subsampled kernels.
+typedef struct {
+	int width;
+	int height;
+	int bits;
+	int bytesPerSample;
+	uint8_t *y[2]; // current and previous frame
+	uint8_t *u[2];
+	uint8_t *v[2];
+	uint8_t *uHalf[2]; // chroma at half the width and height
+	uint8_t *vHalf[2];
+	uint8_t *motion; // a motion mask of 0 and the maximum value over the checkerboard squares
+	uint8_t *sparse; // a mask of 0 and 255 with one pixel in 1024 set at random
+	uint8_t *dense; // a mask of 0 and 255 with half of the pixels set at random
+	uint8_t *densePacked; // the dense mask packed, with rows of packedRowBytes(width)
+} Frames;
+
+typedef struct {
+	const char *name;
+	const char *isa; // NULL for the scalar kernel
+	GenericFunc kernel; // NULL for the kernels found with select
+	GenericFunc (*select)(int blockSize, int bits, CpuLevel cpu);
+	int bits;
+	int blockSize; // motion search only
+	void (*run)(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp);
+	size_t (*outputSize)(const Frames *frames, int blockSize);
+} Benchmark;
+
+static const struct {
+	const char *name;
+	int width;
+	int height;
+} sizes[] = {
+	{ "SD", 720, 480 },
+	{ "1080p", 1920, 1080 },
+	{ "4K", 3840, 2160 },
+};
+
+static const int depths[] = { 8, 10, 12, 16 };
+
+static uint32_t seed = 1;
+
+static uint8_t randomByte(void) {
+	seed = seed * 1664525 + 1013904223;
+	return seed >> 24;
+}
+
+static uint8_t clampByte(int value) {
+	return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+// Fill a plane of bits-bit samples with a gradient, a checkerboard over part of the frame to trigger
+// the dot crawl test, and noise, shifted right by shift pixels so the previous frame is a moving copy.
+// Samples of more than 8 bits are the 8-bit values scaled up, with noise in the bits below.
+static void fillPlane(uint8_t *dstp, int width, int height, int shift, int chroma, int bits) {
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int sx = x + shift;
+			int value = chroma ? 128 + (sx * 3 + y) % 64 - 32 : 16 + (sx + y * 2) % 200;
+
+			if (((sx >> 5) + (y >> 5)) & 1) {
+				value += ((sx + y) & 1) ? 12 : -12;
+			}
+
+			value = clampByte(value + (randomByte() & 7) - 4);
+
+			if (bits > 8) {
+				((uint16_t *)dstp)[y * width + x] = value << (bits - 8) | ((randomByte() << 8 | randomByte()) & ((1 << (bits - 8)) - 1));
+			}
+			else {
+				dstp[y * width + x] = value;
+			}
+		}
+	}
+}
+
+static void initFrames(Frames *frames, int width, int height, int bits) {
+	int bytesPerSample = bits > 8 ? 2 : 1;
+	size_t size = (size_t)width * height * bytesPerSample;
+	size_t halfSize = (size_t)(width / 2) * (height / 2) * bytesPerSample;
+
+	frames->width = width;
+	frames->height = height;
+	frames->bits = bits;
+	frames->bytesPerSample = bytesPerSample;
+
+	for (int i = 0; i < 2; i++) {
+		int shift = i ? 0 : 2; // the current frame moved 2 pixels to the left
+
+		frames->y[i] = malloc(size);
+		frames->u[i] = malloc(size);
+		frames->v[i] = malloc(size);
+		frames->uHalf[i] = malloc(halfSize);
+		frames->vHalf[i] = malloc(halfSize);
+
+		fillPlane(frames->y[i], width, height, shift, 0, bits);
+		fillPlane(frames->u[i], width, height, shift, 1, bits);
+		fillPlane(frames->v[i], width, height, shift + 7, 1, bits);
+		fillPlane(frames->uHalf[i], width / 2, height / 2, shift / 2, 1, bits);
+		fillPlane(frames->vHalf[i], width / 2, height / 2, shift / 2 + 3, 1, bits);
+	}
+
+	frames->motion = malloc(size);
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int value = ((x >> 5) + (y >> 5)) & 1 ? (1 << bits) - 1 : 0;
+
+			if (bits > 8) {
+				((uint16_t *)frames->motion)[y * width + x] = value;
+			}
+			else {
+				frames->motion[y * width + x] = value;
+			}
+		}
+	}
+
+	frames->sparse = malloc(width * height);
+	frames->dense = malloc(width * height);
+	frames->densePacked = malloc(packedRowBytes(width) * height);
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			frames->sparse[y * width + x] = (randomByte() | randomByte() << 8) < 64 ? 255 : 0;
+			frames->dense[y * width + x] = randomByte() & 1 ? 255 : 0;
+		}
+
+		packMaskRow_c(frames->dense + y * width, frames->densePacked + y * packedRowBytes(width), width);
+	}
+}
+
+static void freeFrames(Frames *frames) {
+	for (int i = 0; i < 2; i++) {
+		free(frames->y[i]);
+		free(frames->u[i]);
+		free(frames->v[i]);
+		free(frames->uHalf[i]);
+		free(frames->vHalf[i]);
+	}
+
+	free(frames->motion);
+	free(frames->sparse);
+	free(frames->dense);
+	free(frames->densePacked);
+}
+
+static size_t lumaSize(const Frames *frames, int blockSize) {
+	return (size_t)frames->width * frames->height * frames->bytesPerSample;
+}
+
+static size_t halfChromaSize(const Frames *frames, int blockSize) {
+	return (size_t)(frames->width / 2) * (frames->height / 2) * frames->bytesPerSample * 2;
+}
+
+static size_t packedSize(const Frames *frames, int blockSize) {
+	return (size_t)packedRowBytes(frames->width) * frames->height;
+}
+
+static size_t tileCountsSize(const Frames *frames, int blockSize) {
+	return (size_t)maskTileCount(frames->width) * frames->height * sizeof(int);
+}
+
+// The number of runs of each row followed by its runs, at most width + 1 ints.
+static size_t runsSize(const Frames *frames, int blockSize) {
+	return (size_t)(frames->width + 2) * frames->height * sizeof(int);
+}
+
+static size_t vectorsSize(const Frames *frames, int blockSize) {
+	int blocksX = (frames->width + blockSize - 1) / blockSize;
+	int blocksY = (frames->height + blockSize - 1) / blockSize;
+	return blocksX * blocksY * sizeof(MotionVector);
+}
+
+// The width of row y of a plane width pixels wide, cut short by 0 to 32 pixels so every length
+// of the scalar tail of the SIMD kernels is run.
+static int tailWidth(int width, int y) {
+	return width - y % 33;
+}
+
+// generateDotCrawlMap, comparing rows lines apart
+static void runDotCrawlLines(const Frames *frames, GenericFunc kernel, uint8_t *dstp, int lines) {
+	DotCrawlRowFunc dotCrawlRow = (DotCrawlRowFunc)kernel;
+	int stride = frames->width * frames->bytesPerSample;
+	const uint8_t *srcp = frames->y[0];
+
+	for (int y = 0; y < frames->height; y++) {
+		const uint8_t *prevp = y >= lines ? srcp - lines * stride : NULL;
+		const uint8_t *nextp = y < frames->height - lines ? srcp + lines * stride : NULL;
+
+		dotCrawlRow(srcp, prevp, nextp, dstp, tailWidth(frames->width, y), 2 << (frames->bits - 8));
+		srcp += stride;
+		dstp += stride;
+	}
+}
+
+static void runDotCrawl(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	runDotCrawlLines(frames, kernel, dstp, 1);
+}
+
+static void runDotCrawlPal(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	runDotCrawlLines(frames, kernel, dstp, 2);
+}
+
+// the defaults of RainbowDetect, scaled to the bit depth as the filter does
+static void initParams(RainbowParams *params, int bits) {
+	params->threshY = 10 << (bits - 8);
+	params->threshU1 = 5 << (bits - 8);
+	params->threshV1 = 5 << (bits - 8);
+	params->threshU2 = 20 << (bits - 8);
+	params->threshV2 = 20 << (bits - 8);
+	initRainbowRanges(params, bits);
+}
+
+// generateRainbowMap with 4:4:4 chroma
+static void runRainbow(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	RainbowRowFunc rainbowRow = (RainbowRowFunc)kernel;
+	RainbowParams params;
+	int stride = frames->width * frames->bytesPerSample;
+
+	initParams(&params, frames->bits);
+
+	for (int y = 0; y < frames->height; y++) {
+		size_t offset = (size_t)y * stride;
+		rainbowRow(frames->y[0] + offset, frames->u[0] + offset, frames->v[0] + offset, frames->u[1] + offset, frames->v[1] + offset,
+			dstp + offset, tailWidth(frames->width, y), &params);
+	}
+}
+
+// generateRainbowMap with 4:2:0 chroma
+static void runRainbowHalf(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	RainbowRowFunc rainbowRow = (RainbowRowFunc)kernel;
+	RainbowParams params;
+	int stride = frames->width * frames->bytesPerSample;
+	int chromaStride = stride / 2;
+
+	initParams(&params, frames->bits);
+
+	for (int y = 0; y < frames->height; y++) {
+		size_t offset = (size_t)y * stride;
+		size_t chromaOffset = (size_t)(y >> 1) * chromaStride;
+		rainbowRow(frames->y[0] + offset, frames->uHalf[0] + chromaOffset, frames->vHalf[0] + chromaOffset,
+			frames->uHalf[1] + chromaOffset, frames->vHalf[1] + chromaOffset, dstp + offset, tailWidth(frames->width, y), &params);
+	}
+}
+
+// blurDots on the luma plane
+static void runBlur(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	BlurRowFunc blurRow = (BlurRowFunc)kernel;
+	int stride = frames->width * frames->bytesPerSample;
+
+	for (int y = 0; y < frames->height; y++) {
+		blurRow(frames->y[0] + (size_t)y * stride, dstp + (size_t)y * stride, tailWidth(frames->width, y));
+	}
+}
+
+// blurDots on both 4:2:0 chroma planes
+static void runBlurHalf(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	BlurRowFunc blurRow = (BlurRowFunc)kernel;
+	int width = frames->width / 2;
+	int stride = width * frames->bytesPerSample;
+	size_t size = (size_t)stride * (frames->height / 2);
+
+	for (int y = 0; y < frames->height / 2; y++) {
+		size_t offset = (size_t)y * stride;
+		blurRow(frames->uHalf[0] + offset, dstp + offset, tailWidth(width, y));
+		blurRow(frames->vHalf[0] + offset, dstp + size + offset, tailWidth(width, y));
+	}
+}
+
+// estimateMotion with the default search range
+static void runMotionSearch(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	MotionSearch search;
+	int width = frames->width;
+	int stride = width * frames->bytesPerSample;
+	int blocksX = (width + blockSize - 1) / blockSize;
+	MotionVector *vectors = (MotionVector *)dstp;
+
+	search.blockSize = blockSize;
+	search.range = 2;
+	initMotionSearch(&search, frames->bits, cpuC);
+	search.sad = (SadFunc)kernel;
+
+	for (int by = 0; by < frames->height; by += blockSize) {
+		estimateMotionRow(frames->y[0], stride, frames->y[1], stride, width, frames->height, by, vectors + (by / blockSize) * blocksX, &search);
+	}
+}
+
+// generateCompensationMap, comparing against the previous frame as the compensated frame
+static void runCompensationError(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	CompensationErrorRowFunc errorRow = (CompensationErrorRowFunc)kernel;
+	int stride = frames->width * frames->bytesPerSample;
+
+	for (int y = 0; y < frames->height; y++) {
+		size_t offset = (size_t)y * stride;
+		errorRow(frames->y[0] + offset, frames->y[1] + offset, dstp + offset, tailWidth(frames->width, y), 16 << (frames->bits - 8));
+	}
+}
+
+// blendFrame on the luma plane
+static void runTemporalBlend(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	TemporalBlendRowFunc blendRow = (TemporalBlendRowFunc)kernel;
+	int stride = frames->width * frames->bytesPerSample;
+
+	for (int y = 0; y < frames->height; y++) {
+		size_t offset = (size_t)y * stride;
+		blendRow(frames->y[0] + offset, frames->y[1] + offset, frames->motion + offset, dstp + offset, tailWidth(frames->width, y));
+	}
+}
+
+// packMask on the dense mask
+static void runPackMask(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	PackMaskRowFunc packRow = (PackMaskRowFunc)kernel;
+	int width = frames->width;
+
+	for (int y = 0; y < frames->height; y++) {
+		packRow(frames->dense + (size_t)y * width, dstp + (size_t)y * packedRowBytes(width), tailWidth(width, y));
+	}
+}
+
+// packMask on the dense mask read as rows of 16-bit samples, half as many as its bytes
+static void runPackMask16(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	PackMaskRowFunc packRow = (PackMaskRowFunc)kernel;
+	int width = frames->width;
+
+	for (int y = 0; y < frames->height; y++) {
+		packRow(frames->dense + (size_t)y * width, dstp + (size_t)y * packedRowBytes(width), tailWidth(width, y) / 2);
+	}
+}
+
+// unpackMask on the packed dense mask
+static void runUnpackMask(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	UnpackMaskRowFunc unpackRow = (UnpackMaskRowFunc)kernel;
+	int width = frames->width;
+
+	for (int y = 0; y < frames->height; y++) {
+		unpackRow(frames->densePacked + (size_t)y * packedRowBytes(width), dstp + (size_t)y * width, tailWidth(width, y));
+	}
+}
+
+// countMaskRow on the dense mask, with the tile counts of every row kept apart
+static void runCountMask(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	CountMaskRowFunc countRow = (CountMaskRowFunc)kernel;
+	int width = frames->width;
+	int *tileCounts = (int *)dstp;
+
+	memset(tileCounts, 0, tileCountsSize(frames, blockSize));
+
+	for (int y = 0; y < frames->height; y++) {
+		countRow(frames->dense + (size_t)y * width, tailWidth(width, y), tileCounts + (size_t)y * maskTileCount(width));
+	}
+}
+
+// maskRuns, with the runs of every row kept apart
+static void runMaskRunsOf(const Frames *frames, GenericFunc kernel, const uint8_t *maskp, uint8_t *dstp) {
+	MaskRunsFunc maskRuns = (MaskRunsFunc)kernel;
+	int width = frames->width;
+	int *runs = (int *)dstp;
+
+	for (int y = 0; y < frames->height; y++) {
+		int *rowRuns = runs + (size_t)y * (width + 2);
+		rowRuns[0] = maskRuns(maskp + (size_t)y * width, tailWidth(width, y), rowRuns + 1);
+	}
+}
+
+static void runMaskRunsSparse(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	runMaskRunsOf(frames, kernel, frames->sparse, dstp);
+}
+
+static void runMaskRunsDense(const Frames *frames, GenericFunc kernel, int blockSize, uint8_t *dstp) {
+	runMaskRunsOf(frames, kernel, frames->dense, dstp);
+}
+
+// The kernels for more than 8 bits are static in their templates, and reached through the select functions
+// at the level of the isa of the benchmark.
+static GenericFunc selectDotCrawl(int blockSize, int bits, CpuLevel cpu) {
+	return (GenericFunc)selectDotCrawlRow(systemNtsc4fsc, bits, cpu);
+}
+
+static GenericFunc selectDotCrawlPal(int blockSize, int bits, CpuLevel cpu) {
+	return (GenericFunc)selectDotCrawlRow(systemPal443, bits, cpu);
+}
+
+static GenericFunc selectRainbow(int blockSize, int bits, CpuLevel cpu) {
+	return (GenericFunc)selectRainbowRow(0, bits, cpu);
+}
+
+static GenericFunc selectRainbowHalf(int blockSize, int bits, CpuLevel cpu) {
+	return (GenericFunc)selectRainbowRow(1, bits, cpu);
+}
+
+static GenericFunc selectBlur(int blockSize, int bits, CpuLevel cpu) {
+	return (GenericFunc)selectBlurRow(0, bits, cpu);
+}
+
+static GenericFunc selectBlurHalf(int blockSize, int bits, CpuLevel cpu) {
+	return (GenericFunc)selectBlurRow(1, bits, cpu);
+}
+
+static GenericFunc selectMotionSearch(int blockSize, int bits, CpuLevel cpu) {
+	return (GenericFunc)selectSad(blockSize, bits, cpu);
+}
+
+static GenericFunc selectCompensationError(int blockSize, int bits, CpuLevel cpu) {
+	return (GenericFunc)selectCompensationErrorRow(bits, cpu);
+}
+
+static GenericFunc selectTemporalBlend(int blockSize, int bits, CpuLevel cpu) {
+	return (GenericFunc)selectTemporalBlendRow(bits, cpu);
+}
+
+#define VARIANT(name, isa, run, size) { #name, #isa, (GenericFunc)name##_##isa, NULL, 8, 0, run, size }
+#define SCALAR(name, run, size) { #name, NULL, (GenericFunc)name##_c, NULL, 8, 0, run, size }
+#define SAD(size, isa) { "motionSearch" #size, #isa, (GenericFunc)sad##size##x##size##_##isa, NULL, 8, size, runMotionSearch, vectorsSize }
+#define SAD_SCALAR(size) { "motionSearch" #size, NULL, (GenericFunc)sad##size##x##size##_c, NULL, 8, size, runMotionSearch, vectorsSize }
+#define RUNS(mask, isa) { "maskRuns" #mask, #isa, (GenericFunc)maskRuns_##isa, NULL, 8, 0, runMaskRuns##mask, runsSize }
+#define RUNS_SCALAR(mask) { "maskRuns" #mask, NULL, (GenericFunc)maskRuns_c, NULL, 8, 0, runMaskRuns##mask, runsSize }
+
+// The scalar kernel of a bit depth and its SSE2 and AVX2 variants. Where the instruction sets are not
+// available the variants are reported unsupported, so they need no UNCROSS_X86 guard.
+#define DEEP(name, select, bits, run, size) \
+	{ #name, NULL, NULL, select, bits, 0, run, size }, \
+	{ #name, "sse2", NULL, select, bits, 0, run, size }, \
+	{ #name, "avx2", NULL, select, bits, 0, run, size }
+// there are no AVX2 SAD kernels for blocks narrower than a register
+#define DEEP_SAD_SSE2(size, bits) \
+	{ "motionSearch" #size, NULL, NULL, selectMotionSearch, bits, size, runMotionSearch, vectorsSize }, \
+	{ "motionSearch" #size, "sse2", NULL, selectMotionSearch, bits, size, runMotionSearch, vectorsSize }
+#define DEEP_SAD(size, bits) \
+	DEEP_SAD_SSE2(size, bits), \
+	{ "motionSearch" #size, "avx2", NULL, selectMotionSearch, bits, size, runMotionSearch, vectorsSize }
+#define DEEP_KERNELS(bits) \
+	DEEP(dotCrawlRow, selectDotCrawl, bits, runDotCrawl, lumaSize), \
+	DEEP(dotCrawlRowPal, selectDotCrawlPal, bits, runDotCrawlPal, lumaSize), \
+	DEEP(rainbowRow, selectRainbow, bits, runRainbow, lumaSize), \
+	DEEP(rainbowRowHalf, selectRainbowHalf, bits, runRainbowHalf, lumaSize), \
+	DEEP(blurRow, selectBlur, bits, runBlur, lumaSize), \
+	DEEP(blurRowHalf, selectBlurHalf, bits, runBlurHalf, halfChromaSize), \
+	DEEP_SAD_SSE2(4, bits), \
+	DEEP_SAD_SSE2(8, bits), \
+	DEEP_SAD(16, bits), \
+	DEEP_SAD(32, bits), \
+	DEEP(compensationErrorRow, selectCompensationError, bits, runCompensationError, lumaSize), \
+	DEEP(temporalBlendRow, selectTemporalBlend, bits, runTemporalBlend, lumaSize)
+
+// Each kernel starts with its scalar reference, followed by its SIMD variants. The kernels of each bit depth
+// are run over frames of that depth.
+static const Benchmark benchmarks[] = {
+	SCALAR(dotCrawlRow, runDotCrawl, lumaSize),
+#ifdef UNCROSS_X86
+	VARIANT(dotCrawlRow, sse2, runDotCrawl, lumaSize),
+	VARIANT(dotCrawlRow, avx2, runDotCrawl, lumaSize),
+#endif
+	SCALAR(dotCrawlRowPal, runDotCrawlPal, lumaSize),
+#ifdef UNCROSS_X86
+	VARIANT(dotCrawlRowPal, sse2, runDotCrawlPal, lumaSize),
+	VARIANT(dotCrawlRowPal, avx2, runDotCrawlPal, lumaSize),
+#endif
+	SCALAR(rainbowRow, runRainbow, lumaSize),
+#ifdef UNCROSS_X86
+	VARIANT(rainbowRow, sse2, runRainbow, lumaSize),
+	VARIANT(rainbowRow, avx2, runRainbow, lumaSize),
+#endif
+	SCALAR(rainbowRowHalf, runRainbowHalf, lumaSize),
+#ifdef UNCROSS_X86
+	VARIANT(rainbowRowHalf, sse2, runRainbowHalf, lumaSize),
+	VARIANT(rainbowRowHalf, avx2, runRainbowHalf, lumaSize),
+#endif
+	SCALAR(blurRow, runBlur, lumaSize),
+#ifdef UNCROSS_X86
+	VARIANT(blurRow, sse2, runBlur, lumaSize),
+	VARIANT(blurRow, avx2, runBlur, lumaSize),
+#endif
+	SCALAR(blurRowHalf, runBlurHalf, halfChromaSize),
+#ifdef UNCROSS_X86
+	VARIANT(blurRowHalf, sse2, runBlurHalf, halfChromaSize),
+	VARIANT(blurRowHalf, avx2, runBlurHalf, halfChromaSize),
+#endif
+	SAD_SCALAR(4),
+#ifdef UNCROSS_X86
+	SAD(4, sse2),
+#endif
+	SAD_SCALAR(8),
+#ifdef UNCROSS_X86
+	SAD(8, sse2),
+#endif
+	SAD_SCALAR(16),
+#ifdef UNCROSS_X86
+	SAD(16, sse2),
+	SAD(16, avx2),
+#endif
+	SAD_SCALAR(32),
+#ifdef UNCROSS_X86
+	SAD(32, sse2),
+	SAD(32, avx2),
+#ifdef UNCROSS_AVX512
+	SAD(32, avx512),
+#endif
+#endif
+	SCALAR(compensationErrorRow, runCompensationError, lumaSize),
+#ifdef UNCROSS_X86
+	VARIANT(compensationErrorRow, sse2, runCompensationError, lumaSize),
+	VARIANT(compensationErrorRow, avx2, runCompensationError, lumaSize),
+#endif
+	SCALAR(temporalBlendRow, runTemporalBlend, lumaSize),
+#ifdef UNCROSS_X86
+	VARIANT(temporalBlendRow, sse2, runTemporalBlend, lumaSize),
+	VARIANT(temporalBlendRow, avx2, runTemporalBlend, lumaSize),
+#endif
+	SCALAR(packMaskRow, runPackMask, packedSize),
+#ifdef UNCROSS_X86
+	VARIANT(packMaskRow, sse2, runPackMask, packedSize),
+	VARIANT(packMaskRow, avx2, runPackMask, packedSize),
+#endif
+	SCALAR(packMaskRow16, runPackMask16, packedSize),
+#ifdef UNCROSS_X86
+	VARIANT(packMaskRow16, sse2, runPackMask16, packedSize),
+#endif
+	SCALAR(unpackMaskRow, runUnpackMask, lumaSize),
+#ifdef UNCROSS_X86
+	VARIANT(unpackMaskRow, sse2, runUnpackMask, lumaSize),
+#endif
+	SCALAR(countMaskRow, runCountMask, tileCountsSize),
+#ifdef UNCROSS_X86
+	VARIANT(countMaskRow, sse2, runCountMask, tileCountsSize),
+	VARIANT(countMaskRow, avx2, runCountMask, tileCountsSize),
+#endif
+	RUNS_SCALAR(Sparse),
+#ifdef UNCROSS_X86
+	RUNS(Sparse, sse2),
+	RUNS(Sparse, avx2),
+#endif
+	RUNS_SCALAR(Dense),
+#ifdef UNCROSS_X86
+	RUNS(Dense, sse2),
+	RUNS(Dense, avx2),
+#endif
+	DEEP_KERNELS(10),
+	DEEP_KERNELS(12),
+	DEEP_KERNELS(16),
+};
+
+#undef VARIANT
+#undef SCALAR
+#undef SAD
+#undef SAD_SCALAR
+#undef RUNS
+#undef RUNS_SCALAR
+#undef DEEP
+#undef DEEP_SAD_SSE2
+#undef DEEP_SAD
+#undef DEEP_KERNELS
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t cycles(void) {
+#ifdef UNCROSS_X86
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+// Kernel suffixes are the names taken by opt, except avx512 for AVX-512BW.
+static int isSupported(const char *isa) {
+	CpuLevel level;
+	return parseCpuLevel(strcmp(isa, "avx512") ? isa : "avx512bw", &level);
+}
+
+static GenericFunc findKernel(const Benchmark *bench) {
+	CpuLevel level = cpuC;
+
+	if (bench->kernel) {
+		return bench->kernel;
+	}
+	if (bench->isa) {
+		parseCpuLevel(bench->isa, &level);
+	}
+
+	return bench->select(bench->blockSize, bench->bits, level);
+}
+
+int main(int argc, char **argv) {
+	double minTime = 0.25;
+	const char *filter = NULL;
+	int mismatches = 0;
+
+	initCpuLevel();
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+			minTime = atof(argv[++i]);
+		}
+		else {
+			filter = argv[i];
+		}
+	}
+
+	printf("%-22s %4s %-6s %-6s %10s %10s %8s  %s\n", "kernel", "bits", "isa", "size", "Mpix/s", "cycles/px", "speedup", "output");
+
+	for (size_t s = 0; s < sizeof sizes / sizeof *sizes; s++) {
+		for (size_t d = 0; d < sizeof depths / sizeof *depths; d++) {
+			Frames frames;
+			double pixels = (double)sizes[s].width * sizes[s].height;
+			uint8_t *reference = NULL;
+			double referenceTime = 0;
+
+			initFrames(&frames, sizes[s].width, sizes[s].height, depths[d]);
+
+			for (size_t b = 0; b < sizeof benchmarks / sizeof *benchmarks; b++) {
+				const Benchmark *bench = &benchmarks[b];
+				size_t size = bench->outputSize(&frames, bench->blockSize);
+				const char *result = "reference";
+
+				if (bench->bits != depths[d] || (filter && !strstr(bench->name, filter))) {
+					continue;
+				}
+				if (bench->isa && !isSupported(bench->isa)) {
+					printf("%-22s %4d %-6s %-6s %10s %10s %8s  %s\n", bench->name, bench->bits, bench->isa, sizes[s].name, "-", "-", "-", "unsupported");
+					continue;
+				}
+
+				GenericFunc kernel = findKernel(bench);
+				uint8_t *dstp = calloc(size, 1);
+
+				// the first run warms up the caches and produces the output to check
+				bench->run(&frames, kernel, bench->blockSize, dstp);
+
+				if (!bench->isa) {
+					free(reference);
+					reference = dstp;
+					dstp = malloc(size);
+				}
+				else if (memcmp(dstp, reference, size)) {
+					result = "MISMATCH";
+					mismatches++;
+				}
+				else {
+					result = "identical";
+				}
+
+				int runs = 0;
+				double start = now();
+				uint64_t startCycles = cycles();
+				double elapsed;
+
+				do {
+					bench->run(&frames, kernel, bench->blockSize, dstp);
+					runs++;
+					elapsed = now() - start;
+				} while (elapsed < minTime);
+
+				double frameTime = elapsed / runs;
+				double cyclesPerPixel = (cycles() - startCycles) / (runs * pixels);
+
+				if (!bench->isa) {
+					referenceTime = frameTime;
+				}
+
+				printf("%-22s %4d %-6s %-6s %10.1f %10.3f %7.2fx  %s\n", bench->name, bench->bits, bench->isa ? bench->isa : "c", sizes[s].name,
+					pixels / frameTime * 1e-6, cyclesPerPixel, referenceTime / frameTime, result);
+
+				free(dstp);
+			}
+
+			free(reference);
+			freeFrames(&frames);
+		}
+	}
+
+	if (mismatches) {
+		printf("%d variants differ from the scalar kernels\n", mismatches);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include "blend.h"
+
+// Scalar references for the blend kernels, also used for the tail of the SIMD kernels.
+// (a + b + 1) >> 1 rounds half up like pavgb and pavgw.
+static void temporalBlendRowRange(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int x, int width) {
+	for (; x < width; x++) {
+		dstp[x] = maskp[x] ? srcp[x] : (srcp[x] + prevp[x] + 1) >> 1;
+	}
+}
+
+static void temporalBlendRowRange16(const uint16_t *srcp, const uint16_t *prevp, const uint16_t *maskp, uint16_t *dstp, int x, int width) {
+	for (; x < width; x++) {
+		dstp[x] = maskp[x] ? srcp[x] : (srcp[x] + prevp[x] + 1) >> 1;
+	}
+}
+
+void temporalBlendRow_c(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width) {
+	temporalBlendRowRange(srcp, prevp, maskp, dstp, 0, width);
+}
+
+void temporalBlendRow16_c(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width) {
+	temporalBlendRowRange16((const uint16_t *)srcp, (const uint16_t *)prevp, (const uint16_t *)maskp, (uint16_t *)dstp, 0, width);
+}
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+void temporalBlendRow_sse2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width) {
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(srcp + x));
+		__m128i p = _mm_loadu_si128((const __m128i *)(prevp + x));
+		__m128i still = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(maskp + x)), zero);
+		__m128i blended = _mm_or_si128(_mm_and_si128(still, _mm_avg_epu8(s, p)), _mm_andnot_si128(still, s));
+
+		_mm_storeu_si128((__m128i *)(dstp + x), blended);
+	}
+
+	temporalBlendRowRange(srcp, prevp, maskp, dstp, x, width);
+}
+
+UNCROSS_TARGET("avx2")
+void temporalBlendRow_avx2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width) {
+	const __m256i zero = _mm256_setzero_si256();
+	int x = 0;
+
+	for (; x + 32 <= width; x += 32) {
+		__m256i s = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		__m256i p = _mm256_loadu_si256((const __m256i *)(prevp + x));
+		__m256i still = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(maskp + x)), zero);
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), _mm256_blendv_epi8(s, _mm256_avg_epu8(s, p), still));
+	}
+
+	temporalBlendRowRange(srcp, prevp, maskp, dstp, x, width);
+}
+
+UNCROSS_TARGET("sse2")
+void temporalBlendRow16_sse2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width) {
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+
+	for (; x + 8 <= width; x += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(srcp + 2 * x));
+		__m128i p = _mm_loadu_si128((const __m128i *)(prevp + 2 * x));
+		__m128i still = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)(maskp + 2 * x)), zero);
+		__m128i blended = _mm_or_si128(_mm_and_si128(still, _mm_avg_epu16(s, p)), _mm_andnot_si128(still, s));
+
+		_mm_storeu_si128((__m128i *)(dstp + 2 * x), blended);
+	}
+
+	temporalBlendRowRange16((const uint16_t *)srcp, (const uint16_t *)prevp, (const uint16_t *)maskp, (uint16_t *)dstp, x, width);
+}
+
+UNCROSS_TARGET("avx2")
+void temporalBlendRow16_avx2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width) {
+	const __m256i zero = _mm256_setzero_si256();
+	int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m256i s = _mm256_loadu_si256((const __m256i *)(srcp + 2 * x));
+		__m256i p = _mm256_loadu_si256((const __m256i *)(prevp + 2 * x));
+		__m256i still = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(maskp + 2 * x)), zero);
+
+		_mm256_storeu_si256((__m256i *)(dstp + 2 * x), _mm256_blendv_epi8(s, _mm256_avg_epu16(s, p), still));
+	}
+
+	temporalBlendRowRange16((const uint16_t *)srcp, (const uint16_t *)prevp, (const uint16_t *)maskp, (uint16_t *)dstp, x, width);
+}
+#endif
+
+// Select the fastest blend kernel for a bit depth (8, 10, 12 or 16) available at the instruction set level cpu.
+TemporalBlendRowFunc selectTemporalBlendRow(int bits, CpuLevel cpu) {
+#ifdef UNCROSS_X86
+	if (cpu >= cpuAVX2) {
+		return bits > 8 ? temporalBlendRow16_avx2 : temporalBlendRow_avx2;
+	}
+	if (cpu >= cpuSSE2) {
+		return bits > 8 ? temporalBlendRow16_sse2 : temporalBlendRow_sse2;
+	}
+#endif
+	return bits > 8 ? temporalBlendRow16_c : temporalBlendRow_c;
+}
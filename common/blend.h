@@ -0,0 +1,26 @@
+#ifndef UNCROSS_BLEND_H
+#define UNCROSS_BLEND_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "simd.h"
+
+// Averages a row with the same row of the previous frame where the mask is 0 and copies it where
+// the mask is set: dst = mask ? src : (src + prev + 1) >> 1. The mask has the sample size of the row.
+// Rows are passed as bytes at every bit depth: kernels for more than 8 bits read and write uint16_t samples,
+// and serve 10, 12 and 16 bits alike.
+typedef void (*TemporalBlendRowFunc)(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width);
+
+void temporalBlendRow_c(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width);
+void temporalBlendRow16_c(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width);
+#ifdef UNCROSS_X86
+void temporalBlendRow_sse2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width);
+void temporalBlendRow_avx2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width);
+void temporalBlendRow16_sse2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width);
+void temporalBlendRow16_avx2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *maskp, uint8_t *dstp, int width);
+#endif
+
+// Select the fastest blend kernel for a bit depth (8, 10, 12 or 16) available at the instruction set level cpu.
+TemporalBlendRowFunc selectTemporalBlendRow(int bits, CpuLevel cpu);
+
+#endif
@@ -0,0 +1,198 @@
+#include "blur.h"
+
+// Scalar reference for the blur row kernel, also used for the tail of the SIMD kernels.
+// The running sum is rounded half up, which matches round() for these non-negative sums.
+static void blurRowRange(const uint8_t *srcp, uint8_t *dstp, int x, int width) {
+	if ((x + 3) < width) {
+		int sum = srcp[x] + srcp[x + 1] + srcp[x + 2] + srcp[x + 3];
+
+		for (; (x + 4) < width; x++) {
+			dstp[x] = (sum + 2) >> 2;
+			sum += srcp[x + 4] - srcp[x];
+		}
+
+		dstp[x] = (sum + 2) >> 2;
+		x++;
+	}
+
+	for (; x < width; x++) {
+		dstp[x] = srcp[x];
+	}
+}
+
+void blurRow_c(const uint8_t *srcp, uint8_t *dstp, int width) {
+	blurRowRange(srcp, dstp, 0, width);
+}
+
+// Scalar reference for the 2-tap kernel, also used for the tail of its SIMD versions.
+// (a + b + 1) >> 1 is the same rounding as the other kernels and matches pavgb.
+static void blurRowHalfRange(const uint8_t *srcp, uint8_t *dstp, int x, int width) {
+	for (; (x + 1) < width; x++) {
+		dstp[x] = (srcp[x] + srcp[x + 1] + 1) >> 1;
+	}
+
+	for (; x < width; x++) {
+		dstp[x] = srcp[x];
+	}
+}
+
+void blurRowHalf_c(const uint8_t *srcp, uint8_t *dstp, int width) {
+	blurRowHalfRange(srcp, dstp, 0, width);
+}
+
+// Scalar mean over any number of taps, for windows narrowed by chroma subsampling.
+// Rounds half up like the 4-tap kernels; the last taps - 1 pixels are copied as is.
+void blurRowTaps_c(const uint8_t *srcp, uint8_t *dstp, int width, int taps) {
+	int x = 0;
+
+	for (; (x + taps - 1) < width; x++) {
+		int sum = 0;
+
+		for (int i = 0; i < taps; i++) {
+			sum += srcp[x + i];
+		}
+
+		dstp[x] = (sum + taps / 2) / taps;
+	}
+
+	for (; x < width; x++) {
+		dstp[x] = srcp[x];
+	}
+}
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+void blurRow_sse2(const uint8_t *srcp, uint8_t *dstp, int width) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i two = _mm_set1_epi16(2);
+	int x = 0;
+
+	// each iteration reads up to srcp[x + 3 + 15]
+	for (; x + 16 + 3 <= width; x += 16) {
+		__m128i p0 = _mm_loadu_si128((const __m128i *)(srcp + x));
+		__m128i p1 = _mm_loadu_si128((const __m128i *)(srcp + x + 1));
+		__m128i p2 = _mm_loadu_si128((const __m128i *)(srcp + x + 2));
+		__m128i p3 = _mm_loadu_si128((const __m128i *)(srcp + x + 3));
+
+		__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(p0, zero), _mm_unpacklo_epi8(p1, zero)),
+			_mm_add_epi16(_mm_unpacklo_epi8(p2, zero), _mm_unpacklo_epi8(p3, zero)));
+		__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(p0, zero), _mm_unpackhi_epi8(p1, zero)),
+			_mm_add_epi16(_mm_unpackhi_epi8(p2, zero), _mm_unpackhi_epi8(p3, zero)));
+
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+
+		_mm_storeu_si128((__m128i *)(dstp + x), _mm_packus_epi16(lo, hi));
+	}
+
+	blurRowRange(srcp, dstp, x, width);
+}
+
+UNCROSS_TARGET("sse2")
+void blurRowHalf_sse2(const uint8_t *srcp, uint8_t *dstp, int width) {
+	int x = 0;
+
+	// each iteration reads up to srcp[x + 1 + 15]
+	for (; x + 16 + 1 <= width; x += 16) {
+		__m128i p0 = _mm_loadu_si128((const __m128i *)(srcp + x));
+		__m128i p1 = _mm_loadu_si128((const __m128i *)(srcp + x + 1));
+
+		_mm_storeu_si128((__m128i *)(dstp + x), _mm_avg_epu8(p0, p1));
+	}
+
+	blurRowHalfRange(srcp, dstp, x, width);
+}
+
+UNCROSS_TARGET("avx2")
+void blurRow_avx2(const uint8_t *srcp, uint8_t *dstp, int width) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i two = _mm256_set1_epi16(2);
+	int x = 0;
+
+	// each iteration reads up to srcp[x + 3 + 31]
+	for (; x + 32 + 3 <= width; x += 32) {
+		__m256i p0 = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		__m256i p1 = _mm256_loadu_si256((const __m256i *)(srcp + x + 1));
+		__m256i p2 = _mm256_loadu_si256((const __m256i *)(srcp + x + 2));
+		__m256i p3 = _mm256_loadu_si256((const __m256i *)(srcp + x + 3));
+
+		// unpack and pack both work within 128-bit lanes, so the byte order is preserved
+		__m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(p0, zero), _mm256_unpacklo_epi8(p1, zero)),
+			_mm256_add_epi16(_mm256_unpacklo_epi8(p2, zero), _mm256_unpacklo_epi8(p3, zero)));
+		__m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(p0, zero), _mm256_unpackhi_epi8(p1, zero)),
+			_mm256_add_epi16(_mm256_unpackhi_epi8(p2, zero), _mm256_unpackhi_epi8(p3, zero)));
+
+		lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+		hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), _mm256_packus_epi16(lo, hi));
+	}
+
+	blurRowRange(srcp, dstp, x, width);
+}
+
+UNCROSS_TARGET("avx2")
+void blurRowHalf_avx2(const uint8_t *srcp, uint8_t *dstp, int width) {
+	int x = 0;
+
+	// each iteration reads up to srcp[x + 1 + 31]
+	for (; x + 32 + 1 <= width; x += 32) {
+		__m256i p0 = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		__m256i p1 = _mm256_loadu_si256((const __m256i *)(srcp + x + 1));
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), _mm256_avg_epu8(p0, p1));
+	}
+
+	blurRowHalfRange(srcp, dstp, x, width);
+}
+#endif
+
+#ifdef UNCROSS_X86
+// Pack unsigned 32-bit values up to 65535 into 16 bits. SSE2 only has the signed pack, so the
+// values are offset into the signed range and back.
+UNCROSS_TARGET("sse2")
+static inline __m128i packus32_sse2(__m128i lo, __m128i hi) {
+	const __m128i offset32 = _mm_set1_epi32(32768);
+	const __m128i offset16 = _mm_set1_epi16(-32768);
+	return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(lo, offset32), _mm_sub_epi32(hi, offset32)), offset16);
+}
+#endif
+
+#define BITS 10
+#include "blur_template.h"
+#undef BITS
+#define BITS 12
+#include "blur_template.h"
+#undef BITS
+#define BITS 16
+#include "blur_template.h"
+#undef BITS
+
+// Select the fastest row kernel for a bit depth (8, 10, 12 or 16) and a plane subsampled
+// horizontally by ssW (0 or 1) available at the instruction set level cpu.
+BlurRowFunc selectBlurRow(int ssW, int bits, CpuLevel cpu) {
+#ifdef UNCROSS_X86
+	if (cpu >= cpuAVX2) {
+		switch (bits) {
+		case 10: return ssW ? blurRowHalf10_avx2 : blurRow10_avx2;
+		case 12: return ssW ? blurRowHalf12_avx2 : blurRow12_avx2;
+		case 16: return ssW ? blurRowHalf16_avx2 : blurRow16_avx2;
+		default: return ssW ? blurRowHalf_avx2 : blurRow_avx2;
+		}
+	}
+	if (cpu >= cpuSSE2) {
+		switch (bits) {
+		case 10: return ssW ? blurRowHalf10_sse2 : blurRow10_sse2;
+		case 12: return ssW ? blurRowHalf12_sse2 : blurRow12_sse2;
+		case 16: return ssW ? blurRowHalf16_sse2 : blurRow16_sse2;
+		default: return ssW ? blurRowHalf_sse2 : blurRow_sse2;
+		}
+	}
+#endif
+	switch (bits) {
+	case 10: return ssW ? blurRowHalf10_c : blurRow10_c;
+	case 12: return ssW ? blurRowHalf12_c : blurRow12_c;
+	case 16: return ssW ? blurRowHalf16_c : blurRow16_c;
+	default: return ssW ? blurRowHalf_c : blurRow_c;
+	}
+}
@@ -0,0 +1,33 @@
+#ifndef UNCROSS_BLUR_H
+#define UNCROSS_BLUR_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "simd.h"
+
+// Blurs one row with a 4-tap horizontal mean. The last 3 pixels have no full window and are copied as is.
+// Rows are passed as bytes at every bit depth: kernels for more than 8 bits read and write uint16_t samples.
+typedef void (*BlurRowFunc)(const uint8_t *srcp, uint8_t *dstp, int width);
+
+void blurRow_c(const uint8_t *srcp, uint8_t *dstp, int width);
+#ifdef UNCROSS_X86
+void blurRow_sse2(const uint8_t *srcp, uint8_t *dstp, int width);
+void blurRow_avx2(const uint8_t *srcp, uint8_t *dstp, int width);
+#endif
+
+// 2-tap mean for chroma at half the luma width, covering the same luma footprint as the 4-tap blur.
+// The last pixel is copied as is.
+void blurRowHalf_c(const uint8_t *srcp, uint8_t *dstp, int width);
+#ifdef UNCROSS_X86
+void blurRowHalf_sse2(const uint8_t *srcp, uint8_t *dstp, int width);
+void blurRowHalf_avx2(const uint8_t *srcp, uint8_t *dstp, int width);
+#endif
+
+// Mean over taps pixels instead of 4, used for horizontally subsampled chroma.
+void blurRowTaps_c(const uint8_t *srcp, uint8_t *dstp, int width, int taps);
+
+// Select the fastest row kernel for a bit depth (8, 10, 12 or 16) and a plane subsampled
+// horizontally by ssW (0 or 1) available at the instruction set level cpu.
+BlurRowFunc selectBlurRow(int ssW, int bits, CpuLevel cpu);
+
+#endif
@@ -0,0 +1,150 @@
+// Blur row kernels for BITS-bit samples stored as uint16_t. Included from blur.c
+// once per bit depth with BITS defined; this file deliberately has no include guard.
+// The sum of 4 samples fits in 16-bit lanes up to 14 bits; 16-bit samples are summed in 32-bit lanes.
+#define KERNEL(name, isa) KERNEL_NAME(name, BITS, isa)
+
+// Scalar reference, also used for the tail of the SIMD kernels.
+static void KERNEL(blurRowRange, c)(const uint16_t *srcp, uint16_t *dstp, int x, int width) {
+	if ((x + 3) < width) {
+		int sum = srcp[x] + srcp[x + 1] + srcp[x + 2] + srcp[x + 3];
+
+		for (; (x + 4) < width; x++) {
+			dstp[x] = (sum + 2) >> 2;
+			sum += srcp[x + 4] - srcp[x];
+		}
+
+		dstp[x] = (sum + 2) >> 2;
+		x++;
+	}
+
+	for (; x < width; x++) {
+		dstp[x] = srcp[x];
+	}
+}
+
+static void KERNEL(blurRowHalfRange, c)(const uint16_t *srcp, uint16_t *dstp, int x, int width) {
+	for (; (x + 1) < width; x++) {
+		dstp[x] = (srcp[x] + srcp[x + 1] + 1) >> 1;
+	}
+
+	for (; x < width; x++) {
+		dstp[x] = srcp[x];
+	}
+}
+
+static void KERNEL(blurRow, c)(const uint8_t *srcp, uint8_t *dstp, int width) {
+	KERNEL(blurRowRange, c)((const uint16_t *)srcp, (uint16_t *)dstp, 0, width);
+}
+
+static void KERNEL(blurRowHalf, c)(const uint8_t *srcp, uint8_t *dstp, int width) {
+	KERNEL(blurRowHalfRange, c)((const uint16_t *)srcp, (uint16_t *)dstp, 0, width);
+}
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+static void KERNEL(blurRow, sse2)(const uint8_t *srcp8, uint8_t *dstp8, int width) {
+	const uint16_t *srcp = (const uint16_t *)srcp8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	int x = 0;
+
+	// each iteration reads up to srcp[x + 3 + 7]
+	for (; x + 8 + 3 <= width; x += 8) {
+		__m128i p0 = _mm_loadu_si128((const __m128i *)(srcp + x));
+		__m128i p1 = _mm_loadu_si128((const __m128i *)(srcp + x + 1));
+		__m128i p2 = _mm_loadu_si128((const __m128i *)(srcp + x + 2));
+		__m128i p3 = _mm_loadu_si128((const __m128i *)(srcp + x + 3));
+
+#if BITS > 14
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi32(2);
+		__m128i lo = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(p0, zero), _mm_unpacklo_epi16(p1, zero)),
+			_mm_add_epi32(_mm_unpacklo_epi16(p2, zero), _mm_unpacklo_epi16(p3, zero)));
+		__m128i hi = _mm_add_epi32(_mm_add_epi32(_mm_unpackhi_epi16(p0, zero), _mm_unpackhi_epi16(p1, zero)),
+			_mm_add_epi32(_mm_unpackhi_epi16(p2, zero), _mm_unpackhi_epi16(p3, zero)));
+
+		lo = _mm_srli_epi32(_mm_add_epi32(lo, two), 2);
+		hi = _mm_srli_epi32(_mm_add_epi32(hi, two), 2);
+
+		_mm_storeu_si128((__m128i *)(dstp + x), packus32_sse2(lo, hi));
+#else
+		__m128i sum = _mm_add_epi16(_mm_add_epi16(p0, p1), _mm_add_epi16(p2, p3));
+
+		_mm_storeu_si128((__m128i *)(dstp + x), _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2));
+#endif
+	}
+
+	KERNEL(blurRowRange, c)(srcp, dstp, x, width);
+}
+
+UNCROSS_TARGET("sse2")
+static void KERNEL(blurRowHalf, sse2)(const uint8_t *srcp8, uint8_t *dstp8, int width) {
+	const uint16_t *srcp = (const uint16_t *)srcp8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	int x = 0;
+
+	// each iteration reads up to srcp[x + 1 + 7]
+	for (; x + 8 + 1 <= width; x += 8) {
+		__m128i p0 = _mm_loadu_si128((const __m128i *)(srcp + x));
+		__m128i p1 = _mm_loadu_si128((const __m128i *)(srcp + x + 1));
+
+		_mm_storeu_si128((__m128i *)(dstp + x), _mm_avg_epu16(p0, p1));
+	}
+
+	KERNEL(blurRowHalfRange, c)(srcp, dstp, x, width);
+}
+
+UNCROSS_TARGET("avx2")
+static void KERNEL(blurRow, avx2)(const uint8_t *srcp8, uint8_t *dstp8, int width) {
+	const uint16_t *srcp = (const uint16_t *)srcp8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	int x = 0;
+
+	// each iteration reads up to srcp[x + 3 + 15]
+	for (; x + 16 + 3 <= width; x += 16) {
+		__m256i p0 = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		__m256i p1 = _mm256_loadu_si256((const __m256i *)(srcp + x + 1));
+		__m256i p2 = _mm256_loadu_si256((const __m256i *)(srcp + x + 2));
+		__m256i p3 = _mm256_loadu_si256((const __m256i *)(srcp + x + 3));
+
+#if BITS > 14
+		// unpack and pack both work within 128-bit lanes, so the sample order is preserved
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i two = _mm256_set1_epi32(2);
+		__m256i lo = _mm256_add_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(p0, zero), _mm256_unpacklo_epi16(p1, zero)),
+			_mm256_add_epi32(_mm256_unpacklo_epi16(p2, zero), _mm256_unpacklo_epi16(p3, zero)));
+		__m256i hi = _mm256_add_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(p0, zero), _mm256_unpackhi_epi16(p1, zero)),
+			_mm256_add_epi32(_mm256_unpackhi_epi16(p2, zero), _mm256_unpackhi_epi16(p3, zero)));
+
+		lo = _mm256_srli_epi32(_mm256_add_epi32(lo, two), 2);
+		hi = _mm256_srli_epi32(_mm256_add_epi32(hi, two), 2);
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), _mm256_packus_epi32(lo, hi));
+#else
+		__m256i sum = _mm256_add_epi16(_mm256_add_epi16(p0, p1), _mm256_add_epi16(p2, p3));
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2));
+#endif
+	}
+
+	KERNEL(blurRowRange, c)(srcp, dstp, x, width);
+}
+
+UNCROSS_TARGET("avx2")
+static void KERNEL(blurRowHalf, avx2)(const uint8_t *srcp8, uint8_t *dstp8, int width) {
+	const uint16_t *srcp = (const uint16_t *)srcp8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	int x = 0;
+
+	// each iteration reads up to srcp[x + 1 + 15]
+	for (; x + 16 + 1 <= width; x += 16) {
+		__m256i p0 = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		__m256i p1 = _mm256_loadu_si256((const __m256i *)(srcp + x + 1));
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), _mm256_avg_epu16(p0, p1));
+	}
+
+	KERNEL(blurRowHalfRange, c)(srcp, dstp, x, width);
+}
+#endif
+
+#undef KERNEL
@@ -0,0 +1,92 @@
+#include <string.h>
+#include "cpu.h"
+#include "simd.h"
+
+static CpuLevel detected = cpuC;
+
+#if defined(UNCROSS_X86) && defined(_MSC_VER)
+// MSVC has no __builtin_cpu_supports, so the feature bits are read with cpuid. AVX2 and AVX-512
+// also need the operating system to save their registers, which XCR0 tells: bits 1 and 2 for
+// the SSE and AVX state, and bits 5 to 7 for the AVX-512 state.
+static CpuLevel detectCpuLevel(void) {
+	int info[4];
+	int maxLeaf;
+	unsigned long long xcr0 = 0;
+
+	__cpuid(info, 0);
+	maxLeaf = info[0];
+	__cpuid(info, 1);
+
+	int sse2 = (info[3] >> 26) & 1;
+	int ssse3 = (info[2] >> 9) & 1;
+	int avx = (info[2] >> 28) & 1;
+
+	// OSXSAVE
+	if ((info[2] >> 27) & 1)
+		xcr0 = _xgetbv(0);
+
+	int avx2 = 0;
+	int avx512bw = 0;
+
+	if (maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] >> 5) & 1;
+		avx512bw = ((info[1] >> 16) & 1) && ((info[1] >> 30) & 1); // AVX-512F and AVX-512BW
+	}
+
+	if (avx && (xcr0 & 0x06) == 0x06) {
+		if (avx2 && avx512bw && (xcr0 & 0xE0) == 0xE0)
+			return cpuAVX512BW;
+		if (avx2)
+			return cpuAVX2;
+	}
+	if (ssse3)
+		return cpuSSSE3;
+	if (sse2)
+		return cpuSSE2;
+	return cpuC;
+}
+#endif
+
+void initCpuLevel(void) {
+#if defined(UNCROSS_X86) && defined(_MSC_VER)
+	detected = detectCpuLevel();
+#elif defined(UNCROSS_X86)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512bw")) {
+		detected = cpuAVX512BW;
+	}
+	else if (__builtin_cpu_supports("avx2")) {
+		detected = cpuAVX2;
+	}
+	else if (__builtin_cpu_supports("ssse3")) {
+		detected = cpuSSSE3;
+	}
+	else if (__builtin_cpu_supports("sse2")) {
+		detected = cpuSSE2;
+	}
+#endif
+}
+
+CpuLevel getCpuLevel(void) {
+	return detected;
+}
+
+int parseCpuLevel(const char *opt, CpuLevel *level) {
+	static const char *names[] = { "c", "sse2", "ssse3", "avx2", "avx512bw" };
+
+	if (!opt || !strcmp(opt, "auto")) {
+		*level = detected;
+		return 1;
+	}
+
+	for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+		if (!strcmp(opt, names[i])) {
+			*level = (CpuLevel)i;
+			return *level <= detected;
+		}
+	}
+
+	return 0;
+}
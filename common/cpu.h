@@ -0,0 +1,26 @@
+#ifndef UNCROSS_CPU_H
+#define UNCROSS_CPU_H
+
+// Instruction set levels, in increasing order. Each level includes the ones below it, and kernels
+// are selected for the highest level they have a variant for, so SSSE3 currently runs the SSE2
+// kernels and AVX-512BW the AVX2 kernels except for the 8-bit SAD of 32-pixel blocks.
+typedef enum {
+	cpuC,
+	cpuSSE2,
+	cpuSSSE3,
+	cpuAVX2,
+	cpuAVX512BW
+} CpuLevel;
+
+// Detect the level of the running CPU. Called once from VapourSynthPluginInit.
+void initCpuLevel(void);
+
+// The level found by initCpuLevel.
+CpuLevel getCpuLevel(void);
+
+// Parse the opt argument of a filter: NULL or "auto" for the detected level, or one of "c", "sse2",
+// "ssse3", "avx2" and "avx512bw" to force that path. Returns 0 for other names and for levels the
+// running CPU does not support.
+int parseCpuLevel(const char *opt, CpuLevel *level);
+
+#endif
@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include <VSHelper.h>
+#include "dotcrawl.h"
+
+#ifdef UNCROSS_X86
+// Per pixel, the test is |a - c| - |c - e| < threshold over bytes a, c, e one stencil step apart.
+// With d1 = |a - c| and d2 = |c - e| this is d1 < d2 for a zero threshold, or
+// sat(d1 - d2) <= threshold - 1 otherwise, both of which fit in unsigned bytes.
+UNCROSS_TARGET("sse2")
+static inline __m128i dotCrawlTest_sse2(__m128i a, __m128i c, __m128i e, __m128i tm1, int zeroThreshold) {
+	__m128i d1 = _mm_or_si128(_mm_subs_epu8(a, c), _mm_subs_epu8(c, a));
+	__m128i d2 = _mm_or_si128(_mm_subs_epu8(c, e), _mm_subs_epu8(e, c));
+
+	if (zeroThreshold) {
+		return _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(d2, d1), _mm_setzero_si128()), _mm_set1_epi8(-1));
+	}
+
+	__m128i diff = _mm_subs_epu8(d1, d2);
+	return _mm_cmpeq_epi8(_mm_min_epu8(diff, tm1), diff);
+}
+
+UNCROSS_TARGET("avx2")
+static inline __m256i dotCrawlTest_avx2(__m256i a, __m256i c, __m256i e, __m256i tm1, int zeroThreshold) {
+	__m256i d1 = _mm256_or_si256(_mm256_subs_epu8(a, c), _mm256_subs_epu8(c, a));
+	__m256i d2 = _mm256_or_si256(_mm256_subs_epu8(c, e), _mm256_subs_epu8(e, c));
+
+	if (zeroThreshold) {
+		return _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_subs_epu8(d2, d1), _mm256_setzero_si256()), _mm256_set1_epi8(-1));
+	}
+
+	__m256i diff = _mm256_subs_epu8(d1, d2);
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(diff, tm1), diff);
+}
+#endif
+
+#ifdef UNCROSS_X86
+// The same test in 16-bit lanes for samples above 8 bits.
+UNCROSS_TARGET("sse2")
+static inline __m128i dotCrawlTest16_sse2(__m128i a, __m128i c, __m128i e, __m128i tm1, int zeroThreshold) {
+	__m128i d1 = _mm_or_si128(_mm_subs_epu16(a, c), _mm_subs_epu16(c, a));
+	__m128i d2 = _mm_or_si128(_mm_subs_epu16(c, e), _mm_subs_epu16(e, c));
+
+	if (zeroThreshold) {
+		return _mm_xor_si128(_mm_cmpeq_epi16(_mm_subs_epu16(d2, d1), _mm_setzero_si128()), _mm_set1_epi16(-1));
+	}
+
+	// SSE2 has no unsigned 16-bit min, but diff <= tm1 is the same as sat(diff - tm1) == 0
+	__m128i diff = _mm_subs_epu16(d1, d2);
+	return _mm_cmpeq_epi16(_mm_subs_epu16(diff, tm1), _mm_setzero_si128());
+}
+
+UNCROSS_TARGET("avx2")
+static inline __m256i dotCrawlTest16_avx2(__m256i a, __m256i c, __m256i e, __m256i tm1, int zeroThreshold) {
+	__m256i d1 = _mm256_or_si256(_mm256_subs_epu16(a, c), _mm256_subs_epu16(c, a));
+	__m256i d2 = _mm256_or_si256(_mm256_subs_epu16(c, e), _mm256_subs_epu16(e, c));
+
+	if (zeroThreshold) {
+		return _mm256_xor_si256(_mm256_cmpeq_epi16(_mm256_subs_epu16(d2, d1), _mm256_setzero_si256()), _mm256_set1_epi16(-1));
+	}
+
+	__m256i diff = _mm256_subs_epu16(d1, d2);
+	return _mm256_cmpeq_epi16(_mm256_min_epu16(diff, tm1), diff);
+}
+#endif
+
+#define KERNEL8_NAME_(name, isa) name##_##isa
+#define KERNEL8_NAME(name, isa) KERNEL8_NAME_(name, isa)
+
+// NTSC at 4fsc: 4 samples per cycle, so samples 2 apart are in opposite phase, and the 2 samples of
+// half a cycle cover both quadratures. At 13.5 MHz a cycle is 3.77 samples and 2 samples are 191
+// degrees, closer to opposite phase than any other distance, so NTSC uses the same stencil at both rates.
+#define STENCIL(name) name
+#define STEP 2
+#define PHASES 2
+#include "dotcrawl_stencil_template.h"
+#undef STENCIL
+#undef STEP
+#undef PHASES
+
+// PAL at 13.5 MHz: a cycle of 4.43 MHz is 3.04 samples, so no distance is close to opposite phase
+// and samples a whole cycle of 3 apart are compared instead, at each of the 3 phases of the cycle.
+#define STENCIL(name) name##Pal
+#define STEP 3
+#define PHASES 3
+#include "dotcrawl_stencil_template.h"
+#undef STENCIL
+#undef STEP
+#undef PHASES
+
+int parseDotCrawlSystem(const char *name, DotCrawlSystem *system) {
+	if (!name || !strcmp(name, "ntsc-4fsc")) {
+		*system = systemNtsc4fsc;
+	}
+	else if (!strcmp(name, "ntsc-13.5")) {
+		*system = systemNtsc13_5;
+	}
+	else if (!strcmp(name, "pal-4.43")) {
+		*system = systemPal443;
+	}
+	else {
+		return 0;
+	}
+
+	return 1;
+}
+
+int dotCrawlLineDistance(DotCrawlSystem system) {
+	// the PAL subcarrier advances 270 degrees per line, so only every other line is in opposite phase
+	return system == systemPal443 ? 2 : 1;
+}
+
+// Select the fastest row kernel for a system and a bit depth (8, 10, 12 or 16) available at the instruction set level cpu.
+DotCrawlRowFunc selectDotCrawlRow(DotCrawlSystem system, int bits, CpuLevel cpu) {
+	int pal = system == systemPal443;
+
+#ifdef UNCROSS_X86
+	if (cpu >= cpuAVX2) {
+		switch (bits) {
+		case 10: return pal ? dotCrawlRowPal10_avx2 : dotCrawlRow10_avx2;
+		case 12: return pal ? dotCrawlRowPal12_avx2 : dotCrawlRow12_avx2;
+		case 16: return pal ? dotCrawlRowPal16_avx2 : dotCrawlRow16_avx2;
+		default: return pal ? dotCrawlRowPal_avx2 : dotCrawlRow_avx2;
+		}
+	}
+	if (cpu >= cpuSSE2) {
+		switch (bits) {
+		case 10: return pal ? dotCrawlRowPal10_sse2 : dotCrawlRow10_sse2;
+		case 12: return pal ? dotCrawlRowPal12_sse2 : dotCrawlRow12_sse2;
+		case 16: return pal ? dotCrawlRowPal16_sse2 : dotCrawlRow16_sse2;
+		default: return pal ? dotCrawlRowPal_sse2 : dotCrawlRow_sse2;
+		}
+	}
+#endif
+	switch (bits) {
+	case 10: return pal ? dotCrawlRowPal10_c : dotCrawlRow10_c;
+	case 12: return pal ? dotCrawlRowPal12_c : dotCrawlRow12_c;
+	case 16: return pal ? dotCrawlRowPal16_c : dotCrawlRow16_c;
+	default: return pal ? dotCrawlRowPal_c : dotCrawlRow_c;
+	}
+}
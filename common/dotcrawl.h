@@ -0,0 +1,44 @@
+#ifndef UNCROSS_DOTCRAWL_H
+#define UNCROSS_DOTCRAWL_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "simd.h"
+
+// Video systems whose subcarrier pattern the dot crawl test is specialized for, taken by system=.
+// NTSC-13.5 reuses the 4fsc stencil and kernels, as both flip phase every line; PAL-4.43 has its own
+// stencil compiled into its own kernels, so the system costs nothing per pixel.
+typedef enum {
+	systemNtsc4fsc, // 4 samples per cycle, phase flipping every line
+	systemNtsc13_5, // about 3.77 samples per cycle at 13.5 MHz, phase flipping every line
+	systemPal443 // about 3.04 samples per cycle at 13.5 MHz, phase advancing a quarter cycle every line
+} DotCrawlSystem;
+
+// Processes one row of the dot crawl map. prevp and nextp are the rows dotCrawlLineDistance above and
+// below it, NULL when they are outside the frame. Flagged pixels are set to 255, the rest (including the
+// last pixels of the row, which have no complete stencil) to 0.
+// Rows are passed as bytes at every bit depth: kernels for more than 8 bits read and write
+// uint16_t samples and set flagged pixels to the maximum value of the bit depth.
+typedef void (*DotCrawlRowFunc)(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold);
+
+void dotCrawlRow_c(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold);
+void dotCrawlRowPal_c(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold);
+#ifdef UNCROSS_X86
+void dotCrawlRow_sse2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold);
+void dotCrawlRow_avx2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold);
+void dotCrawlRowPal_sse2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold);
+void dotCrawlRowPal_avx2(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold);
+#endif
+
+// Parse the system argument of a filter: NULL or "ntsc-4fsc" for the default, "ntsc-13.5" or "pal-4.43".
+// Returns 0 for other names.
+int parseDotCrawlSystem(const char *name, DotCrawlSystem *system);
+
+// Distance in rows of the lines whose samples must differ from a flagged one: 1 where the subcarrier
+// phase flips every line, 2 for PAL, where it takes two lines.
+int dotCrawlLineDistance(DotCrawlSystem system);
+
+// Select the fastest row kernel for a system and a bit depth (8, 10, 12 or 16) available at the instruction set level cpu.
+DotCrawlRowFunc selectDotCrawlRow(DotCrawlSystem system, int bits, CpuLevel cpu);
+
+#endif
@@ -0,0 +1,123 @@
+// Dot crawl row kernels of one stencil at every bit depth. Included from dotcrawl.c once per stencil
+// with STENCIL(name), STEP and PHASES defined; this file deliberately has no include guard.
+// A pixel x is flagged when |a - c| - |c - e| < threshold holds for the samples a, c, e at
+// x + p, x + p + STEP and x + p + 2 * STEP, for every phase p below PHASES. STEP and PHASES are
+// constants, so the loops over the phases unroll into the loads and tests of a fixed stencil.
+#define KERNEL8(name, isa) KERNEL8_NAME(STENCIL(name), isa)
+#define REACH (PHASES - 1 + 2 * STEP)
+
+// Scalar reference for the dot crawl row kernel, also used for the tail of the SIMD kernels.
+static void STENCIL(dotCrawlRowRange)(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int x, int width, int threshold) {
+	for (; (x + REACH) < width; x++) {
+		dstp[x] = 0;
+
+		// compare values across rows
+		if (prevp && prevp[x] == srcp[x]) {
+			continue;
+		}
+		if (nextp && srcp[x] == nextp[x]) {
+			continue;
+		}
+
+		int flagged = 1;
+
+		for (int p = 0; p < PHASES; p++) {
+			const uint8_t *s = srcp + x + p;
+			flagged &= abs(s[0] - s[STEP]) - abs(-s[STEP] + s[2 * STEP]) < threshold;
+		}
+
+		if (flagged) {
+			dstp[x] = 255;
+		}
+	}
+
+	// the last pixels have no complete pattern to compare against
+	for (; x < width; x++) {
+		dstp[x] = 0;
+	}
+}
+
+void KERNEL8(dotCrawlRow, c)(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold) {
+	STENCIL(dotCrawlRowRange)(srcp, prevp, nextp, dstp, 0, width, threshold);
+}
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+void KERNEL8(dotCrawlRow, sse2)(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold) {
+	const __m128i tm1 = _mm_set1_epi8((char)VSMIN(threshold - 1, 255));
+	const int zeroThreshold = threshold <= 0;
+	int x = 0;
+
+	// each iteration reads up to srcp[x + REACH + 15]
+	for (; x + 16 + REACH <= width; x += 16) {
+		__m128i s0 = _mm_loadu_si128((const __m128i *)(srcp + x));
+		__m128i mask = _mm_set1_epi8(-1);
+
+		for (int p = 0; p < PHASES; p++) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(srcp + x + p));
+			__m128i c = _mm_loadu_si128((const __m128i *)(srcp + x + p + STEP));
+			__m128i e = _mm_loadu_si128((const __m128i *)(srcp + x + p + 2 * STEP));
+
+			mask = _mm_and_si128(mask, dotCrawlTest_sse2(a, c, e, tm1, zeroThreshold));
+		}
+
+		// compare values across rows
+		if (prevp) {
+			mask = _mm_andnot_si128(_mm_cmpeq_epi8(s0, _mm_loadu_si128((const __m128i *)(prevp + x))), mask);
+		}
+		if (nextp) {
+			mask = _mm_andnot_si128(_mm_cmpeq_epi8(s0, _mm_loadu_si128((const __m128i *)(nextp + x))), mask);
+		}
+
+		_mm_storeu_si128((__m128i *)(dstp + x), mask);
+	}
+
+	STENCIL(dotCrawlRowRange)(srcp, prevp, nextp, dstp, x, width, threshold);
+}
+
+UNCROSS_TARGET("avx2")
+void KERNEL8(dotCrawlRow, avx2)(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold) {
+	const __m256i tm1 = _mm256_set1_epi8((char)VSMIN(threshold - 1, 255));
+	const int zeroThreshold = threshold <= 0;
+	int x = 0;
+
+	// each iteration reads up to srcp[x + REACH + 31]
+	for (; x + 32 + REACH <= width; x += 32) {
+		__m256i s0 = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		__m256i mask = _mm256_set1_epi8(-1);
+
+		for (int p = 0; p < PHASES; p++) {
+			__m256i a = _mm256_loadu_si256((const __m256i *)(srcp + x + p));
+			__m256i c = _mm256_loadu_si256((const __m256i *)(srcp + x + p + STEP));
+			__m256i e = _mm256_loadu_si256((const __m256i *)(srcp + x + p + 2 * STEP));
+
+			mask = _mm256_and_si256(mask, dotCrawlTest_avx2(a, c, e, tm1, zeroThreshold));
+		}
+
+		// compare values across rows
+		if (prevp) {
+			mask = _mm256_andnot_si256(_mm256_cmpeq_epi8(s0, _mm256_loadu_si256((const __m256i *)(prevp + x))), mask);
+		}
+		if (nextp) {
+			mask = _mm256_andnot_si256(_mm256_cmpeq_epi8(s0, _mm256_loadu_si256((const __m256i *)(nextp + x))), mask);
+		}
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), mask);
+	}
+
+	STENCIL(dotCrawlRowRange)(srcp, prevp, nextp, dstp, x, width, threshold);
+}
+#endif
+
+#define BITS 10
+#include "dotcrawl_template.h"
+#undef BITS
+#define BITS 12
+#include "dotcrawl_template.h"
+#undef BITS
+#define BITS 16
+#include "dotcrawl_template.h"
+#undef BITS
+
+#undef KERNEL8
+#undef REACH
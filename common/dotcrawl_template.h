@@ -0,0 +1,116 @@
+// Dot crawl row kernels for BITS-bit samples stored as uint16_t. Included from dotcrawl_stencil_template.h
+// once per bit depth with BITS defined, for the stencil it is instantiating; this file deliberately has no include guard.
+#define KERNEL(name, isa) KERNEL_NAME(STENCIL(name), BITS, isa)
+#define PIXEL_MAX ((1 << BITS) - 1)
+
+// Scalar reference, also used for the tail of the SIMD kernels.
+static void KERNEL(dotCrawlRowRange, c)(const uint16_t *srcp, const uint16_t *prevp, const uint16_t *nextp, uint16_t *dstp, int x, int width, int threshold) {
+	for (; (x + REACH) < width; x++) {
+		dstp[x] = 0;
+
+		// compare values across rows
+		if (prevp && prevp[x] == srcp[x]) {
+			continue;
+		}
+		if (nextp && srcp[x] == nextp[x]) {
+			continue;
+		}
+
+		int flagged = 1;
+
+		for (int p = 0; p < PHASES; p++) {
+			const uint16_t *s = srcp + x + p;
+			flagged &= abs(s[0] - s[STEP]) - abs(-s[STEP] + s[2 * STEP]) < threshold;
+		}
+
+		if (flagged) {
+			dstp[x] = PIXEL_MAX;
+		}
+	}
+
+	// the last pixels have no complete pattern to compare against
+	for (; x < width; x++) {
+		dstp[x] = 0;
+	}
+}
+
+static void KERNEL(dotCrawlRow, c)(const uint8_t *srcp, const uint8_t *prevp, const uint8_t *nextp, uint8_t *dstp, int width, int threshold) {
+	KERNEL(dotCrawlRowRange, c)((const uint16_t *)srcp, (const uint16_t *)prevp, (const uint16_t *)nextp, (uint16_t *)dstp, 0, width, threshold);
+}
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+static void KERNEL(dotCrawlRow, sse2)(const uint8_t *srcp8, const uint8_t *prevp8, const uint8_t *nextp8, uint8_t *dstp8, int width, int threshold) {
+	const uint16_t *srcp = (const uint16_t *)srcp8, *prevp = (const uint16_t *)prevp8, *nextp = (const uint16_t *)nextp8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	const __m128i tm1 = _mm_set1_epi16((short)VSMIN(threshold - 1, 65535));
+	const __m128i pixelMax = _mm_set1_epi16((short)PIXEL_MAX);
+	const int zeroThreshold = threshold <= 0;
+	int x = 0;
+
+	// each iteration reads up to srcp[x + REACH + 7]
+	for (; x + 8 + REACH <= width; x += 8) {
+		__m128i s0 = _mm_loadu_si128((const __m128i *)(srcp + x));
+		__m128i mask = _mm_set1_epi16(-1);
+
+		for (int p = 0; p < PHASES; p++) {
+			__m128i a = _mm_loadu_si128((const __m128i *)(srcp + x + p));
+			__m128i c = _mm_loadu_si128((const __m128i *)(srcp + x + p + STEP));
+			__m128i e = _mm_loadu_si128((const __m128i *)(srcp + x + p + 2 * STEP));
+
+			mask = _mm_and_si128(mask, dotCrawlTest16_sse2(a, c, e, tm1, zeroThreshold));
+		}
+
+		// compare values across rows
+		if (prevp) {
+			mask = _mm_andnot_si128(_mm_cmpeq_epi16(s0, _mm_loadu_si128((const __m128i *)(prevp + x))), mask);
+		}
+		if (nextp) {
+			mask = _mm_andnot_si128(_mm_cmpeq_epi16(s0, _mm_loadu_si128((const __m128i *)(nextp + x))), mask);
+		}
+
+		_mm_storeu_si128((__m128i *)(dstp + x), _mm_and_si128(mask, pixelMax));
+	}
+
+	KERNEL(dotCrawlRowRange, c)(srcp, prevp, nextp, dstp, x, width, threshold);
+}
+
+UNCROSS_TARGET("avx2")
+static void KERNEL(dotCrawlRow, avx2)(const uint8_t *srcp8, const uint8_t *prevp8, const uint8_t *nextp8, uint8_t *dstp8, int width, int threshold) {
+	const uint16_t *srcp = (const uint16_t *)srcp8, *prevp = (const uint16_t *)prevp8, *nextp = (const uint16_t *)nextp8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	const __m256i tm1 = _mm256_set1_epi16((short)VSMIN(threshold - 1, 65535));
+	const __m256i pixelMax = _mm256_set1_epi16((short)PIXEL_MAX);
+	const int zeroThreshold = threshold <= 0;
+	int x = 0;
+
+	// each iteration reads up to srcp[x + REACH + 15]
+	for (; x + 16 + REACH <= width; x += 16) {
+		__m256i s0 = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		__m256i mask = _mm256_set1_epi16(-1);
+
+		for (int p = 0; p < PHASES; p++) {
+			__m256i a = _mm256_loadu_si256((const __m256i *)(srcp + x + p));
+			__m256i c = _mm256_loadu_si256((const __m256i *)(srcp + x + p + STEP));
+			__m256i e = _mm256_loadu_si256((const __m256i *)(srcp + x + p + 2 * STEP));
+
+			mask = _mm256_and_si256(mask, dotCrawlTest16_avx2(a, c, e, tm1, zeroThreshold));
+		}
+
+		// compare values across rows
+		if (prevp) {
+			mask = _mm256_andnot_si256(_mm256_cmpeq_epi16(s0, _mm256_loadu_si256((const __m256i *)(prevp + x))), mask);
+		}
+		if (nextp) {
+			mask = _mm256_andnot_si256(_mm256_cmpeq_epi16(s0, _mm256_loadu_si256((const __m256i *)(nextp + x))), mask);
+		}
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), _mm256_and_si256(mask, pixelMax));
+	}
+
+	KERNEL(dotCrawlRowRange, c)(srcp, prevp, nextp, dstp, x, width, threshold);
+}
+#endif
+
+#undef KERNEL
+#undef PIXEL_MAX
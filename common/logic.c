@@ -0,0 +1,81 @@
+#include "logic.h"
+
+// The scalar kernels double as the tail of the SIMD ones, starting at x.
+#define LOGIC_ROW_C(name, expr) \
+static void name##Range(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int x, int width) { \
+	for (; x < width; x++) { \
+		dstp[x] = (uint8_t)(expr); \
+	} \
+} \
+\
+void name##_c(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width) { \
+	name##Range(ap, bp, dstp, 0, width); \
+}
+
+LOGIC_ROW_C(andRow, ap[x] & bp[x])
+LOGIC_ROW_C(orRow, ap[x] | bp[x])
+LOGIC_ROW_C(xorRow, ap[x] ^ bp[x])
+LOGIC_ROW_C(andNotRow, ap[x] & ~bp[x])
+LOGIC_ROW_C(notRow, ~ap[x])
+
+#ifdef UNCROSS_X86
+// a and b hold the loaded vectors; b is only loaded when the operator reads it.
+#define LOGIC_ROW_SSE2(name, readsB, expr) \
+UNCROSS_TARGET("sse2") \
+void name##_sse2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width) { \
+	const __m128i ones = _mm_set1_epi8(-1); \
+	int x = 0; \
+	(void)ones; \
+	for (; x + 16 <= width; x += 16) { \
+		__m128i a = _mm_loadu_si128((const __m128i *)(ap + x)); \
+		__m128i b = readsB ? _mm_loadu_si128((const __m128i *)(bp + x)) : a; \
+		(void)b; \
+		_mm_storeu_si128((__m128i *)(dstp + x), expr); \
+	} \
+	name##Range(ap, bp, dstp, x, width); \
+}
+
+#define LOGIC_ROW_AVX2(name, readsB, expr) \
+UNCROSS_TARGET("avx2") \
+void name##_avx2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width) { \
+	const __m256i ones = _mm256_set1_epi8(-1); \
+	int x = 0; \
+	(void)ones; \
+	for (; x + 32 <= width; x += 32) { \
+		__m256i a = _mm256_loadu_si256((const __m256i *)(ap + x)); \
+		__m256i b = readsB ? _mm256_loadu_si256((const __m256i *)(bp + x)) : a; \
+		(void)b; \
+		_mm256_storeu_si256((__m256i *)(dstp + x), expr); \
+	} \
+	name##Range(ap, bp, dstp, x, width); \
+}
+
+LOGIC_ROW_SSE2(andRow, 1, _mm_and_si128(a, b))
+LOGIC_ROW_SSE2(orRow, 1, _mm_or_si128(a, b))
+LOGIC_ROW_SSE2(xorRow, 1, _mm_xor_si128(a, b))
+LOGIC_ROW_SSE2(andNotRow, 1, _mm_andnot_si128(b, a))
+LOGIC_ROW_SSE2(notRow, 0, _mm_xor_si128(a, ones))
+
+LOGIC_ROW_AVX2(andRow, 1, _mm256_and_si256(a, b))
+LOGIC_ROW_AVX2(orRow, 1, _mm256_or_si256(a, b))
+LOGIC_ROW_AVX2(xorRow, 1, _mm256_xor_si256(a, b))
+LOGIC_ROW_AVX2(andNotRow, 1, _mm256_andnot_si256(b, a))
+LOGIC_ROW_AVX2(notRow, 0, _mm256_xor_si256(a, ones))
+#endif
+
+// Select the fastest row kernel for op available at the instruction set level cpu.
+LogicRowFunc selectLogicRow(LogicOp op, CpuLevel cpu) {
+	static const LogicRowFunc c[] = { andRow_c, orRow_c, xorRow_c, andNotRow_c, notRow_c };
+#ifdef UNCROSS_X86
+	static const LogicRowFunc sse2[] = { andRow_sse2, orRow_sse2, xorRow_sse2, andNotRow_sse2, notRow_sse2 };
+	static const LogicRowFunc avx2[] = { andRow_avx2, orRow_avx2, xorRow_avx2, andNotRow_avx2, notRow_avx2 };
+
+	if (cpu >= cpuAVX2) {
+		return avx2[op];
+	}
+	if (cpu >= cpuSSE2) {
+		return sse2[op];
+	}
+#endif
+	return c[op];
+}
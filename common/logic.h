@@ -0,0 +1,42 @@
+#ifndef UNCROSS_LOGIC_H
+#define UNCROSS_LOGIC_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "simd.h"
+
+// Byte-wise mask operators. They work bit by bit, so on the 0/255 masks produced by the
+// detectors they are the boolean operators.
+typedef enum {
+	logicAnd,
+	logicOr,
+	logicXor,
+	logicAndNot, // a & ~b
+	logicNot // ~a, bp is not read
+} LogicOp;
+
+// Combines one row of a and b into dstp, which may alias either source.
+typedef void (*LogicRowFunc)(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+
+void andRow_c(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void orRow_c(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void xorRow_c(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void andNotRow_c(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void notRow_c(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+#ifdef UNCROSS_X86
+void andRow_sse2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void orRow_sse2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void xorRow_sse2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void andNotRow_sse2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void notRow_sse2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void andRow_avx2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void orRow_avx2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void xorRow_avx2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void andNotRow_avx2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+void notRow_avx2(const uint8_t *ap, const uint8_t *bp, uint8_t *dstp, int width);
+#endif
+
+// Select the fastest row kernel for op available at the instruction set level cpu.
+LogicRowFunc selectLogicRow(LogicOp op, CpuLevel cpu);
+
+#endif
@@ -0,0 +1,430 @@
+#include <stdlib.h>
+#include <string.h>
+#include <VSHelper.h>
+#include "motion.h"
+
+// Scalar reference SAD for any block dimensions, used for partial blocks at the frame edges.
+unsigned sadBlock_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride, int width, int height) {
+	unsigned sad = 0;
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			sad += abs(srcp[x] - refp[x]);
+		}
+
+		srcp += srcStride;
+		refp += refStride;
+	}
+
+	return sad;
+}
+
+// The same for uint16_t samples above 8 bits. Strides are in bytes.
+unsigned sadBlock16_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride, int width, int height) {
+	unsigned sad = 0;
+
+	for (int y = 0; y < height; y++) {
+		const uint16_t *s = (const uint16_t *)srcp, *r = (const uint16_t *)refp;
+
+		for (int x = 0; x < width; x++) {
+			sad += abs(s[x] - r[x]);
+		}
+
+		srcp += srcStride;
+		refp += refStride;
+	}
+
+	return sad;
+}
+
+unsigned sad4x4_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return sadBlock_c(srcp, srcStride, refp, refStride, 4, 4);
+}
+
+unsigned sad8x8_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return sadBlock_c(srcp, srcStride, refp, refStride, 8, 8);
+}
+
+unsigned sad16x16_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return sadBlock_c(srcp, srcStride, refp, refStride, 16, 16);
+}
+
+unsigned sad32x32_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return sadBlock_c(srcp, srcStride, refp, refStride, 32, 32);
+}
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+static inline __m128i loadRows4_sse2(const uint8_t *p, int stride) {
+	int32_t r0, r1, r2, r3;
+	memcpy(&r0, p, 4);
+	memcpy(&r1, p + stride, 4);
+	memcpy(&r2, p + 2 * stride, 4);
+	memcpy(&r3, p + 3 * stride, 4);
+	return _mm_set_epi32(r3, r2, r1, r0);
+}
+
+UNCROSS_TARGET("sse2")
+static inline unsigned horizontalSum_sse2(__m128i v) {
+	return (unsigned)(_mm_cvtsi128_si32(v) + _mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+}
+
+UNCROSS_TARGET("sse2")
+unsigned sad4x4_sse2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return horizontalSum_sse2(_mm_sad_epu8(loadRows4_sse2(srcp, srcStride), loadRows4_sse2(refp, refStride)));
+}
+
+UNCROSS_TARGET("sse2")
+unsigned sad8x8_sse2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	__m128i sum = _mm_setzero_si128();
+
+	for (int y = 0; y < 8; y += 2) {
+		__m128i s = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)srcp), _mm_loadl_epi64((const __m128i *)(srcp + srcStride)));
+		__m128i r = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)refp), _mm_loadl_epi64((const __m128i *)(refp + refStride)));
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(s, r));
+
+		srcp += 2 * srcStride;
+		refp += 2 * refStride;
+	}
+
+	return horizontalSum_sse2(sum);
+}
+
+UNCROSS_TARGET("sse2")
+unsigned sad16x16_sse2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	__m128i sum = _mm_setzero_si128();
+
+	for (int y = 0; y < 16; y++) {
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)srcp), _mm_loadu_si128((const __m128i *)refp)));
+
+		srcp += srcStride;
+		refp += refStride;
+	}
+
+	return horizontalSum_sse2(sum);
+}
+
+UNCROSS_TARGET("sse2")
+unsigned sad32x32_sse2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	__m128i sum = _mm_setzero_si128();
+
+	for (int y = 0; y < 32; y++) {
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)srcp), _mm_loadu_si128((const __m128i *)refp)));
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(srcp + 16)), _mm_loadu_si128((const __m128i *)(refp + 16))));
+
+		srcp += srcStride;
+		refp += refStride;
+	}
+
+	return horizontalSum_sse2(sum);
+}
+
+UNCROSS_TARGET("avx2")
+static inline unsigned horizontalSum_avx2(__m256i v) {
+	__m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	return (unsigned)(_mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8)));
+}
+
+UNCROSS_TARGET("avx2")
+unsigned sad16x16_avx2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	__m256i sum = _mm256_setzero_si256();
+
+	// two rows per register
+	for (int y = 0; y < 16; y += 2) {
+		__m256i s = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)srcp)), _mm_loadu_si128((const __m128i *)(srcp + srcStride)), 1);
+		__m256i r = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)refp)), _mm_loadu_si128((const __m128i *)(refp + refStride)), 1);
+		sum = _mm256_add_epi64(sum, _mm256_sad_epu8(s, r));
+
+		srcp += 2 * srcStride;
+		refp += 2 * refStride;
+	}
+
+	return horizontalSum_avx2(sum);
+}
+
+UNCROSS_TARGET("avx2")
+unsigned sad32x32_avx2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	__m256i sum = _mm256_setzero_si256();
+
+	for (int y = 0; y < 32; y++) {
+		sum = _mm256_add_epi64(sum, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i *)srcp), _mm256_loadu_si256((const __m256i *)refp)));
+
+		srcp += srcStride;
+		refp += refStride;
+	}
+
+	return horizontalSum_avx2(sum);
+}
+
+#ifdef UNCROSS_AVX512
+UNCROSS_TARGET("avx512bw")
+unsigned sad32x32_avx512(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	__m512i sum = _mm512_setzero_si512();
+
+	// two rows per register
+	for (int y = 0; y < 32; y += 2) {
+		__m512i s = _mm512_inserti64x4(_mm512_castsi256_si512(_mm256_loadu_si256((const __m256i *)srcp)), _mm256_loadu_si256((const __m256i *)(srcp + srcStride)), 1);
+		__m512i r = _mm512_inserti64x4(_mm512_castsi256_si512(_mm256_loadu_si256((const __m256i *)refp)), _mm256_loadu_si256((const __m256i *)(refp + refStride)), 1);
+		sum = _mm512_add_epi64(sum, _mm512_sad_epu8(s, r));
+
+		srcp += 2 * srcStride;
+		refp += 2 * refStride;
+	}
+
+	return (unsigned)_mm512_reduce_add_epi64(sum);
+}
+#endif
+#endif
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+static inline unsigned horizontalSum32_sse2(__m128i v) {
+	v = _mm_add_epi32(v, _mm_srli_si128(v, 8));
+	v = _mm_add_epi32(v, _mm_srli_si128(v, 4));
+	return (unsigned)_mm_cvtsi128_si32(v);
+}
+
+UNCROSS_TARGET("avx2")
+static inline unsigned horizontalSum32_avx2(__m256i v) {
+	return horizontalSum32_sse2(_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+#endif
+
+#define BITS 10
+#include "motion_template.h"
+#undef BITS
+#define BITS 12
+#include "motion_template.h"
+#undef BITS
+#define BITS 16
+#include "motion_template.h"
+#undef BITS
+
+// Kernels of one bit depth for each block size, in the order 4, 8, 16, 32.
+#define SAD_KERNELS(bits, isa) { sad4x4##bits##_##isa, sad8x8##bits##_##isa, sad16x16##bits##_##isa, sad32x32##bits##_##isa }
+
+// Select the fastest SAD kernel for a block size and a bit depth (8, 10, 12 or 16) available at the instruction set level cpu.
+SadFunc selectSad(int blockSize, int bits, CpuLevel cpu) {
+	int size = blockSize == 4 ? 0 : blockSize == 8 ? 1 : blockSize == 16 ? 2 : 3;
+	int depth = bits == 10 ? 1 : bits == 12 ? 2 : bits == 16 ? 3 : 0;
+
+#ifdef UNCROSS_X86
+	static const SadFunc sse2[4][4] = {
+		SAD_KERNELS(, sse2), SAD_KERNELS(10, sse2), SAD_KERNELS(12, sse2), SAD_KERNELS(16, sse2)
+	};
+
+#ifdef UNCROSS_AVX512
+	// gathering 16-pixel rows into a 512-bit register costs as much as the AVX2 kernel saves
+	if (cpu >= cpuAVX512BW && size == 3 && depth == 0) {
+		return sad32x32_avx512;
+	}
+#endif
+	// there are no AVX2 kernels for blocks narrower than a register
+	if (cpu >= cpuAVX2 && size >= 2) {
+		static const SadFunc avx2[4][2] = {
+			{ sad16x16_avx2, sad32x32_avx2 },
+			{ sad16x1610_avx2, sad32x3210_avx2 },
+			{ sad16x1612_avx2, sad32x3212_avx2 },
+			{ sad16x1616_avx2, sad32x3216_avx2 },
+		};
+		return avx2[depth][size - 2];
+	}
+	if (cpu >= cpuSSE2) {
+		return sse2[depth][size];
+	}
+#endif
+	{
+		static const SadFunc c[4][4] = {
+			SAD_KERNELS(, c), SAD_KERNELS(10, c), SAD_KERNELS(12, c), SAD_KERNELS(16, c)
+		};
+		return c[depth][size];
+	}
+}
+
+#undef SAD_KERNELS
+
+// Fill in the kernels and sample size of a search for a bit depth. blockSize must be set.
+void initMotionSearch(MotionSearch *search, int bits, CpuLevel cpu) {
+	search->sad = selectSad(search->blockSize, bits, cpu);
+	search->sadBlock = bits > 8 ? sadBlock16_c : sadBlock_c;
+	search->bytesPerSample = bits > 8 ? 2 : 1;
+}
+
+// Scalar reference for the compensation error kernel, also used for the tail of the SIMD kernels.
+static void compensationErrorRowRange(const uint8_t *srcp, const uint8_t *compp, uint8_t *dstp, int x, int width, int threshold) {
+	for (; x < width; x++) {
+		int diff = srcp[x] - compp[x];
+		dstp[x] = diff >= threshold - 1 || diff <= -threshold - 2 ? 255 : 0;
+	}
+}
+
+void compensationErrorRow_c(const uint8_t *srcp, const uint8_t *compp, uint8_t *dstp, int width, int threshold) {
+	compensationErrorRowRange(srcp, compp, dstp, 0, width, threshold);
+}
+
+#ifdef UNCROSS_X86
+// s - c >= threshold - 1 is the same as a non-zero sat(sat(s - c) - (threshold - 2)), and c - s >= threshold + 2
+// as a non-zero sat(sat(c - s) - (threshold + 1)). Thresholds below 2 also flag pixels equal to the compensated
+// ones, which saturated differences cannot tell apart from smaller ones, and are left to the scalar loop.
+UNCROSS_TARGET("sse2")
+void compensationErrorRow_sse2(const uint8_t *srcp, const uint8_t *compp, uint8_t *dstp, int width, int threshold) {
+	const __m128i above = _mm_set1_epi8((char)VSMIN(threshold - 2, 255));
+	const __m128i below = _mm_set1_epi8((char)VSMIN(threshold + 1, 255));
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi8(-1);
+	int x = 0;
+
+	for (; threshold >= 2 && x + 16 <= width; x += 16) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(srcp + x));
+		__m128i c = _mm_loadu_si128((const __m128i *)(compp + x));
+		__m128i cleanAbove = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_subs_epu8(s, c), above), zero);
+		__m128i cleanBelow = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_subs_epu8(c, s), below), zero);
+		__m128i mask = _mm_xor_si128(_mm_and_si128(cleanAbove, cleanBelow), ones);
+
+		_mm_storeu_si128((__m128i *)(dstp + x), mask);
+	}
+
+	compensationErrorRowRange(srcp, compp, dstp, x, width, threshold);
+}
+
+UNCROSS_TARGET("avx2")
+void compensationErrorRow_avx2(const uint8_t *srcp, const uint8_t *compp, uint8_t *dstp, int width, int threshold) {
+	const __m256i above = _mm256_set1_epi8((char)VSMIN(threshold - 2, 255));
+	const __m256i below = _mm256_set1_epi8((char)VSMIN(threshold + 1, 255));
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi8(-1);
+	int x = 0;
+
+	for (; threshold >= 2 && x + 32 <= width; x += 32) {
+		__m256i s = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		__m256i c = _mm256_loadu_si256((const __m256i *)(compp + x));
+		__m256i cleanAbove = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_subs_epu8(s, c), above), zero);
+		__m256i cleanBelow = _mm256_cmpeq_epi8(_mm256_subs_epu8(_mm256_subs_epu8(c, s), below), zero);
+		__m256i mask = _mm256_xor_si256(_mm256_and_si256(cleanAbove, cleanBelow), ones);
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), mask);
+	}
+
+	compensationErrorRowRange(srcp, compp, dstp, x, width, threshold);
+}
+#endif
+
+// Select the fastest compensation error kernel for a bit depth (8, 10, 12 or 16) available at the instruction set level cpu.
+CompensationErrorRowFunc selectCompensationErrorRow(int bits, CpuLevel cpu) {
+#ifdef UNCROSS_X86
+	if (cpu >= cpuAVX2) {
+		switch (bits) {
+		case 10: return compensationErrorRow10_avx2;
+		case 12: return compensationErrorRow12_avx2;
+		case 16: return compensationErrorRow16_avx2;
+		default: return compensationErrorRow_avx2;
+		}
+	}
+	if (cpu >= cpuSSE2) {
+		switch (bits) {
+		case 10: return compensationErrorRow10_sse2;
+		case 12: return compensationErrorRow12_sse2;
+		case 16: return compensationErrorRow16_sse2;
+		default: return compensationErrorRow_sse2;
+		}
+	}
+#endif
+	switch (bits) {
+	case 10: return compensationErrorRow10_c;
+	case 12: return compensationErrorRow12_c;
+	case 16: return compensationErrorRow16_c;
+	default: return compensationErrorRow_c;
+	}
+}
+
+// Find the best vector of every block in one row of blocks, starting at luma row by, with an exhaustive
+// search of the reference plane. Ties keep the zero vector, or else the first candidate in raster order.
+// The partial block at the right edge is included, and so are partial blocks on the bottom row.
+void estimateMotionRow(const uint8_t *srcp, int stride, const uint8_t *refp, int refStride, int width, int height, int by,
+	MotionVector *vectors, const MotionSearch *search) {
+	int blockSize = search->blockSize;
+	int range = search->range;
+	int bps = search->bytesPerSample;
+	int bh = VSMIN(blockSize, height - by);
+
+	for (int bx = 0; bx < width; bx += blockSize) {
+		int bw = VSMIN(blockSize, width - bx);
+		int full = bw == blockSize && bh == blockSize;
+		const uint8_t *blockp = srcp + by * stride + bx * bps;
+
+		// keep candidates inside the reference frame
+		int minDx = VSMAX(-range, -bx), maxDx = VSMIN(range, width - bw - bx);
+		int minDy = VSMAX(-range, -by), maxDy = VSMIN(range, height - bh - by);
+
+		MotionVector best;
+		best.dx = 0;
+		best.dy = 0;
+		best.sad = full ? search->sad(blockp, stride, refp + by * refStride + bx * bps, refStride)
+			: search->sadBlock(blockp, stride, refp + by * refStride + bx * bps, refStride, bw, bh);
+
+		for (int dy = minDy; dy <= maxDy && best.sad > 0; dy++) {
+			const uint8_t *candp = refp + (by + dy) * refStride + bx * bps;
+
+			for (int dx = minDx; dx <= maxDx; dx++) {
+				if (dx == 0 && dy == 0) {
+					continue;
+				}
+
+				unsigned sad = full ? search->sad(blockp, stride, candp + dx * bps, refStride)
+					: search->sadBlock(blockp, stride, candp + dx * bps, refStride, bw, bh);
+
+				if (sad < best.sad) {
+					best.dx = dx;
+					best.dy = dy;
+					best.sad = sad;
+				}
+			}
+		}
+
+		*vectors++ = best;
+	}
+}
+
+// Copy rows y to y + rows - 1 of one row of blocks from the reference plane, displaced by each block's vector.
+// Block dimensions and vectors are scaled down by the plane's subsampling.
+void compensateRows(const uint8_t *refp, int refStride, uint8_t *dstp, int dstStride, int y, int rows, int width,
+	const MotionVector *vectors, int blockWidth, int ssW, int ssH, int bytesPerSample) {
+	for (int i = 0; i < rows; i++) {
+		const MotionVector *mv = vectors;
+
+		for (int bx = 0; bx < width; bx += blockWidth) {
+			int bw = VSMIN(blockWidth, width - bx);
+			const uint8_t *blockp = refp + (y + i + (mv->dy >> ssH)) * refStride + (bx + (mv->dx >> ssW)) * bytesPerSample;
+
+			memcpy(dstp + bx * bytesPerSample, blockp, bw * bytesPerSample);
+			mv++;
+		}
+
+		dstp += dstStride;
+	}
+}
+
+// Expand the vectors of one row of blocks into a mask row of bits-bit samples: pixels of blocks whose
+// vector is at least threshold pixels long are set to the maximum value, the rest to 0.
+void motionMaskRow(const MotionVector *vectors, uint8_t *dstp, int width, int blockSize, int threshold, int bits) {
+	int threshold2 = threshold * threshold;
+
+	for (int bx = 0; bx < width; bx += blockSize) {
+		int bw = VSMIN(blockSize, width - bx);
+		int length2 = vectors->dx * vectors->dx + vectors->dy * vectors->dy;
+
+		if (bits == 8) {
+			memset(dstp + bx, length2 >= threshold2 ? 255 : 0, bw);
+		}
+		else {
+			uint16_t *dstp16 = (uint16_t *)dstp + bx;
+			uint16_t value = length2 >= threshold2 ? (1 << bits) - 1 : 0;
+
+			for (int x = 0; x < bw; x++) {
+				dstp16[x] = value;
+			}
+		}
+
+		vectors++;
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef UNCROSS_MOTION_H
+#define UNCROSS_MOTION_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "simd.h"
+
+// Sum of absolute differences between a block of the current frame and a block of the reference frame.
+// Rows are passed as bytes at every bit depth: kernels for more than 8 bits read uint16_t samples.
+typedef unsigned (*SadFunc)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+
+// The same for blocks of any dimensions, used for partial blocks at the frame edges.
+typedef unsigned (*SadBlockFunc)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride, int width, int height);
+
+// Flags pixels of a row that are at least threshold - 1 above the compensated row or threshold + 2 below it,
+// the bounds of the script's std.MakeDiff, centered on 128, binarized at 127 + threshold and 127 - threshold.
+// Kernels for more than 8 bits take the threshold scaled to their depth and scale the offsets of 1 and 2 with it.
+typedef void (*CompensationErrorRowFunc)(const uint8_t *srcp, const uint8_t *compp, uint8_t *dstp, int width, int threshold);
+
+// Best match of a block in the previous frame.
+typedef struct {
+	int dx;
+	int dy;
+	unsigned sad;
+} MotionVector;
+
+typedef struct {
+	int blockSize; // width and height of the square search blocks: 4, 8, 16 or 32
+	int range; // search radius in pixels around the zero vector
+	SadFunc sad; // kernel for full blocks of blockSize
+	SadBlockFunc sadBlock; // kernel for partial blocks
+	int bytesPerSample;
+} MotionSearch;
+
+unsigned sadBlock_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride, int width, int height);
+unsigned sadBlock16_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride, int width, int height);
+unsigned sad4x4_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+unsigned sad8x8_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+unsigned sad16x16_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+unsigned sad32x32_c(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+#ifdef UNCROSS_X86
+unsigned sad4x4_sse2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+unsigned sad8x8_sse2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+unsigned sad16x16_sse2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+unsigned sad32x32_sse2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+unsigned sad16x16_avx2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+unsigned sad32x32_avx2(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+#ifdef UNCROSS_AVX512
+unsigned sad32x32_avx512(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride);
+#endif
+#endif
+
+// Select the fastest SAD kernel for a block size and a bit depth (8, 10, 12 or 16) available at the instruction set level cpu.
+SadFunc selectSad(int blockSize, int bits, CpuLevel cpu);
+
+// Fill in the kernels and sample size of a search for a bit depth. blockSize must be set.
+void initMotionSearch(MotionSearch *search, int bits, CpuLevel cpu);
+
+void compensationErrorRow_c(const uint8_t *srcp, const uint8_t *compp, uint8_t *dstp, int width, int threshold);
+#ifdef UNCROSS_X86
+void compensationErrorRow_sse2(const uint8_t *srcp, const uint8_t *compp, uint8_t *dstp, int width, int threshold);
+void compensationErrorRow_avx2(const uint8_t *srcp, const uint8_t *compp, uint8_t *dstp, int width, int threshold);
+#endif
+
+// Select the fastest compensation error kernel for a bit depth (8, 10, 12 or 16) available at the instruction set level cpu.
+CompensationErrorRowFunc selectCompensationErrorRow(int bits, CpuLevel cpu);
+
+// Search the blocks of the row of blocks starting at luma row by. Writes one vector per block.
+void estimateMotionRow(const uint8_t *srcp, int stride, const uint8_t *refp, int refStride, int width, int height, int by,
+	MotionVector *vectors, const MotionSearch *search);
+
+// Copy rows of a row of blocks from the reference plane, displaced by the block vectors.
+void compensateRows(const uint8_t *refp, int refStride, uint8_t *dstp, int dstStride, int y, int rows, int width,
+	const MotionVector *vectors, int blockWidth, int ssW, int ssH, int bytesPerSample);
+
+// Expand the vectors of a row of blocks into a mask row of 0 and the maximum value of bits-bit samples.
+void motionMaskRow(const MotionVector *vectors, uint8_t *dstp, int width, int blockSize, int threshold, int bits);
+
+#endif
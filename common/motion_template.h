@@ -0,0 +1,186 @@
+// Motion kernels for BITS-bit samples stored as uint16_t. Included from motion.c
+// once per bit depth with BITS defined; this file deliberately has no include guard.
+// Absolute differences are summed in pairs with pmaddwd up to 14 bits, where they fit
+// in signed 16-bit lanes; 16-bit samples are widened to 32-bit lanes instead.
+#define KERNEL(name, isa) KERNEL_NAME(name, BITS, isa)
+#define PIXEL_MAX ((1 << BITS) - 1)
+#define UNIT (1 << (BITS - 8)) // one 8-bit step, by which the bounds of the compensation error are offset
+
+static unsigned KERNEL(sad4x4, c)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return sadBlock16_c(srcp, srcStride, refp, refStride, 4, 4);
+}
+
+static unsigned KERNEL(sad8x8, c)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return sadBlock16_c(srcp, srcStride, refp, refStride, 8, 8);
+}
+
+static unsigned KERNEL(sad16x16, c)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return sadBlock16_c(srcp, srcStride, refp, refStride, 16, 16);
+}
+
+static unsigned KERNEL(sad32x32, c)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return sadBlock16_c(srcp, srcStride, refp, refStride, 32, 32);
+}
+
+// Scalar reference for the compensation error kernel, also used for the tail of the SIMD kernels.
+static void KERNEL(compensationErrorRowRange, c)(const uint16_t *srcp, const uint16_t *compp, uint16_t *dstp, int x, int width, int threshold) {
+	for (; x < width; x++) {
+		int diff = srcp[x] - compp[x];
+		dstp[x] = diff >= threshold - UNIT || diff <= -threshold - 2 * UNIT ? PIXEL_MAX : 0;
+	}
+}
+
+static void KERNEL(compensationErrorRow, c)(const uint8_t *srcp, const uint8_t *compp, uint8_t *dstp, int width, int threshold) {
+	KERNEL(compensationErrorRowRange, c)((const uint16_t *)srcp, (const uint16_t *)compp, (uint16_t *)dstp, 0, width, threshold);
+}
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+static inline __m128i KERNEL(sadAccumulate, sse2)(__m128i sum, __m128i s, __m128i r) {
+	__m128i diff = _mm_or_si128(_mm_subs_epu16(s, r), _mm_subs_epu16(r, s));
+#if BITS > 14
+	const __m128i zero = _mm_setzero_si128();
+	return _mm_add_epi32(sum, _mm_add_epi32(_mm_unpacklo_epi16(diff, zero), _mm_unpackhi_epi16(diff, zero)));
+#else
+	return _mm_add_epi32(sum, _mm_madd_epi16(diff, _mm_set1_epi16(1)));
+#endif
+}
+
+// Rows of blocks at least 8 samples wide, 8 samples per load. Inlined into the kernels below
+// with a constant size, so the column loop is unrolled.
+UNCROSS_TARGET("sse2")
+static inline unsigned KERNEL(sadBlock, sse2)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride, int size) {
+	__m128i sum = _mm_setzero_si128();
+
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x += 8) {
+			sum = KERNEL(sadAccumulate, sse2)(sum, _mm_loadu_si128((const __m128i *)(srcp + 2 * x)), _mm_loadu_si128((const __m128i *)(refp + 2 * x)));
+		}
+
+		srcp += srcStride;
+		refp += refStride;
+	}
+
+	return horizontalSum32_sse2(sum);
+}
+
+UNCROSS_TARGET("sse2")
+static unsigned KERNEL(sad4x4, sse2)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	__m128i sum = _mm_setzero_si128();
+
+	// two rows per register
+	for (int y = 0; y < 4; y += 2) {
+		__m128i s = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)srcp), _mm_loadl_epi64((const __m128i *)(srcp + srcStride)));
+		__m128i r = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)refp), _mm_loadl_epi64((const __m128i *)(refp + refStride)));
+		sum = KERNEL(sadAccumulate, sse2)(sum, s, r);
+
+		srcp += 2 * srcStride;
+		refp += 2 * refStride;
+	}
+
+	return horizontalSum32_sse2(sum);
+}
+
+UNCROSS_TARGET("sse2")
+static unsigned KERNEL(sad8x8, sse2)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return KERNEL(sadBlock, sse2)(srcp, srcStride, refp, refStride, 8);
+}
+
+UNCROSS_TARGET("sse2")
+static unsigned KERNEL(sad16x16, sse2)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return KERNEL(sadBlock, sse2)(srcp, srcStride, refp, refStride, 16);
+}
+
+UNCROSS_TARGET("sse2")
+static unsigned KERNEL(sad32x32, sse2)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return KERNEL(sadBlock, sse2)(srcp, srcStride, refp, refStride, 32);
+}
+
+UNCROSS_TARGET("avx2")
+static inline __m256i KERNEL(sadAccumulate, avx2)(__m256i sum, __m256i s, __m256i r) {
+	__m256i diff = _mm256_or_si256(_mm256_subs_epu16(s, r), _mm256_subs_epu16(r, s));
+#if BITS > 14
+	const __m256i zero = _mm256_setzero_si256();
+	return _mm256_add_epi32(sum, _mm256_add_epi32(_mm256_unpacklo_epi16(diff, zero), _mm256_unpackhi_epi16(diff, zero)));
+#else
+	return _mm256_add_epi32(sum, _mm256_madd_epi16(diff, _mm256_set1_epi16(1)));
+#endif
+}
+
+UNCROSS_TARGET("avx2")
+static inline unsigned KERNEL(sadBlock, avx2)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride, int size) {
+	__m256i sum = _mm256_setzero_si256();
+
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x += 16) {
+			sum = KERNEL(sadAccumulate, avx2)(sum, _mm256_loadu_si256((const __m256i *)(srcp + 2 * x)), _mm256_loadu_si256((const __m256i *)(refp + 2 * x)));
+		}
+
+		srcp += srcStride;
+		refp += refStride;
+	}
+
+	return horizontalSum32_avx2(sum);
+}
+
+UNCROSS_TARGET("avx2")
+static unsigned KERNEL(sad16x16, avx2)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return KERNEL(sadBlock, avx2)(srcp, srcStride, refp, refStride, 16);
+}
+
+UNCROSS_TARGET("avx2")
+static unsigned KERNEL(sad32x32, avx2)(const uint8_t *srcp, int srcStride, const uint8_t *refp, int refStride) {
+	return KERNEL(sadBlock, avx2)(srcp, srcStride, refp, refStride, 32);
+}
+
+// The saturated tests of the 8-bit kernels with bounds offset by UNIT, left to the scalar loop for thresholds up to UNIT.
+UNCROSS_TARGET("sse2")
+static void KERNEL(compensationErrorRow, sse2)(const uint8_t *srcp8, const uint8_t *compp8, uint8_t *dstp8, int width, int threshold) {
+	const uint16_t *srcp = (const uint16_t *)srcp8, *compp = (const uint16_t *)compp8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	const __m128i above = _mm_set1_epi16((short)VSMIN(threshold - UNIT - 1, 65535));
+	const __m128i below = _mm_set1_epi16((short)VSMIN(threshold + 2 * UNIT - 1, 65535));
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i pixelMax = _mm_set1_epi16((short)PIXEL_MAX);
+	int x = 0;
+
+	for (; threshold > UNIT && x + 8 <= width; x += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(srcp + x));
+		__m128i c = _mm_loadu_si128((const __m128i *)(compp + x));
+		__m128i cleanAbove = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_subs_epu16(s, c), above), zero);
+		__m128i cleanBelow = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_subs_epu16(c, s), below), zero);
+		__m128i mask = _mm_andnot_si128(_mm_and_si128(cleanAbove, cleanBelow), pixelMax);
+
+		_mm_storeu_si128((__m128i *)(dstp + x), mask);
+	}
+
+	KERNEL(compensationErrorRowRange, c)(srcp, compp, dstp, x, width, threshold);
+}
+
+UNCROSS_TARGET("avx2")
+static void KERNEL(compensationErrorRow, avx2)(const uint8_t *srcp8, const uint8_t *compp8, uint8_t *dstp8, int width, int threshold) {
+	const uint16_t *srcp = (const uint16_t *)srcp8, *compp = (const uint16_t *)compp8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	const __m256i above = _mm256_set1_epi16((short)VSMIN(threshold - UNIT - 1, 65535));
+	const __m256i below = _mm256_set1_epi16((short)VSMIN(threshold + 2 * UNIT - 1, 65535));
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i pixelMax = _mm256_set1_epi16((short)PIXEL_MAX);
+	int x = 0;
+
+	for (; threshold > UNIT && x + 16 <= width; x += 16) {
+		__m256i s = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		__m256i c = _mm256_loadu_si256((const __m256i *)(compp + x));
+		__m256i cleanAbove = _mm256_cmpeq_epi16(_mm256_subs_epu16(_mm256_subs_epu16(s, c), above), zero);
+		__m256i cleanBelow = _mm256_cmpeq_epi16(_mm256_subs_epu16(_mm256_subs_epu16(c, s), below), zero);
+		__m256i mask = _mm256_andnot_si256(_mm256_and_si256(cleanAbove, cleanBelow), pixelMax);
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), mask);
+	}
+
+	KERNEL(compensationErrorRowRange, c)(srcp, compp, dstp, x, width, threshold);
+}
+#endif
+
+#undef KERNEL
+#undef PIXEL_MAX
+#undef UNIT
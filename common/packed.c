@@ -0,0 +1,137 @@
+#include <string.h>
+#include "packed.h"
+
+// The scalar kernels double as the tail of the SIMD ones, starting at x, a multiple of 8.
+static void packMaskRange(const uint8_t *srcp, uint8_t *dstp, int x, int width) {
+	for (; x < width; x += 8) {
+		int bits = 0;
+
+		for (int i = 0; i < 8 && x + i < width; i++) {
+			bits |= (srcp[x + i] != 0) << i;
+		}
+
+		dstp[x >> 3] = (uint8_t)bits;
+	}
+}
+
+static void packMaskRange16(const uint16_t *srcp, uint8_t *dstp, int x, int width) {
+	for (; x < width; x += 8) {
+		int bits = 0;
+
+		for (int i = 0; i < 8 && x + i < width; i++) {
+			bits |= (srcp[x + i] != 0) << i;
+		}
+
+		dstp[x >> 3] = (uint8_t)bits;
+	}
+}
+
+static void unpackMaskRange(const uint8_t *srcp, uint8_t *dstp, int x, int width) {
+	for (; x < width; x++) {
+		dstp[x] = (srcp[x >> 3] >> (x & 7)) & 1 ? 255 : 0;
+	}
+}
+
+void packMaskRow_c(const uint8_t *srcp, uint8_t *dstp, int width) {
+	packMaskRange(srcp, dstp, 0, width);
+}
+
+void packMaskRow16_c(const uint8_t *srcp, uint8_t *dstp, int width) {
+	packMaskRange16((const uint16_t *)srcp, dstp, 0, width);
+}
+
+void unpackMaskRow_c(const uint8_t *srcp, uint8_t *dstp, int width) {
+	unpackMaskRange(srcp, dstp, 0, width);
+}
+
+#ifdef UNCROSS_X86
+// The movemask of the samples equal to zero has the inverse of the bits in pixel order.
+UNCROSS_TARGET("sse2")
+void packMaskRow_sse2(const uint8_t *srcp, uint8_t *dstp, int width) {
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(srcp + x));
+		uint16_t bits = (uint16_t)~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+
+		memcpy(dstp + (x >> 3), &bits, 2);
+	}
+
+	packMaskRange(srcp, dstp, x, width);
+}
+
+// Signed saturation keeps non-zero 16-bit samples non-zero when narrowing them to bytes.
+UNCROSS_TARGET("sse2")
+void packMaskRow16_sse2(const uint8_t *srcp, uint8_t *dstp, int width) {
+	const uint16_t *srcp16 = (const uint16_t *)srcp;
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i lo = _mm_loadu_si128((const __m128i *)(srcp16 + x));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(srcp16 + x + 8));
+		uint16_t bits = (uint16_t)~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_packs_epi16(lo, hi), zero));
+
+		memcpy(dstp + (x >> 3), &bits, 2);
+	}
+
+	packMaskRange16(srcp16, dstp, x, width);
+}
+
+UNCROSS_TARGET("avx2")
+void packMaskRow_avx2(const uint8_t *srcp, uint8_t *dstp, int width) {
+	const __m256i zero = _mm256_setzero_si256();
+	int x = 0;
+
+	for (; x + 32 <= width; x += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(srcp + x));
+		uint32_t bits = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+
+		memcpy(dstp + (x >> 3), &bits, 4);
+	}
+
+	packMaskRange(srcp, dstp, x, width);
+}
+
+// Two packed bytes are spread over the 16 bytes they cover and tested against the bit of each pixel.
+UNCROSS_TARGET("sse2")
+void unpackMaskRow_sse2(const uint8_t *srcp, uint8_t *dstp, int width) {
+	const __m128i bitMask = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+	int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i v = _mm_cvtsi32_si128(srcp[x >> 3] | srcp[(x >> 3) + 1] << 8);
+		v = _mm_unpacklo_epi8(v, v);
+		v = _mm_unpacklo_epi16(v, v);
+		v = _mm_unpacklo_epi32(v, v);
+
+		_mm_storeu_si128((__m128i *)(dstp + x), _mm_cmpeq_epi8(_mm_and_si128(v, bitMask), bitMask));
+	}
+
+	unpackMaskRange(srcp, dstp, x, width);
+}
+#endif
+
+// Select the fastest packing kernel for 1 or 2 bytes per sample available at the instruction set level cpu.
+PackMaskRowFunc selectPackMaskRow(int bytesPerSample, CpuLevel cpu) {
+#ifdef UNCROSS_X86
+	if (cpu >= cpuAVX2 && bytesPerSample == 1) {
+		return packMaskRow_avx2;
+	}
+	if (cpu >= cpuSSE2) {
+		return bytesPerSample == 1 ? packMaskRow_sse2 : packMaskRow16_sse2;
+	}
+#endif
+	return bytesPerSample == 1 ? packMaskRow_c : packMaskRow16_c;
+}
+
+// Select the fastest unpacking kernel available at the instruction set level cpu.
+UnpackMaskRowFunc selectUnpackMaskRow(CpuLevel cpu) {
+#ifdef UNCROSS_X86
+	if (cpu >= cpuSSE2) {
+		return unpackMaskRow_sse2;
+	}
+#endif
+	return unpackMaskRow_c;
+}
@@ -0,0 +1,40 @@
+#ifndef UNCROSS_PACKED_H
+#define UNCROSS_PACKED_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "simd.h"
+
+// Packed masks hold one bit per pixel in a GRAY8 frame of (width + 7) / 8 bytes per row: pixel x is
+// bit x % 8 of byte x / 8, and the bits past the width of the mask are undefined. Frame strides are
+// multiples of 32 bytes, so every row starts on a 64-bit boundary and can be combined a word at a time.
+// Packed frames carry the width of the mask they hold in this property.
+#define PACKED_WIDTH_PROP "_UncrossPacked"
+
+static inline int packedRowBytes(int width) {
+	return (width + 7) / 8;
+}
+
+// Packs a row of mask samples, setting the bit of every non-zero sample.
+typedef void (*PackMaskRowFunc)(const uint8_t *srcp, uint8_t *dstp, int width);
+
+// Unpacks a row into bytes of 0 and 255.
+typedef void (*UnpackMaskRowFunc)(const uint8_t *srcp, uint8_t *dstp, int width);
+
+void packMaskRow_c(const uint8_t *srcp, uint8_t *dstp, int width);
+void packMaskRow16_c(const uint8_t *srcp, uint8_t *dstp, int width);
+void unpackMaskRow_c(const uint8_t *srcp, uint8_t *dstp, int width);
+#ifdef UNCROSS_X86
+void packMaskRow_sse2(const uint8_t *srcp, uint8_t *dstp, int width);
+void packMaskRow16_sse2(const uint8_t *srcp, uint8_t *dstp, int width);
+void packMaskRow_avx2(const uint8_t *srcp, uint8_t *dstp, int width);
+void unpackMaskRow_sse2(const uint8_t *srcp, uint8_t *dstp, int width);
+#endif
+
+// Select the fastest packing kernel for 1 or 2 bytes per sample available at the instruction set level cpu.
+PackMaskRowFunc selectPackMaskRow(int bytesPerSample, CpuLevel cpu);
+
+// Select the fastest unpacking kernel available at the instruction set level cpu.
+UnpackMaskRowFunc selectUnpackMaskRow(CpuLevel cpu);
+
+#endif
@@ -0,0 +1,141 @@
+// clock_gettime is POSIX, hidden by -std=c99
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef CRITICAL_SECTION Mutex;
+
+#define mutexInit(m) InitializeCriticalSection(m)
+#define mutexDestroy(m) DeleteCriticalSection(m)
+#define mutexLock(m) EnterCriticalSection(m)
+#define mutexUnlock(m) LeaveCriticalSection(m)
+#else
+#include <pthread.h>
+#include <time.h>
+
+typedef pthread_mutex_t Mutex;
+
+#define mutexInit(m) pthread_mutex_init(m, NULL)
+#define mutexDestroy(m) pthread_mutex_destroy(m)
+#define mutexLock(m) pthread_mutex_lock(m)
+#define mutexUnlock(m) pthread_mutex_unlock(m)
+#endif
+
+struct Profile {
+	char name[32];
+	char nsKey[64];
+	char pixelsKey[64];
+
+	// frame times in nanoseconds, appended by concurrent frames under the lock
+	Mutex lock;
+	int64_t *times;
+	size_t count;
+	size_t capacity;
+	int64_t pixels;
+};
+
+Profile *createProfile(const char *name) {
+	Profile *profile = calloc(1, sizeof(Profile));
+
+	snprintf(profile->name, sizeof(profile->name), "%s", name);
+	snprintf(profile->nsKey, sizeof(profile->nsKey), "_Uncross%sNs", name);
+	snprintf(profile->pixelsKey, sizeof(profile->pixelsKey), "_Uncross%sPixels", name);
+	mutexInit(&profile->lock);
+	return profile;
+}
+
+static int compareTimes(const void *a, const void *b) {
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+	return (x > y) - (x < y);
+}
+
+void freeProfile(Profile *profile, const VSAPI *vsapi) {
+	if (!profile) {
+		return;
+	}
+
+	if (profile->count) {
+		char msg[256];
+		int64_t total = 0;
+
+		qsort(profile->times, profile->count, sizeof(int64_t), compareTimes);
+
+		for (size_t i = 0; i < profile->count; i++) {
+			total += profile->times[i];
+		}
+
+		// the smallest time that at least 99% of the frames do not exceed
+		size_t p99 = (profile->count * 99 + 99) / 100 - 1;
+
+		snprintf(msg, sizeof(msg), "%s: %zu frames, min %.3f ms, mean %.3f ms, p99 %.3f ms, %.1f Mpix/s",
+			profile->name, profile->count, profile->times[0] * 1e-6, total * 1e-6 / profile->count,
+			profile->times[p99] * 1e-6, total ? profile->pixels * 1e3 / total : 0.0);
+
+		// warnings are the lowest level that hosts show without a message handler of their own
+		vsapi->logMessage(mtWarning, msg);
+	}
+
+	mutexDestroy(&profile->lock);
+	free(profile->times);
+	free(profile);
+}
+
+int64_t profileClock(void) {
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (int64_t)(counter.QuadPart * (1e9 / frequency.QuadPart));
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+void profileFrame(Profile *profile, VSFrameRef *dst, int64_t start, int64_t pixels, const VSAPI *vsapi) {
+	if (!profile) {
+		return;
+	}
+
+	int64_t ns = profileClock() - start;
+
+	// frames passed through by reference are not writable
+	if (dst) {
+		VSMap *props = vsapi->getFramePropsRW(dst);
+
+		vsapi->propSetInt(props, profile->nsKey, ns, paReplace);
+		vsapi->propSetInt(props, profile->pixelsKey, pixels, paReplace);
+	}
+
+	mutexLock(&profile->lock);
+
+	if (profile->count == profile->capacity) {
+		size_t capacity = profile->capacity ? profile->capacity * 2 : 1024;
+		int64_t *times = realloc(profile->times, capacity * sizeof(int64_t));
+
+		if (!times) {
+			mutexUnlock(&profile->lock);
+			return;
+		}
+
+		profile->times = times;
+		profile->capacity = capacity;
+	}
+
+	profile->times[profile->count++] = ns;
+	profile->pixels += pixels;
+
+	mutexUnlock(&profile->lock);
+}
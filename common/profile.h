@@ -0,0 +1,24 @@
+#ifndef UNCROSS_PROFILE_H
+#define UNCROSS_PROFILE_H
+
+#include <stdint.h>
+#include <VapourSynth.h>
+
+// Frame timing of one filter instance, enabled with profile=1. Each frame gets the wall time spent
+// producing it and the number of luma pixels processed as the _Uncross<name>Ns and _Uncross<name>Pixels
+// properties, and the minimum, mean and 99th percentile are logged when the filter is freed.
+typedef struct Profile Profile;
+
+Profile *createProfile(const char *name);
+
+// Log the statistics and free the profile. Does nothing when profile is NULL.
+void freeProfile(Profile *profile, const VSAPI *vsapi);
+
+// Monotonic time in nanoseconds, to be passed to profileFrame as the start of a frame.
+int64_t profileClock(void);
+
+// Record a frame started at start and set its properties on dst, unless dst is NULL for a source frame
+// passed through as is. Does nothing when profile is NULL.
+void profileFrame(Profile *profile, VSFrameRef *dst, int64_t start, int64_t pixels, const VSAPI *vsapi);
+
+#endif
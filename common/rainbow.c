@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <VSHelper.h>
+#include "rainbow.h"
+
+// Scalar reference for the rainbow row kernel, also used for the tail of the SIMD kernels.
+static void rainbowRowRange(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int x, int width, const RainbowParams *params) {
+	for (; x < width; x++) {
+		dstp[x] = 0;
+
+		int du = abs(srcpu[x] - prepu[x]);
+		int dv = abs(srcpv[x] - prepv[x]);
+
+		if (
+			srcpy[x] > params->threshY
+			&& ((params->threshU1 < du && du < params->threshU2)
+			|| (params->threshV1 < dv && dv < params->threshV2))
+			) {
+			dstp[x] = 255;
+		}
+	}
+}
+
+void rainbowRow_c(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params) {
+	rainbowRowRange(srcpy, srcpu, srcpv, prepu, prepv, dstp, 0, width, params);
+}
+
+// Convert the exclusive integer thresholds into inclusive ranges of bits-bit samples. Ranges that
+// cannot match any sample are encoded as min = maximum sample value, max = 0.
+void initRainbowRanges(RainbowParams *params, int bits) {
+	RainbowRanges *r = &params->ranges;
+	int pixelMax = (1 << bits) - 1;
+	int uMin = params->threshU1 + 1, uMax = VSMIN(params->threshU2 - 1, pixelMax);
+	int vMin = params->threshV1 + 1, vMax = VSMIN(params->threshV2 - 1, pixelMax);
+
+	if (uMin > uMax) {
+		uMin = pixelMax;
+		uMax = 0;
+	}
+	if (vMin > vMax) {
+		vMin = pixelMax;
+		vMax = 0;
+	}
+
+	r->uMin = uMin;
+	r->uMax = uMax;
+	r->vMin = vMin;
+	r->vMax = vMax;
+
+	// no luma value can pass, so neither can any pixel
+	if (params->threshY >= pixelMax) {
+		r->yMin = pixelMax;
+		r->uMin = r->vMin = pixelMax;
+		r->uMax = r->vMax = 0;
+	}
+	else {
+		r->yMin = params->threshY + 1;
+	}
+}
+
+// Scalar kernel for subsampled chroma: each luma pixel is tested against the chroma sample covering it.
+// Also used for the tail of the SIMD kernels for horizontally halved chroma.
+static void rainbowRowSubsampledRange(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int x, int width, int ssW, const RainbowParams *params) {
+	for (; x < width; x++) {
+		int cx = x >> ssW;
+		int du = abs(srcpu[cx] - prepu[cx]);
+		int dv = abs(srcpv[cx] - prepv[cx]);
+
+		dstp[x] = 0;
+
+		if (
+			srcpy[x] > params->threshY
+			&& ((params->threshU1 < du && du < params->threshU2)
+			|| (params->threshV1 < dv && dv < params->threshV2))
+			) {
+			dstp[x] = 255;
+		}
+	}
+}
+
+void rainbowRowSubsampled_c(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, int ssW, const RainbowParams *params) {
+	rainbowRowSubsampledRange(srcpy, srcpu, srcpv, prepu, prepv, dstp, 0, width, ssW, params);
+}
+
+void rainbowRowHalf_c(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params) {
+	rainbowRowSubsampledRange(srcpy, srcpu, srcpv, prepu, prepv, dstp, 0, width, 1, params);
+}
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+static inline __m128i inRange_sse2(__m128i v, __m128i lo, __m128i hi) {
+	return _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, lo), v), _mm_cmpeq_epi8(_mm_min_epu8(v, hi), v));
+}
+
+UNCROSS_TARGET("sse2")
+static inline __m128i absDiff_sse2(__m128i a, __m128i b) {
+	return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+
+UNCROSS_TARGET("sse2")
+void rainbowRow_sse2(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params) {
+	const RainbowRanges *r = &params->ranges;
+	const __m128i yMin = _mm_set1_epi8((char)r->yMin);
+	const __m128i uMin = _mm_set1_epi8((char)r->uMin);
+	const __m128i uMax = _mm_set1_epi8((char)r->uMax);
+	const __m128i vMin = _mm_set1_epi8((char)r->vMin);
+	const __m128i vMax = _mm_set1_epi8((char)r->vMax);
+	int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i sy = _mm_loadu_si128((const __m128i *)(srcpy + x));
+		__m128i du = absDiff_sse2(_mm_loadu_si128((const __m128i *)(srcpu + x)), _mm_loadu_si128((const __m128i *)(prepu + x)));
+		__m128i dv = absDiff_sse2(_mm_loadu_si128((const __m128i *)(srcpv + x)), _mm_loadu_si128((const __m128i *)(prepv + x)));
+
+		__m128i mask = _mm_or_si128(inRange_sse2(du, uMin, uMax), inRange_sse2(dv, vMin, vMax));
+		mask = _mm_and_si128(mask, _mm_cmpeq_epi8(_mm_max_epu8(sy, yMin), sy));
+
+		_mm_storeu_si128((__m128i *)(dstp + x), mask);
+	}
+
+	rainbowRowRange(srcpy, srcpu, srcpv, prepu, prepv, dstp, x, width, params);
+}
+
+// Chroma is tested at its own resolution on 8 samples, then each result byte is doubled to cover two luma pixels.
+UNCROSS_TARGET("sse2")
+void rainbowRowHalf_sse2(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params) {
+	const RainbowRanges *r = &params->ranges;
+	const __m128i yMin = _mm_set1_epi8((char)r->yMin);
+	const __m128i uMin = _mm_set1_epi8((char)r->uMin);
+	const __m128i uMax = _mm_set1_epi8((char)r->uMax);
+	const __m128i vMin = _mm_set1_epi8((char)r->vMin);
+	const __m128i vMax = _mm_set1_epi8((char)r->vMax);
+	int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		int cx = x >> 1;
+		__m128i sy = _mm_loadu_si128((const __m128i *)(srcpy + x));
+		__m128i du = absDiff_sse2(_mm_loadl_epi64((const __m128i *)(srcpu + cx)), _mm_loadl_epi64((const __m128i *)(prepu + cx)));
+		__m128i dv = absDiff_sse2(_mm_loadl_epi64((const __m128i *)(srcpv + cx)), _mm_loadl_epi64((const __m128i *)(prepv + cx)));
+
+		__m128i chroma = _mm_or_si128(inRange_sse2(du, uMin, uMax), inRange_sse2(dv, vMin, vMax));
+		__m128i mask = _mm_and_si128(_mm_unpacklo_epi8(chroma, chroma), _mm_cmpeq_epi8(_mm_max_epu8(sy, yMin), sy));
+
+		_mm_storeu_si128((__m128i *)(dstp + x), mask);
+	}
+
+	rainbowRowSubsampledRange(srcpy, srcpu, srcpv, prepu, prepv, dstp, x, width, 1, params);
+}
+
+UNCROSS_TARGET("avx2")
+static inline __m256i inRange_avx2(__m256i v, __m256i lo, __m256i hi) {
+	return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v, lo), v), _mm256_cmpeq_epi8(_mm256_min_epu8(v, hi), v));
+}
+
+UNCROSS_TARGET("avx2")
+static inline __m256i absDiff_avx2(__m256i a, __m256i b) {
+	return _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+}
+
+UNCROSS_TARGET("avx2")
+void rainbowRow_avx2(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params) {
+	const RainbowRanges *r = &params->ranges;
+	const __m256i yMin = _mm256_set1_epi8((char)r->yMin);
+	const __m256i uMin = _mm256_set1_epi8((char)r->uMin);
+	const __m256i uMax = _mm256_set1_epi8((char)r->uMax);
+	const __m256i vMin = _mm256_set1_epi8((char)r->vMin);
+	const __m256i vMax = _mm256_set1_epi8((char)r->vMax);
+	int x = 0;
+
+	for (; x + 32 <= width; x += 32) {
+		__m256i sy = _mm256_loadu_si256((const __m256i *)(srcpy + x));
+		__m256i du = absDiff_avx2(_mm256_loadu_si256((const __m256i *)(srcpu + x)), _mm256_loadu_si256((const __m256i *)(prepu + x)));
+		__m256i dv = absDiff_avx2(_mm256_loadu_si256((const __m256i *)(srcpv + x)), _mm256_loadu_si256((const __m256i *)(prepv + x)));
+
+		__m256i mask = _mm256_or_si256(inRange_avx2(du, uMin, uMax), inRange_avx2(dv, vMin, vMax));
+		mask = _mm256_and_si256(mask, _mm256_cmpeq_epi8(_mm256_max_epu8(sy, yMin), sy));
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), mask);
+	}
+
+	rainbowRowRange(srcpy, srcpu, srcpv, prepu, prepv, dstp, x, width, params);
+}
+// 16 chroma samples are tested with SSE registers and spread over the 32 luma pixels they cover.
+UNCROSS_TARGET("avx2")
+void rainbowRowHalf_avx2(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params) {
+	const RainbowRanges *r = &params->ranges;
+	const __m256i yMin = _mm256_set1_epi8((char)r->yMin);
+	const __m128i uMin = _mm_set1_epi8((char)r->uMin);
+	const __m128i uMax = _mm_set1_epi8((char)r->uMax);
+	const __m128i vMin = _mm_set1_epi8((char)r->vMin);
+	const __m128i vMax = _mm_set1_epi8((char)r->vMax);
+	int x = 0;
+
+	for (; x + 32 <= width; x += 32) {
+		int cx = x >> 1;
+		__m256i sy = _mm256_loadu_si256((const __m256i *)(srcpy + x));
+		__m128i du = absDiff_sse2(_mm_loadu_si128((const __m128i *)(srcpu + cx)), _mm_loadu_si128((const __m128i *)(prepu + cx)));
+		__m128i dv = absDiff_sse2(_mm_loadu_si128((const __m128i *)(srcpv + cx)), _mm_loadu_si128((const __m128i *)(prepv + cx)));
+
+		__m128i chroma = _mm_or_si128(inRange_sse2(du, uMin, uMax), inRange_sse2(dv, vMin, vMax));
+		__m256i spread = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi8(chroma, chroma)), _mm_unpackhi_epi8(chroma, chroma), 1);
+		__m256i mask = _mm256_and_si256(spread, _mm256_cmpeq_epi8(_mm256_max_epu8(sy, yMin), sy));
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), mask);
+	}
+
+	rainbowRowSubsampledRange(srcpy, srcpu, srcpv, prepu, prepv, dstp, x, width, 1, params);
+}
+#endif
+
+#ifdef UNCROSS_X86
+// Unsigned 16-bit comparisons for samples above 8 bits. SSE2 has no unsigned 16-bit min or max,
+// but v >= lo and v <= hi are the same as sat(lo - v) == 0 and sat(v - hi) == 0.
+UNCROSS_TARGET("sse2")
+static inline __m128i inRange16_sse2(__m128i v, __m128i lo, __m128i hi) {
+	return _mm_cmpeq_epi16(_mm_or_si128(_mm_subs_epu16(lo, v), _mm_subs_epu16(v, hi)), _mm_setzero_si128());
+}
+
+UNCROSS_TARGET("sse2")
+static inline __m128i absDiff16_sse2(__m128i a, __m128i b) {
+	return _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a));
+}
+
+UNCROSS_TARGET("avx2")
+static inline __m256i inRange16_avx2(__m256i v, __m256i lo, __m256i hi) {
+	return _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_max_epu16(v, lo), v), _mm256_cmpeq_epi16(_mm256_min_epu16(v, hi), v));
+}
+
+UNCROSS_TARGET("avx2")
+static inline __m256i absDiff16_avx2(__m256i a, __m256i b) {
+	return _mm256_or_si256(_mm256_subs_epu16(a, b), _mm256_subs_epu16(b, a));
+}
+#endif
+
+#define BITS 10
+#include "rainbow_template.h"
+#undef BITS
+#define BITS 12
+#include "rainbow_template.h"
+#undef BITS
+#define BITS 16
+#include "rainbow_template.h"
+#undef BITS
+
+// Select the fastest row kernel for a bit depth (8, 10, 12 or 16) and chroma subsampled
+// horizontally by ssW (0 or 1) available at the instruction set level cpu.
+RainbowRowFunc selectRainbowRow(int ssW, int bits, CpuLevel cpu) {
+#ifdef UNCROSS_X86
+	if (cpu >= cpuAVX2) {
+		switch (bits) {
+		case 10: return ssW ? rainbowRowHalf10_avx2 : rainbowRow10_avx2;
+		case 12: return ssW ? rainbowRowHalf12_avx2 : rainbowRow12_avx2;
+		case 16: return ssW ? rainbowRowHalf16_avx2 : rainbowRow16_avx2;
+		default: return ssW ? rainbowRowHalf_avx2 : rainbowRow_avx2;
+		}
+	}
+	if (cpu >= cpuSSE2) {
+		switch (bits) {
+		case 10: return ssW ? rainbowRowHalf10_sse2 : rainbowRow10_sse2;
+		case 12: return ssW ? rainbowRowHalf12_sse2 : rainbowRow12_sse2;
+		case 16: return ssW ? rainbowRowHalf16_sse2 : rainbowRow16_sse2;
+		default: return ssW ? rainbowRowHalf_sse2 : rainbowRow_sse2;
+		}
+	}
+#endif
+	switch (bits) {
+	case 10: return ssW ? rainbowRowHalf10_c : rainbowRow10_c;
+	case 12: return ssW ? rainbowRowHalf12_c : rainbowRow12_c;
+	case 16: return ssW ? rainbowRowHalf16_c : rainbowRow16_c;
+	default: return ssW ? rainbowRowHalf_c : rainbowRow_c;
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef UNCROSS_RAINBOW_H
+#define UNCROSS_RAINBOW_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "simd.h"
+
+// Inclusive sample ranges equivalent to the thresholds, used by the SIMD kernels.
+// A pixel is flagged when y >= yMin and either du or dv lies in [min, max].
+typedef struct {
+	uint16_t yMin;
+	uint16_t uMin;
+	uint16_t uMax;
+	uint16_t vMin;
+	uint16_t vMax;
+} RainbowRanges;
+
+// A pixel is flagged when y > threshY and either threshU1 < du < threshU2 or threshV1 < dv < threshV2,
+// where du and dv are the chroma differences to the previous frame.
+typedef struct {
+	int threshY;
+	int threshU1;
+	int threshV1;
+	int threshU2;
+	int threshV2;
+
+	RainbowRanges ranges;
+} RainbowParams;
+
+// Processes one row of the rainbow map from the Y/U/V planes of the current frame and the U/V planes of the previous one.
+// Rows are passed as bytes at every bit depth: kernels for more than 8 bits read and write uint16_t samples
+// and set flagged pixels to the maximum value of the bit depth instead of 255.
+typedef void (*RainbowRowFunc)(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params);
+
+// Fill in the ranges of params from its thresholds for bits-bit samples. Must be called before using any kernel.
+void initRainbowRanges(RainbowParams *params, int bits);
+
+void rainbowRow_c(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params);
+#ifdef UNCROSS_X86
+void rainbowRow_sse2(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params);
+void rainbowRow_avx2(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params);
+#endif
+
+// Same test with chroma rows at half the luma width (4:2:0, 4:2:2), each chroma sample covering two luma pixels.
+void rainbowRowHalf_c(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params);
+#ifdef UNCROSS_X86
+void rainbowRowHalf_sse2(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params);
+void rainbowRowHalf_avx2(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params);
+#endif
+
+// Same test with chroma rows subsampled horizontally by any ssW.
+void rainbowRowSubsampled_c(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, int ssW, const RainbowParams *params);
+
+// Select the fastest row kernel for a bit depth (8, 10, 12 or 16) and chroma subsampled
+// horizontally by ssW (0 or 1) available at the instruction set level cpu.
+RainbowRowFunc selectRainbowRow(int ssW, int bits, CpuLevel cpu);
+
+#endif
@@ -0,0 +1,154 @@
+// Rainbow row kernels for BITS-bit samples stored as uint16_t. Included from rainbow.c
+// once per bit depth with BITS defined; this file deliberately has no include guard.
+#define KERNEL(name, isa) KERNEL_NAME(name, BITS, isa)
+#define PIXEL_MAX ((1 << BITS) - 1)
+
+// Scalar reference for chroma subsampled horizontally by ssW (0 for full width chroma),
+// also used for the tail of the SIMD kernels.
+static void KERNEL(rainbowRowRange, c)(const uint16_t *srcpy, const uint16_t *srcpu, const uint16_t *srcpv, const uint16_t *prepu, const uint16_t *prepv, uint16_t *dstp, int x, int width, int ssW, const RainbowParams *params) {
+	for (; x < width; x++) {
+		int cx = x >> ssW;
+		int du = abs(srcpu[cx] - prepu[cx]);
+		int dv = abs(srcpv[cx] - prepv[cx]);
+
+		dstp[x] = 0;
+
+		if (
+			srcpy[x] > params->threshY
+			&& ((params->threshU1 < du && du < params->threshU2)
+			|| (params->threshV1 < dv && dv < params->threshV2))
+			) {
+			dstp[x] = PIXEL_MAX;
+		}
+	}
+}
+
+static void KERNEL(rainbowRow, c)(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params) {
+	KERNEL(rainbowRowRange, c)((const uint16_t *)srcpy, (const uint16_t *)srcpu, (const uint16_t *)srcpv, (const uint16_t *)prepu, (const uint16_t *)prepv, (uint16_t *)dstp, 0, width, 0, params);
+}
+
+static void KERNEL(rainbowRowHalf, c)(const uint8_t *srcpy, const uint8_t *srcpu, const uint8_t *srcpv, const uint8_t *prepu, const uint8_t *prepv, uint8_t *dstp, int width, const RainbowParams *params) {
+	KERNEL(rainbowRowRange, c)((const uint16_t *)srcpy, (const uint16_t *)srcpu, (const uint16_t *)srcpv, (const uint16_t *)prepu, (const uint16_t *)prepv, (uint16_t *)dstp, 0, width, 1, params);
+}
+
+#ifdef UNCROSS_X86
+UNCROSS_TARGET("sse2")
+static void KERNEL(rainbowRow, sse2)(const uint8_t *srcpy8, const uint8_t *srcpu8, const uint8_t *srcpv8, const uint8_t *prepu8, const uint8_t *prepv8, uint8_t *dstp8, int width, const RainbowParams *params) {
+	const uint16_t *srcpy = (const uint16_t *)srcpy8, *srcpu = (const uint16_t *)srcpu8, *srcpv = (const uint16_t *)srcpv8;
+	const uint16_t *prepu = (const uint16_t *)prepu8, *prepv = (const uint16_t *)prepv8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	const RainbowRanges *r = &params->ranges;
+	const __m128i yMin = _mm_set1_epi16((short)r->yMin);
+	const __m128i uMin = _mm_set1_epi16((short)r->uMin);
+	const __m128i uMax = _mm_set1_epi16((short)r->uMax);
+	const __m128i vMin = _mm_set1_epi16((short)r->vMin);
+	const __m128i vMax = _mm_set1_epi16((short)r->vMax);
+	const __m128i pixelMax = _mm_set1_epi16((short)PIXEL_MAX);
+	int x = 0;
+
+	for (; x + 8 <= width; x += 8) {
+		__m128i sy = _mm_loadu_si128((const __m128i *)(srcpy + x));
+		__m128i du = absDiff16_sse2(_mm_loadu_si128((const __m128i *)(srcpu + x)), _mm_loadu_si128((const __m128i *)(prepu + x)));
+		__m128i dv = absDiff16_sse2(_mm_loadu_si128((const __m128i *)(srcpv + x)), _mm_loadu_si128((const __m128i *)(prepv + x)));
+
+		__m128i mask = _mm_or_si128(inRange16_sse2(du, uMin, uMax), inRange16_sse2(dv, vMin, vMax));
+		mask = _mm_and_si128(mask, _mm_cmpeq_epi16(_mm_subs_epu16(yMin, sy), _mm_setzero_si128()));
+
+		_mm_storeu_si128((__m128i *)(dstp + x), _mm_and_si128(mask, pixelMax));
+	}
+
+	KERNEL(rainbowRowRange, c)(srcpy, srcpu, srcpv, prepu, prepv, dstp, x, width, 0, params);
+}
+
+// Chroma is tested at its own resolution on 4 samples, then each result is doubled to cover two luma pixels.
+UNCROSS_TARGET("sse2")
+static void KERNEL(rainbowRowHalf, sse2)(const uint8_t *srcpy8, const uint8_t *srcpu8, const uint8_t *srcpv8, const uint8_t *prepu8, const uint8_t *prepv8, uint8_t *dstp8, int width, const RainbowParams *params) {
+	const uint16_t *srcpy = (const uint16_t *)srcpy8, *srcpu = (const uint16_t *)srcpu8, *srcpv = (const uint16_t *)srcpv8;
+	const uint16_t *prepu = (const uint16_t *)prepu8, *prepv = (const uint16_t *)prepv8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	const RainbowRanges *r = &params->ranges;
+	const __m128i yMin = _mm_set1_epi16((short)r->yMin);
+	const __m128i uMin = _mm_set1_epi16((short)r->uMin);
+	const __m128i uMax = _mm_set1_epi16((short)r->uMax);
+	const __m128i vMin = _mm_set1_epi16((short)r->vMin);
+	const __m128i vMax = _mm_set1_epi16((short)r->vMax);
+	const __m128i pixelMax = _mm_set1_epi16((short)PIXEL_MAX);
+	int x = 0;
+
+	for (; x + 8 <= width; x += 8) {
+		int cx = x >> 1;
+		__m128i sy = _mm_loadu_si128((const __m128i *)(srcpy + x));
+		__m128i du = absDiff16_sse2(_mm_loadl_epi64((const __m128i *)(srcpu + cx)), _mm_loadl_epi64((const __m128i *)(prepu + cx)));
+		__m128i dv = absDiff16_sse2(_mm_loadl_epi64((const __m128i *)(srcpv + cx)), _mm_loadl_epi64((const __m128i *)(prepv + cx)));
+
+		__m128i chroma = _mm_or_si128(inRange16_sse2(du, uMin, uMax), inRange16_sse2(dv, vMin, vMax));
+		__m128i mask = _mm_and_si128(_mm_unpacklo_epi16(chroma, chroma), _mm_cmpeq_epi16(_mm_subs_epu16(yMin, sy), _mm_setzero_si128()));
+
+		_mm_storeu_si128((__m128i *)(dstp + x), _mm_and_si128(mask, pixelMax));
+	}
+
+	KERNEL(rainbowRowRange, c)(srcpy, srcpu, srcpv, prepu, prepv, dstp, x, width, 1, params);
+}
+
+UNCROSS_TARGET("avx2")
+static void KERNEL(rainbowRow, avx2)(const uint8_t *srcpy8, const uint8_t *srcpu8, const uint8_t *srcpv8, const uint8_t *prepu8, const uint8_t *prepv8, uint8_t *dstp8, int width, const RainbowParams *params) {
+	const uint16_t *srcpy = (const uint16_t *)srcpy8, *srcpu = (const uint16_t *)srcpu8, *srcpv = (const uint16_t *)srcpv8;
+	const uint16_t *prepu = (const uint16_t *)prepu8, *prepv = (const uint16_t *)prepv8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	const RainbowRanges *r = &params->ranges;
+	const __m256i yMin = _mm256_set1_epi16((short)r->yMin);
+	const __m256i uMin = _mm256_set1_epi16((short)r->uMin);
+	const __m256i uMax = _mm256_set1_epi16((short)r->uMax);
+	const __m256i vMin = _mm256_set1_epi16((short)r->vMin);
+	const __m256i vMax = _mm256_set1_epi16((short)r->vMax);
+	const __m256i pixelMax = _mm256_set1_epi16((short)PIXEL_MAX);
+	int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m256i sy = _mm256_loadu_si256((const __m256i *)(srcpy + x));
+		__m256i du = absDiff16_avx2(_mm256_loadu_si256((const __m256i *)(srcpu + x)), _mm256_loadu_si256((const __m256i *)(prepu + x)));
+		__m256i dv = absDiff16_avx2(_mm256_loadu_si256((const __m256i *)(srcpv + x)), _mm256_loadu_si256((const __m256i *)(prepv + x)));
+
+		__m256i mask = _mm256_or_si256(inRange16_avx2(du, uMin, uMax), inRange16_avx2(dv, vMin, vMax));
+		mask = _mm256_and_si256(mask, _mm256_cmpeq_epi16(_mm256_max_epu16(sy, yMin), sy));
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), _mm256_and_si256(mask, pixelMax));
+	}
+
+	KERNEL(rainbowRowRange, c)(srcpy, srcpu, srcpv, prepu, prepv, dstp, x, width, 0, params);
+}
+
+// 8 chroma samples are tested with SSE registers and spread over the 16 luma pixels they cover.
+UNCROSS_TARGET("avx2")
+static void KERNEL(rainbowRowHalf, avx2)(const uint8_t *srcpy8, const uint8_t *srcpu8, const uint8_t *srcpv8, const uint8_t *prepu8, const uint8_t *prepv8, uint8_t *dstp8, int width, const RainbowParams *params) {
+	const uint16_t *srcpy = (const uint16_t *)srcpy8, *srcpu = (const uint16_t *)srcpu8, *srcpv = (const uint16_t *)srcpv8;
+	const uint16_t *prepu = (const uint16_t *)prepu8, *prepv = (const uint16_t *)prepv8;
+	uint16_t *dstp = (uint16_t *)dstp8;
+	const RainbowRanges *r = &params->ranges;
+	const __m256i yMin = _mm256_set1_epi16((short)r->yMin);
+	const __m128i uMin = _mm_set1_epi16((short)r->uMin);
+	const __m128i uMax = _mm_set1_epi16((short)r->uMax);
+	const __m128i vMin = _mm_set1_epi16((short)r->vMin);
+	const __m128i vMax = _mm_set1_epi16((short)r->vMax);
+	const __m256i pixelMax = _mm256_set1_epi16((short)PIXEL_MAX);
+	int x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		int cx = x >> 1;
+		__m256i sy = _mm256_loadu_si256((const __m256i *)(srcpy + x));
+		__m128i du = absDiff16_sse2(_mm_loadu_si128((const __m128i *)(srcpu + cx)), _mm_loadu_si128((const __m128i *)(prepu + cx)));
+		__m128i dv = absDiff16_sse2(_mm_loadu_si128((const __m128i *)(srcpv + cx)), _mm_loadu_si128((const __m128i *)(prepv + cx)));
+
+		__m128i chroma = _mm_or_si128(inRange16_sse2(du, uMin, uMax), inRange16_sse2(dv, vMin, vMax));
+		__m256i spread = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(chroma, chroma)), _mm_unpackhi_epi16(chroma, chroma), 1);
+		__m256i mask = _mm256_and_si256(spread, _mm256_cmpeq_epi16(_mm256_max_epu16(sy, yMin), sy));
+
+		_mm256_storeu_si256((__m256i *)(dstp + x), _mm256_and_si256(mask, pixelMax));
+	}
+
+	KERNEL(rainbowRowRange, c)(srcpy, srcpu, srcpv, prepu, prepv, dstp, x, width, 1, params);
+}
+#endif
+
+#undef KERNEL
+#undef PIXEL_MAX
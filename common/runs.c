@@ -0,0 +1,257 @@
+#include <string.h>
+#include "runs.h"
+
+#define ONES8 0x0101010101010101ULL
+#define HIGHS8 0x8080808080808080ULL
+#define ONES16 0x0001000100010001ULL
+#define HIGHS16 0x8000800080008000ULL
+
+// Index of the lowest set bit of a non-zero word.
+static inline int lowestBit(uint64_t v) {
+#ifdef __GNUC__
+	return __builtin_ctzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long i;
+	_BitScanForward64(&i, v);
+	return (int)i;
+#else
+	int i = 0;
+
+	while (!(v & 1)) {
+		v >>= 1;
+		i++;
+	}
+
+	return i;
+#endif
+}
+
+// The runs found so far. start is the first pixel of the open run, or -1 between runs.
+typedef struct {
+	int *runs;
+	int count;
+	int start;
+} RunScan;
+
+// Adds the flags of n pixels starting at x, bit i of bits for pixel x + i, with n at most 64.
+// A word without a change of state is passed over with a single test.
+static void scanBits(RunScan *s, uint64_t bits, int x, int n) {
+	uint64_t valid = n < 64 ? ((uint64_t)1 << n) - 1 : ~(uint64_t)0;
+	int i = 0;
+
+	bits &= valid;
+
+	while (i < n) {
+		uint64_t rest = (s->start < 0 ? bits : ~bits & valid) >> i;
+
+		if (!rest)
+			return;
+
+		i += lowestBit(rest);
+
+		if (s->start < 0) {
+			s->start = x + i;
+		}
+		else {
+			s->runs[2 * s->count] = s->start;
+			s->runs[2 * s->count + 1] = x + i;
+			s->count++;
+			s->start = -1;
+		}
+	}
+}
+
+static int finishRuns(RunScan *s, int width) {
+	if (s->start >= 0) {
+		s->runs[2 * s->count] = s->start;
+		s->runs[2 * s->count + 1] = width;
+		s->count++;
+	}
+
+	return s->count;
+}
+
+// The scalar kernels double as the tail of the SIMD ones, starting at x. Flags are gathered 64
+// pixels at a time from 8-byte words, looking at single samples only in words holding both clean
+// and flagged ones.
+static void scanMaskRange(RunScan *s, const uint8_t *srcp, int x, int width) {
+	while (x < width) {
+		int n = width - x < 64 ? width - x : 64;
+		uint64_t bits = 0;
+		int i = 0;
+
+		for (; i + 8 <= n; i += 8) {
+			uint64_t v;
+			memcpy(&v, srcp + x + i, sizeof(v));
+
+			if (!v)
+				continue;
+
+			// no zero byte
+			if (!((v - ONES8) & ~v & HIGHS8)) {
+				bits |= (uint64_t)0xFF << i;
+				continue;
+			}
+
+			for (int j = 0; j < 8; j++) {
+				bits |= (uint64_t)(srcp[x + i + j] != 0) << (i + j);
+			}
+		}
+
+		for (; i < n; i++) {
+			bits |= (uint64_t)(srcp[x + i] != 0) << i;
+		}
+
+		scanBits(s, bits, x, n);
+		x += n;
+	}
+}
+
+int maskRuns_c(const uint8_t *srcp, int width, int *runs) {
+	RunScan s = { runs, 0, -1 };
+	scanMaskRange(&s, srcp, 0, width);
+	return finishRuns(&s, width);
+}
+
+int maskRuns16_c(const uint8_t *srcp, int width, int *runs) {
+	const uint16_t *srcp16 = (const uint16_t *)srcp;
+	RunScan s = { runs, 0, -1 };
+
+	for (int x = 0; x < width; x += 64) {
+		int n = width - x < 64 ? width - x : 64;
+		uint64_t bits = 0;
+		int i = 0;
+
+		for (; i + 4 <= n; i += 4) {
+			uint64_t v;
+			memcpy(&v, srcp16 + x + i, sizeof(v));
+
+			if (!v)
+				continue;
+
+			// no zero sample
+			if (!((v - ONES16) & ~v & HIGHS16)) {
+				bits |= (uint64_t)0xF << i;
+				continue;
+			}
+
+			for (int j = 0; j < 4; j++) {
+				bits |= (uint64_t)(srcp16[x + i + j] != 0) << (i + j);
+			}
+		}
+
+		for (; i < n; i++) {
+			bits |= (uint64_t)(srcp16[x + i] != 0) << i;
+		}
+
+		scanBits(&s, bits, x, n);
+	}
+
+	return finishRuns(&s, width);
+}
+
+// 64 pixels of a packed row are one word of flags as they are.
+int packedMaskRuns_c(const uint8_t *srcp, int width, int *runs) {
+	int bytes = (width + 7) / 8;
+	RunScan s = { runs, 0, -1 };
+
+	for (int i = 0; i < bytes; i += 8) {
+		uint64_t v = 0;
+		int n = bytes - i < 8 ? bytes - i : 8;
+
+		for (int j = 0; j < n; j++) {
+			v |= (uint64_t)srcp[i + j] << (8 * j);
+		}
+
+		// scanBits ignores the padding bits past the width
+		scanBits(&s, v, i * 8, width - i * 8 < 64 ? width - i * 8 : 64);
+	}
+
+	return finishRuns(&s, width);
+}
+
+#ifdef UNCROSS_X86
+// The comparisons give the clean pixels of 64 bytes as one word, whose complement is scanned.
+UNCROSS_TARGET("sse2")
+int maskRuns_sse2(const uint8_t *srcp, int width, int *runs) {
+	const __m128i zero = _mm_setzero_si128();
+	RunScan s = { runs, 0, -1 };
+	int x = 0;
+
+	for (; x + 64 <= width; x += 64) {
+		uint64_t clean = 0;
+
+		for (int i = 0; i < 64; i += 16) {
+			clean |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(srcp + x + i)), zero)) << i;
+		}
+
+		scanBits(&s, ~clean, x, 64);
+	}
+
+	scanMaskRange(&s, srcp, x, width);
+	return finishRuns(&s, width);
+}
+
+UNCROSS_TARGET("avx2")
+int maskRuns_avx2(const uint8_t *srcp, int width, int *runs) {
+	const __m256i zero = _mm256_setzero_si256();
+	RunScan s = { runs, 0, -1 };
+	int x = 0;
+
+	for (; x + 64 <= width; x += 64) {
+		uint32_t lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(srcp + x)), zero));
+		uint32_t hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(srcp + x + 32)), zero));
+
+		scanBits(&s, ~((uint64_t)hi << 32 | lo), x, 64);
+	}
+
+	scanMaskRange(&s, srcp, x, width);
+	return finishRuns(&s, width);
+}
+#endif
+
+// Select the fastest run kernel for 1 or 2 bytes per sample or packed rows available at the instruction set level cpu.
+MaskRunsFunc selectMaskRuns(int bytesPerSample, int packed, CpuLevel cpu) {
+	if (packed) {
+		return packedMaskRuns_c;
+	}
+	if (bytesPerSample == 2) {
+		return maskRuns16_c;
+	}
+#ifdef UNCROSS_X86
+	if (cpu >= cpuAVX2) {
+		return maskRuns_avx2;
+	}
+	if (cpu >= cpuSSE2) {
+		return maskRuns_sse2;
+	}
+#endif
+	return maskRuns_c;
+}
+
+// Write the union of two lists of runs to dst, merging runs that overlap or touch, and return the
+// number of runs. dst must hold numA + numB runs and be neither a nor b.
+int mergeRuns(const int *a, int numA, const int *b, int numB, int *dst) {
+	int i = 0, j = 0, count = 0;
+
+	while (i < numA || j < numB) {
+		const int *run;
+
+		if (j >= numB || (i < numA && a[2 * i] <= b[2 * j]))
+			run = a + 2 * i++;
+		else
+			run = b + 2 * j++;
+
+		if (count && run[0] <= dst[2 * count - 1]) {
+			if (run[1] > dst[2 * count - 1])
+				dst[2 * count - 1] = run[1];
+		}
+		else {
+			dst[2 * count] = run[0];
+			dst[2 * count + 1] = run[1];
+			count++;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,29 @@
+#ifndef UNCROSS_RUNS_H
+#define UNCROSS_RUNS_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "simd.h"
+
+// Finds the runs of flagged pixels of a mask row, writing the start and end (exclusive) of each one
+// to runs in ascending order, and returns the number of runs. runs must hold width + 1 ints.
+// The mask is scanned a word at a time, so clean stretches cost one test per 8 bytes or less.
+// Packed rows are passed with the width of the mask in pixels and their padding bits are ignored.
+typedef int (*MaskRunsFunc)(const uint8_t *srcp, int width, int *runs);
+
+int maskRuns_c(const uint8_t *srcp, int width, int *runs);
+int maskRuns16_c(const uint8_t *srcp, int width, int *runs);
+int packedMaskRuns_c(const uint8_t *srcp, int width, int *runs);
+#ifdef UNCROSS_X86
+int maskRuns_sse2(const uint8_t *srcp, int width, int *runs);
+int maskRuns_avx2(const uint8_t *srcp, int width, int *runs);
+#endif
+
+// Select the fastest run kernel for 1 or 2 bytes per sample or packed rows available at the instruction set level cpu.
+MaskRunsFunc selectMaskRuns(int bytesPerSample, int packed, CpuLevel cpu);
+
+// Write the union of two lists of runs to dst, merging runs that overlap or touch, and return the
+// number of runs. dst must hold numA + numB runs and be neither a nor b.
+int mergeRuns(const int *a, int numA, const int *b, int numB, int *dst);
+
+#endif
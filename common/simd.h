@@ -0,0 +1,33 @@
+#ifndef UNCROSS_SIMD_H
+#define UNCROSS_SIMD_H
+
+// x86 kernels are compiled with per-function target attributes, so the plugins build
+// without any -m flags and pick the best kernel for the running CPU at filter creation.
+// MSVC compiles any intrinsic without flags, so UNCROSS_TARGET expands to nothing there,
+// and only has AVX-512 intrinsics from Visual Studio 2017 15.3 (_MSC_VER 1911) on.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UNCROSS_X86
+#define UNCROSS_AVX512
+#define UNCROSS_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define UNCROSS_X86
+#if _MSC_VER >= 1911
+#define UNCROSS_AVX512
+#endif
+#define UNCROSS_TARGET(isa)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// Kernels for 10, 12 and 16-bit samples are written once in the *_template.h files and
+// included once per bit depth with BITS defined. KERNEL(name, isa) expands to name<BITS>_isa.
+#define KERNEL_NAME_(name, bits, isa) name##bits##_##isa
+#define KERNEL_NAME(name, bits, isa) KERNEL_NAME_(name, bits, isa)
+
+// Integer bit depths with kernels. 8-bit samples are bytes, the others uint16_t.
+static inline int isSupportedBitDepth(int bits) {
+	return bits == 8 || bits == 10 || bits == 12 || bits == 16;
+}
+
+#endif
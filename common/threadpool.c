@@ -0,0 +1,207 @@
+#include <stdlib.h>
+#include "threadpool.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE Cond;
+
+#define mutexInit(m) InitializeCriticalSection(m)
+#define mutexDestroy(m) DeleteCriticalSection(m)
+#define mutexLock(m) EnterCriticalSection(m)
+#define mutexUnlock(m) LeaveCriticalSection(m)
+#define condInit(c) InitializeConditionVariable(c)
+#define condDestroy(c) ((void)(c))
+#define condWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define condBroadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Cond;
+
+#define mutexInit(m) pthread_mutex_init(m, NULL)
+#define mutexDestroy(m) pthread_mutex_destroy(m)
+#define mutexLock(m) pthread_mutex_lock(m)
+#define mutexUnlock(m) pthread_mutex_unlock(m)
+#define condInit(c) pthread_cond_init(c, NULL)
+#define condDestroy(c) pthread_cond_destroy(c)
+#define condWait(c, m) pthread_cond_wait(c, m)
+#define condBroadcast(c) pthread_cond_broadcast(c)
+#endif
+
+// The stripes of one runStripes call. Batches live on the stack of the calling thread
+// and stay queued until every stripe has been claimed.
+typedef struct Batch {
+	StripeFunc func;
+	void *userData;
+	int rows;
+	int stripeRows;
+	int numStripes;
+	int next; // first stripe not claimed yet
+	int finished; // stripes done
+	struct Batch *queueNext;
+} Batch;
+
+struct ThreadPool {
+	int threads; // including the calling thread
+	Thread *workers;
+
+	Mutex mutex;
+	Cond wake; // a batch was queued, or the pool is shutting down
+	Cond done; // a batch was finished
+	Batch *queue;
+	int quit;
+};
+
+// Claim the next stripe of a batch, dequeuing the batch when it was the last one. Called with the mutex held.
+static int claimStripe(ThreadPool *pool, Batch *batch) {
+	int stripe = batch->next++;
+
+	if (batch->next == batch->numStripes) {
+		Batch **link = &pool->queue;
+
+		while (*link != batch) {
+			link = &(*link)->queueNext;
+		}
+
+		*link = batch->queueNext;
+	}
+
+	return stripe;
+}
+
+// Run a claimed stripe without the mutex held, then count it as finished.
+static void runStripe(ThreadPool *pool, Batch *batch, int stripe) {
+	int start = stripe * batch->stripeRows;
+	int end = start + batch->stripeRows < batch->rows ? start + batch->stripeRows : batch->rows;
+
+	mutexUnlock(&pool->mutex);
+	batch->func(batch->userData, start, end);
+	mutexLock(&pool->mutex);
+
+	// the batch may be gone as soon as the caller sees it finished
+	if (++batch->finished == batch->numStripes) {
+		condBroadcast(&pool->done);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker(LPVOID data) {
+#else
+static void *worker(void *data) {
+#endif
+	ThreadPool *pool = (ThreadPool *)data;
+
+	mutexLock(&pool->mutex);
+
+	while (!pool->quit) {
+		if (!pool->queue) {
+			condWait(&pool->wake, &pool->mutex);
+			continue;
+		}
+
+		Batch *batch = pool->queue;
+		runStripe(pool, batch, claimStripe(pool, batch));
+	}
+
+	mutexUnlock(&pool->mutex);
+	return 0;
+}
+
+ThreadPool *createThreadPool(int threads) {
+	if (threads <= 1) {
+		return NULL;
+	}
+
+	ThreadPool *pool = malloc(sizeof *pool);
+	pool->threads = threads;
+	pool->workers = malloc((threads - 1) * sizeof *pool->workers);
+	pool->queue = NULL;
+	pool->quit = 0;
+
+	mutexInit(&pool->mutex);
+	condInit(&pool->wake);
+	condInit(&pool->done);
+
+	for (int i = 0; i < threads - 1; i++) {
+#ifdef _WIN32
+		pool->workers[i] = CreateThread(NULL, 0, worker, pool, 0, NULL);
+#else
+		pthread_create(&pool->workers[i], NULL, worker, pool);
+#endif
+	}
+
+	return pool;
+}
+
+void freeThreadPool(ThreadPool *pool) {
+	if (!pool) {
+		return;
+	}
+
+	mutexLock(&pool->mutex);
+	pool->quit = 1;
+	condBroadcast(&pool->wake);
+	mutexUnlock(&pool->mutex);
+
+	for (int i = 0; i < pool->threads - 1; i++) {
+#ifdef _WIN32
+		WaitForSingleObject(pool->workers[i], INFINITE);
+		CloseHandle(pool->workers[i]);
+#else
+		pthread_join(pool->workers[i], NULL);
+#endif
+	}
+
+	condDestroy(&pool->done);
+	condDestroy(&pool->wake);
+	mutexDestroy(&pool->mutex);
+	free(pool->workers);
+	free(pool);
+}
+
+// The calling thread claims stripes of its own batch alongside the workers, so a frame never
+// waits idle for workers busy with other frames while some of its stripes are still queued.
+void runStripes(ThreadPool *pool, int rows, int granularity, StripeFunc func, void *userData) {
+	int stripeRows = pool ? (rows + pool->threads - 1) / pool->threads : rows;
+	stripeRows = (stripeRows + granularity - 1) / granularity * granularity;
+
+	if (!pool || stripeRows >= rows) {
+		func(userData, 0, rows);
+		return;
+	}
+
+	Batch batch;
+	batch.func = func;
+	batch.userData = userData;
+	batch.rows = rows;
+	batch.stripeRows = stripeRows;
+	batch.numStripes = (rows + stripeRows - 1) / stripeRows;
+	batch.next = 0;
+	batch.finished = 0;
+	batch.queueNext = NULL;
+
+	mutexLock(&pool->mutex);
+
+	Batch **link = &pool->queue;
+	while (*link) {
+		link = &(*link)->queueNext;
+	}
+	*link = &batch;
+	condBroadcast(&pool->wake);
+
+	while (batch.next < batch.numStripes) {
+		runStripe(pool, &batch, claimStripe(pool, &batch));
+	}
+
+	while (batch.finished < batch.numStripes) {
+		condWait(&pool->done, &pool->mutex);
+	}
+
+	mutexUnlock(&pool->mutex);
+}
@@ -0,0 +1,21 @@
+#ifndef UNCROSS_THREADPOOL_H
+#define UNCROSS_THREADPOOL_H
+
+// Processes rows [start, end) of a frame. Stripes of the same frame run concurrently, so a stripe
+// may read rows outside its range (halo rows of the source) but must only write its own rows.
+typedef void (*StripeFunc)(void *userData, int start, int end);
+
+// Worker threads that split frames into horizontal stripes. One pool is shared by all the frames
+// of a filter instance: stripes of concurrent frames are queued and run in order.
+typedef struct ThreadPool ThreadPool;
+
+// Create a pool that runs up to threads stripes at once, the calling thread included.
+// Returns NULL when threads is 1 or less, which runStripes treats as running the whole frame inline.
+ThreadPool *createThreadPool(int threads);
+void freeThreadPool(ThreadPool *pool);
+
+// Split rows into stripes whose height is a multiple of granularity (except the last one), run them
+// on the pool and on the calling thread, and return once they are all done.
+void runStripes(ThreadPool *pool, int rows, int granularity, StripeFunc func, void *userData);
+
+#endif
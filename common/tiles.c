@@ -0,0 +1,170 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tiles.h"
+
+// The scalar kernels double as the tail of the SIMD ones, starting at x.
+static void countMaskRange(const uint8_t *srcp, int x, int width, int *tileCounts) {
+	for (; x < width; x++) {
+		tileCounts[x / MASK_TILE_SIZE] += srcp[x] != 0;
+	}
+}
+
+void countMaskRow_c(const uint8_t *srcp, int width, int *tileCounts) {
+	countMaskRange(srcp, 0, width, tileCounts);
+}
+
+void countMaskRow16_c(const uint8_t *srcp, int width, int *tileCounts) {
+	const uint16_t *srcp16 = (const uint16_t *)srcp;
+
+	for (int x = 0; x < width; x++) {
+		tileCounts[x / MASK_TILE_SIZE] += srcp16[x] != 0;
+	}
+}
+
+// A tile of a packed row is one 64-bit word, counted with the usual bit tricks.
+void countPackedMaskRow_c(const uint8_t *srcp, int width, int *tileCounts) {
+	int bytes = (width + 7) / 8;
+
+	for (int i = 0; i < bytes; i += 8) {
+		uint64_t v = 0;
+		int n = bytes - i < 8 ? bytes - i : 8;
+
+		for (int j = 0; j < n; j++) {
+			v |= (uint64_t)srcp[i + j] << (8 * j);
+		}
+
+		// clear the padding bits of the last byte
+		if (i + n == bytes && (width & 7)) {
+			v &= ((uint64_t)1 << (8 * (n - 1) + (width & 7))) - 1;
+		}
+
+		v = v - ((v >> 1) & 0x5555555555555555ULL);
+		v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+		v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+		tileCounts[i / 8] += (int)((v * 0x0101010101010101ULL) >> 56);
+	}
+}
+
+#ifdef UNCROSS_X86
+// Each comparison subtracts 1 from the lanes of zero samples, and the sum of the lanes is the
+// number of clean pixels of the tile.
+UNCROSS_TARGET("sse2")
+void countMaskRow_sse2(const uint8_t *srcp, int width, int *tileCounts) {
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+
+	for (; x + MASK_TILE_SIZE <= width; x += MASK_TILE_SIZE) {
+		__m128i clean = zero;
+
+		for (int i = 0; i < MASK_TILE_SIZE; i += 16) {
+			clean = _mm_sub_epi8(clean, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(srcp + x + i)), zero));
+		}
+
+		clean = _mm_sad_epu8(clean, zero);
+		tileCounts[x / MASK_TILE_SIZE] += MASK_TILE_SIZE - _mm_cvtsi128_si32(clean) - _mm_cvtsi128_si32(_mm_srli_si128(clean, 8));
+	}
+
+	countMaskRange(srcp, x, width, tileCounts);
+}
+
+UNCROSS_TARGET("avx2")
+void countMaskRow_avx2(const uint8_t *srcp, int width, int *tileCounts) {
+	const __m256i zero = _mm256_setzero_si256();
+	int x = 0;
+
+	for (; x + MASK_TILE_SIZE <= width; x += MASK_TILE_SIZE) {
+		__m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(srcp + x)), zero);
+		__m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(srcp + x + 32)), zero);
+		__m256i clean = _mm256_sad_epu8(_mm256_sub_epi8(_mm256_sub_epi8(zero, a), b), zero);
+		__m128i sum = _mm_add_epi64(_mm256_castsi256_si128(clean), _mm256_extracti128_si256(clean, 1));
+
+		tileCounts[x / MASK_TILE_SIZE] += MASK_TILE_SIZE - _mm_cvtsi128_si32(sum) - _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+	}
+
+	countMaskRange(srcp, x, width, tileCounts);
+}
+#endif
+
+// Select the fastest counting kernel for 1 or 2 bytes per sample or packed rows available at the instruction set level cpu.
+CountMaskRowFunc selectCountMaskRow(int bytesPerSample, int packed, CpuLevel cpu) {
+	if (packed) {
+		return countPackedMaskRow_c;
+	}
+	if (bytesPerSample == 2) {
+		return countMaskRow16_c;
+	}
+#ifdef UNCROSS_X86
+	if (cpu >= cpuAVX2) {
+		return countMaskRow_avx2;
+	}
+	if (cpu >= cpuSSE2) {
+		return countMaskRow_sse2;
+	}
+#endif
+	return countMaskRow_c;
+}
+
+// Set the summary of a mask of width x height pixels from the counts of its tiles in raster order.
+void setMaskTileProps(VSMap *props, const int *tileCounts, int width, int height, const VSAPI *vsapi) {
+	int tilesX = maskTileCount(width);
+	int tilesY = maskTileCount(height);
+	int64_t pixels = 0;
+	int64_t *boxes = malloc((size_t)tilesX * tilesY * 4 * sizeof *boxes);
+	int numBoxes = 0;
+
+	for (int ty = 0; ty < tilesY; ty++) {
+		for (int tx = 0; tx < tilesX; tx++) {
+			int count = tileCounts[ty * tilesX + tx];
+
+			if (!count)
+				continue;
+
+			int x = tx * MASK_TILE_SIZE;
+			int y = ty * MASK_TILE_SIZE;
+
+			pixels += count;
+			boxes[numBoxes++] = x;
+			boxes[numBoxes++] = y;
+			boxes[numBoxes++] = width - x < MASK_TILE_SIZE ? width - x : MASK_TILE_SIZE;
+			boxes[numBoxes++] = height - y < MASK_TILE_SIZE ? height - y : MASK_TILE_SIZE;
+		}
+	}
+
+	vsapi->propSetInt(props, FLAGGED_PIXELS_PROP, pixels, paReplace);
+
+	if (numBoxes)
+		vsapi->propSetIntArray(props, FLAGGED_TILES_PROP, boxes, numBoxes);
+	else
+		vsapi->propDeleteKey(props, FLAGGED_TILES_PROP);
+
+	free(boxes);
+}
+
+// Read the summary of a mask of width x height pixels. When flags is not NULL it gets one byte per tile
+// in raster order, 1 for the listed tiles. Returns the number of flagged pixels, or -1 without a summary.
+int64_t getMaskTileFlags(const VSMap *props, uint8_t *flags, int width, int height, const VSAPI *vsapi) {
+	int err;
+	int64_t pixels = vsapi->propGetInt(props, FLAGGED_PIXELS_PROP, 0, &err);
+
+	if (err)
+		return -1;
+
+	if (flags) {
+		int tilesX = maskTileCount(width);
+		int tilesY = maskTileCount(height);
+		int numBoxes = vsapi->propNumElements(props, FLAGGED_TILES_PROP);
+		const int64_t *boxes = numBoxes > 0 ? vsapi->propGetIntArray(props, FLAGGED_TILES_PROP, &err) : NULL;
+
+		memset(flags, 0, (size_t)tilesX * tilesY);
+
+		for (int i = 0; boxes && i + 4 <= numBoxes; i += 4) {
+			int64_t tx = boxes[i] / MASK_TILE_SIZE;
+			int64_t ty = boxes[i + 1] / MASK_TILE_SIZE;
+
+			if (tx >= 0 && tx < tilesX && ty >= 0 && ty < tilesY)
+				flags[ty * tilesX + tx] = 1;
+		}
+	}
+
+	return pixels;
+}
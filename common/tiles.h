@@ -0,0 +1,45 @@
+#ifndef UNCROSS_TILES_H
+#define UNCROSS_TILES_H
+
+#include <stdint.h>
+#include <VapourSynth.h>
+#include "cpu.h"
+#include "simd.h"
+
+// Masks are summarized per tile of 64x64 mask pixels, so filters further down the chain can pass
+// clean frames through and skip the clean tiles of the others.
+#define MASK_TILE_SIZE 64
+
+// Properties of a summarized mask: the number of flagged pixels of its luma plane, and the x, y,
+// width and height of every tile holding any, in mask pixels and raster order, with tiles cut at the
+// frame edges. The tile list is absent when no pixel is flagged.
+#define FLAGGED_PIXELS_PROP "_UncrossFlaggedPixels"
+#define FLAGGED_TILES_PROP "_UncrossFlaggedTiles"
+
+static inline int maskTileCount(int size) {
+	return (size + MASK_TILE_SIZE - 1) / MASK_TILE_SIZE;
+}
+
+// Adds the flagged pixels of a mask row to the counts of the tiles it crosses, tileCounts[x / 64].
+// Packed rows are passed with the width of the mask in pixels and their padding bits are ignored.
+typedef void (*CountMaskRowFunc)(const uint8_t *srcp, int width, int *tileCounts);
+
+void countMaskRow_c(const uint8_t *srcp, int width, int *tileCounts);
+void countMaskRow16_c(const uint8_t *srcp, int width, int *tileCounts);
+void countPackedMaskRow_c(const uint8_t *srcp, int width, int *tileCounts);
+#ifdef UNCROSS_X86
+void countMaskRow_sse2(const uint8_t *srcp, int width, int *tileCounts);
+void countMaskRow_avx2(const uint8_t *srcp, int width, int *tileCounts);
+#endif
+
+// Select the fastest counting kernel for 1 or 2 bytes per sample or packed rows available at the instruction set level cpu.
+CountMaskRowFunc selectCountMaskRow(int bytesPerSample, int packed, CpuLevel cpu);
+
+// Set the summary of a mask of width x height pixels from the counts of its tiles in raster order.
+void setMaskTileProps(VSMap *props, const int *tileCounts, int width, int height, const VSAPI *vsapi);
+
+// Read the summary of a mask of width x height pixels. When flags is not NULL it gets one byte per tile
+// in raster order, 1 for the listed tiles. Returns the number of flagged pixels, or -1 without a summary.
+int64_t getMaskTileFlags(const VSMap *props, uint8_t *flags, int width, int height, const VSAPI *vsapi);
+
+#endif
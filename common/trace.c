@@ -0,0 +1,152 @@
+// syscall(SYS_gettid) and getpid are not part of C99
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+#include "trace.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#define THREAD_LOCAL __declspec(thread)
+#define currentThreadId() ((int64_t)GetCurrentThreadId())
+#define currentProcessId() ((int64_t)GetCurrentProcessId())
+#define compareAndSwap(p, expected, desired) (InterlockedCompareExchangePointer((void *volatile *)(p), desired, expected) == (expected))
+#define storeRelease(p, value) (*(p) = (value))
+#define loadAcquire(p) (*(p))
+#else
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#define currentThreadId() ((int64_t)syscall(SYS_gettid))
+#else
+#define currentThreadId() ((int64_t)(uintptr_t)pthread_self())
+#endif
+
+#define THREAD_LOCAL __thread
+#define currentProcessId() ((int64_t)getpid())
+#define compareAndSwap(p, expected, desired) __sync_bool_compare_and_swap(p, expected, desired)
+#define storeRelease(p, value) __atomic_store_n(p, value, __ATOMIC_RELEASE)
+#define loadAcquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#endif
+
+// Events kept per thread. Older events are overwritten once a thread has recorded more.
+#define TRACE_CAPACITY 65536
+
+typedef struct {
+	const char *category;
+	const char *name;
+	const char *argName;
+	int arg;
+	int64_t begin;
+	int64_t end;
+} TraceEvent;
+
+// The ring of one thread. Only its thread writes events; head is published after each event so the
+// buffers can be read from another thread once the writers are done.
+typedef struct TraceBuffer {
+	struct TraceBuffer *next;
+	int64_t threadId;
+	uint64_t head; // number of events recorded
+	TraceEvent events[TRACE_CAPACITY];
+} TraceBuffer;
+
+static char *tracePath = NULL;
+static TraceBuffer *volatile buffers = NULL;
+static THREAD_LOCAL TraceBuffer *localBuffer = NULL;
+
+static void writeTrace(void);
+
+void initTrace(void) {
+	const char *path = getenv("UNCROSS_TRACE");
+
+	if (tracePath || !path || !*path) {
+		return;
+	}
+
+	tracePath = malloc(strlen(path) + 1);
+	strcpy(tracePath, path);
+	atexit(writeTrace);
+}
+
+int64_t traceClock(void) {
+	return tracePath ? profileClock() : 0;
+}
+
+// Allocate the buffer of the calling thread and push it onto the list of all buffers.
+static TraceBuffer *createBuffer(void) {
+	TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+
+	if (!buffer) {
+		return NULL;
+	}
+
+	buffer->threadId = currentThreadId();
+
+	do {
+		buffer->next = buffers;
+	} while (!compareAndSwap(&buffers, buffer->next, buffer));
+
+	return buffer;
+}
+
+void traceEvent(const char *category, const char *name, const char *argName, int arg, int64_t begin) {
+	if (!begin) {
+		return;
+	}
+
+	if (!localBuffer && !(localBuffer = createBuffer())) {
+		return;
+	}
+
+	uint64_t head = localBuffer->head;
+	TraceEvent *event = &localBuffer->events[head % TRACE_CAPACITY];
+
+	event->category = category;
+	event->name = name;
+	event->argName = argName;
+	event->arg = arg;
+	event->begin = begin;
+	event->end = profileClock();
+
+	storeRelease(&localBuffer->head, head + 1);
+}
+
+// Append the events of every thread to the trace file, in the JSON array format whose closing
+// bracket is optional, so that plugins and runs can share a file.
+static void writeTrace(void) {
+	FILE *file = fopen(tracePath, "a");
+
+	if (!file) {
+		fprintf(stderr, "uncross: cannot write the trace to %s\n", tracePath);
+		return;
+	}
+
+	fseek(file, 0, SEEK_END);
+
+	if (ftell(file) == 0) {
+		fputs("[\n", file);
+	}
+
+	int64_t pid = currentProcessId();
+
+	for (TraceBuffer *buffer = buffers; buffer; buffer = buffer->next) {
+		uint64_t head = loadAcquire(&buffer->head);
+		uint64_t first = head > TRACE_CAPACITY ? head - TRACE_CAPACITY : 0;
+
+		for (uint64_t i = first; i < head; i++) {
+			const TraceEvent *event = &buffer->events[i % TRACE_CAPACITY];
+
+			// timestamps are in microseconds
+			fprintf(file, "{\"cat\":\"%s\",\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lld,\"tid\":%lld,\"args\":{\"%s\":%d}},\n",
+				event->category, event->name, event->begin * 1e-3, (event->end - event->begin) * 1e-3,
+				(long long)pid, (long long)buffer->threadId, event->argName, event->arg);
+		}
+	}
+
+	fclose(file);
+}
@@ -0,0 +1,23 @@
+#ifndef UNCROSS_TRACE_H
+#define UNCROSS_TRACE_H
+
+#include <stdint.h>
+
+// Timeline of filter execution in the Chrome trace event format, enabled by setting UNCROSS_TRACE
+// to the path of a JSON file. Each thread records complete events into a ring buffer of its own
+// without locking, and the buffers of every thread are appended to the file when the plugin is
+// unloaded. Timestamps come from profileClock, so one file can hold the events of several plugins
+// and several runs, told apart by their process ids.
+
+// Read UNCROSS_TRACE. Called once from VapourSynthPluginInit.
+void initTrace(void);
+
+// Start of an event: the current time, or 0 when tracing is disabled.
+int64_t traceClock(void);
+
+// Record an event from begin to now on the calling thread, with one integer argument. category,
+// name and argName must be string literals, as they are only written out when the plugin is
+// unloaded. Does nothing when begin is 0.
+void traceEvent(const char *category, const char *name, const char *argName, int arg, int64_t begin);
+
+#endif
@@ -1,10 +1,30 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <VapourSynth.h>
 #include <VSHelper.h>
+#include "blur.h"
+#include "cpu.h"
+#include "packed.h"
+#include "profile.h"
+#include "runs.h"
+#include "threadpool.h"
+#include "tiles.h"
+#include "trace.h"
 
 typedef struct {
 	VSNodeRef *node;
+	VSNodeRef *mask; // NULL unless a mask is given
 	const VSVideoInfo *vi;
+	const char *name; // DotBlur, or MaskedBlur to blur only the pixels the mask flags
+	int skip; // trust the summary of the mask frames, skip=1
+
+	BlurRowFunc blurRow;
+	BlurRowFunc blurRowChroma; // 2 taps instead of 4 when chroma is horizontally subsampled
+	MaskRunsFunc maskRuns; // for masks of one sample per pixel, NULL unless MaskedBlur
+	MaskRunsFunc packedMaskRuns;
+	ThreadPool *pool; // NULL when frames are processed on a single thread
+	Profile *profile; // NULL unless profile=1
 } VideoData;
 
 // This function is called immediately after vsapi->createFilter(). This is the only place where the video
@@ -15,34 +35,233 @@ static void VS_CC init(VSMap *in, VSMap *out, void **instanceData, VSNode *node,
 	vsapi->setVideoInfo(d->vi, 1, node);
 }
 
-static void blurDots(const VSFrameRef *src, VSFrameRef *dst, const VSAPI *vsapi) {
-	int height = vsapi->getFrameHeight(src, 0); // same for all planes with YUV444P8
-	int width = vsapi->getFrameWidth(src, 0); // same for all planes with YUV444P8
+// The plane pointers shared by the stripes of one frame.
+typedef struct {
+	const uint8_t *srcp[3];
+	uint8_t *dstp[3];
+	int stride;
+	int dstStride;
+	int chromaStride;
+	int dstChromaStride;
+	int width;
+	int chromaWidth;
+	int ssW;
+	int ssH;
+	int bytesPerSample;
+	const uint8_t *tileFlags; // one byte per mask tile, NULL to blur the whole frame
+	int tilesX;
+	const uint8_t *maskp; // MaskedBlur: the luma plane of the mask, NULL for the other modes
+	int maskStride;
+	MaskRunsFunc maskRuns;
+	int height;
+	const VideoData *context;
+} BlurJob;
 
-	// Process the frame data.
-	const uint8_t *srcpy = vsapi->getReadPtr(src, 0);
-	const uint8_t *srcpu = vsapi->getReadPtr(src, 1);
-	const uint8_t *srcpv = vsapi->getReadPtr(src, 2);
-	uint8_t *dstpy = vsapi->getWritePtr(dst, 0);
-	uint8_t *dstpu = vsapi->getWritePtr(dst, 1);
-	uint8_t *dstpv = vsapi->getWritePtr(dst, 2);
-
-	int stride = vsapi->getStride(src, 0);
-
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; (x + 3) < width; x++) {
-			dstpy[x] = (int)round((double)(srcpy[x] + srcpy[x + 1] + srcpy[x + 2] + srcpy[x + 3]) / 4);
-			dstpu[x] = (int)round((double)(srcpu[x] + srcpu[x + 1] + srcpu[x + 2] + srcpu[x + 3]) / 4);
-			dstpv[x] = (int)round((double)(srcpv[x] + srcpv[x + 1] + srcpv[x + 2] + srcpv[x + 3]) / 4);
+// Blur the pixels [x0, x1) of a row of width pixels. Windows that run past x1 read the pixels after
+// it, and the pixels the kernel copies at the end of its range are those of the source.
+static void blurRun(BlurRowFunc blurRow, const uint8_t *srcp, uint8_t *dstp, int x0, int x1, int width, int taps, int bytesPerSample) {
+	int end = VSMIN(x1 + taps - 1, width);
+	blurRow(srcp + x0 * bytesPerSample, dstp + x0 * bytesPerSample, end - x0);
+}
+
+// Copy a row and blur the runs of flagged tiles in it. Tiles are in luma pixels, and ssW scales
+// them down to a chroma row.
+static void blurTileRow(BlurRowFunc blurRow, const uint8_t *srcp, uint8_t *dstp, int width, int taps, int ssW, const BlurJob *job, const uint8_t *flags) {
+	memcpy(dstp, srcp, (size_t)width * job->bytesPerSample);
+
+	for (int tx = 0; tx < job->tilesX; tx++) {
+		if (!flags[tx])
+			continue;
+
+		int run = tx;
+
+		while (tx + 1 < job->tilesX && flags[tx + 1])
+			tx++;
+
+		int x0 = (run * MASK_TILE_SIZE) >> ssW;
+		int x1 = VSMIN(((tx + 1) * MASK_TILE_SIZE) >> ssW, width);
+
+		blurRun(blurRow, srcp, dstp, x0, x1, width, taps, job->bytesPerSample);
+	}
+}
+
+// Copy a row and blur the runs of pixels in runs.
+static void blurRunsRow(BlurRowFunc blurRow, const uint8_t *srcp, uint8_t *dstp, int width, int taps, const int *runs, int numRuns, int bytesPerSample) {
+	memcpy(dstp, srcp, (size_t)width * bytesPerSample);
+
+	for (int i = 0; i < numRuns; i++) {
+		blurRun(blurRow, srcp, dstp, runs[2 * i], runs[2 * i + 1], width, taps, bytesPerSample);
+	}
+}
+
+// Scale runs of luma pixels down to the chroma pixels covering them, merging runs that come to overlap.
+static int scaleRuns(int *runs, int numRuns, int ssW) {
+	int count = 0;
+
+	if (!ssW)
+		return numRuns;
+
+	for (int i = 0; i < numRuns; i++) {
+		int x0 = runs[2 * i] >> ssW;
+		int x1 = ((runs[2 * i + 1] - 1) >> ssW) + 1;
+
+		if (count && x0 <= runs[2 * count - 1]) {
+			runs[2 * count - 1] = x1;
+		}
+		else {
+			runs[2 * count] = x0;
+			runs[2 * count + 1] = x1;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+// MaskedBlur: blur rows [start, end) of all three planes where the mask flags them and copy the
+// source elsewhere. A chroma pixel is blurred when any of the luma pixels it covers is flagged.
+static void maskedBlurStripe(void *userData, int start, int end) {
+	int64_t begin = traceClock();
+	const BlurJob *job = (const BlurJob *)userData;
+	int ssH = job->ssH;
+	int ssW = job->ssW;
+	int width = job->width;
+
+	const uint8_t *srcpy = job->srcp[0] + start * job->stride;
+	const uint8_t *srcpu = job->srcp[1] + (start >> ssH) * job->chromaStride;
+	const uint8_t *srcpv = job->srcp[2] + (start >> ssH) * job->chromaStride;
+	uint8_t *dstpy = job->dstp[0] + start * job->dstStride;
+	uint8_t *dstpu = job->dstp[1] + (start >> ssH) * job->dstChromaStride;
+	uint8_t *dstpv = job->dstp[2] + (start >> ssH) * job->dstChromaStride;
+
+	// the runs of the luma row, of the other rows under a chroma row, and their union
+	int *runs = malloc(3 * (size_t)(width + 1) * sizeof(int));
+	int *rowRuns = runs + width + 1;
+	int *merged = rowRuns + width + 1;
+
+	for (int y = start; y < end; y++) {
+		int numRuns = job->maskRuns(job->maskp + (size_t)y * job->maskStride, width, runs);
+
+		blurRunsRow(job->context->blurRow, srcpy, dstpy, width, 4, runs, numRuns, job->bytesPerSample);
+
+		srcpy += job->stride;
+		dstpy += job->dstStride;
+
+		if (y & ((1 << ssH) - 1)) {
+			continue;
+		}
+
+		int *chromaRuns = runs;
+		int *spare = merged;
+
+		for (int i = 1; i < (1 << ssH) && y + i < job->height; i++) {
+			int numRowRuns = job->maskRuns(job->maskp + (size_t)(y + i) * job->maskStride, width, rowRuns);
+			int *swap = chromaRuns;
+
+			numRuns = mergeRuns(chromaRuns, numRuns, rowRuns, numRowRuns, spare);
+			chromaRuns = spare;
+			spare = swap;
+		}
+
+		numRuns = scaleRuns(chromaRuns, numRuns, ssW);
+
+		blurRunsRow(job->context->blurRowChroma, srcpu, dstpu, job->chromaWidth, 4 >> ssW, chromaRuns, numRuns, job->bytesPerSample);
+		blurRunsRow(job->context->blurRowChroma, srcpv, dstpv, job->chromaWidth, 4 >> ssW, chromaRuns, numRuns, job->bytesPerSample);
+
+		srcpu += job->chromaStride;
+		srcpv += job->chromaStride;
+		dstpu += job->dstChromaStride;
+		dstpv += job->dstChromaStride;
+	}
+
+	free(runs);
+	traceEvent("kernel", "maskedBlurStripe", "row", start, begin);
+}
+
+// Blur rows [start, end) of all three planes row by row, so each source row is read once while it
+// is still in cache. Chroma rows are blurred along with the first luma row they cover; stripes start
+// on a multiple of the vertical subsampling, so each chroma row belongs to exactly one stripe.
+// With a mask only the flagged tiles are blurred and the rest of the rows is copied.
+static void blurStripe(void *userData, int start, int end) {
+	int64_t begin = traceClock();
+	const BlurJob *job = (const BlurJob *)userData;
+	int ssH = job->ssH;
+
+	const uint8_t *srcpy = job->srcp[0] + start * job->stride;
+	const uint8_t *srcpu = job->srcp[1] + (start >> ssH) * job->chromaStride;
+	const uint8_t *srcpv = job->srcp[2] + (start >> ssH) * job->chromaStride;
+	uint8_t *dstpy = job->dstp[0] + start * job->dstStride;
+	uint8_t *dstpu = job->dstp[1] + (start >> ssH) * job->dstChromaStride;
+	uint8_t *dstpv = job->dstp[2] + (start >> ssH) * job->dstChromaStride;
+
+	int ssW = job->ssW;
+
+	for (int y = start; y < end; y++) {
+		const uint8_t *flags = job->tileFlags ? job->tileFlags + (y / MASK_TILE_SIZE) * job->tilesX : NULL;
+
+		if (flags)
+			blurTileRow(job->context->blurRow, srcpy, dstpy, job->width, 4, 0, job, flags);
+		else
+			job->context->blurRow(srcpy, dstpy, job->width);
+
+		srcpy += job->stride;
+		dstpy += job->dstStride;
+
+		if (y & ((1 << ssH) - 1)) {
+			continue;
+		}
+
+		if (flags) {
+			blurTileRow(job->context->blurRowChroma, srcpu, dstpu, job->chromaWidth, 4 >> ssW, ssW, job, flags);
+			blurTileRow(job->context->blurRowChroma, srcpv, dstpv, job->chromaWidth, 4 >> ssW, ssW, job, flags);
+		}
+		else {
+			job->context->blurRowChroma(srcpu, dstpu, job->chromaWidth);
+			job->context->blurRowChroma(srcpv, dstpv, job->chromaWidth);
 		}
 
-		srcpy += stride;
-		srcpu += stride;
-		srcpv += stride;
-		dstpy += stride;
-		dstpu += stride;
-		dstpv += stride;
+		srcpu += job->chromaStride;
+		srcpv += job->chromaStride;
+		dstpu += job->dstChromaStride;
+		dstpv += job->dstChromaStride;
 	}
+
+	traceEvent("kernel", "blurStripe", "row", start, begin);
+}
+
+// Blur all three planes, in stripes when there is a thread pool. Stripes are whole rows of tiles
+// when only the tiles flagged in tileFlags are blurred. With a mask frame, only the pixels it flags
+// are blurred instead.
+static void blurDots(const VSFrameRef *src, VSFrameRef *dst, const uint8_t *tileFlags, const VSFrameRef *mask, MaskRunsFunc maskRuns, VideoData *context, const VSAPI *vsapi) {
+	BlurJob job;
+
+	// Process the frame data.
+	for (int plane = 0; plane < 3; plane++) {
+		job.srcp[plane] = vsapi->getReadPtr(src, plane);
+		job.dstp[plane] = vsapi->getWritePtr(dst, plane);
+	}
+
+	job.stride = vsapi->getStride(src, 0);
+	job.dstStride = vsapi->getStride(dst, 0);
+	job.chromaStride = vsapi->getStride(src, 1);
+	job.dstChromaStride = vsapi->getStride(dst, 1);
+	job.width = vsapi->getFrameWidth(src, 0);
+	job.chromaWidth = vsapi->getFrameWidth(src, 1);
+	job.ssW = vsapi->getFrameFormat(src)->subSamplingW;
+	job.ssH = vsapi->getFrameFormat(src)->subSamplingH;
+	job.bytesPerSample = vsapi->getFrameFormat(src)->bytesPerSample;
+	job.tileFlags = tileFlags;
+	job.tilesX = maskTileCount(job.width);
+	job.maskp = mask ? vsapi->getReadPtr(mask, 0) : NULL;
+	job.maskStride = mask ? vsapi->getStride(mask, 0) : 0;
+	job.maskRuns = maskRuns;
+	job.height = vsapi->getFrameHeight(src, 0);
+	job.context = context;
+
+	if (mask)
+		runStripes(context->pool, job.height, 1 << job.ssH, maskedBlurStripe, &job);
+	else
+		runStripes(context->pool, job.height, tileFlags ? MASK_TILE_SIZE : 1 << job.ssH, blurStripe, &job);
 }
 
 // This is the main function that gets called when a frame should be produced. It will, in most cases, get
@@ -56,15 +275,21 @@ static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **inst
 	VideoData *d = (VideoData *)* instanceData;
 
 	if (activationReason == arInitial) {
+		int64_t begin = traceClock();
+
 		// Request the source frame on the first call
 
 		vsapi->requestFrameFilter(n, d->node, frameCtx);
-	}
-	else if (activationReason == arAllFramesReady) {
 
-		const VSFrameRef *src = malloc(sizeof(src));
+		if (d->mask)
+			vsapi->requestFrameFilter(n, d->mask, frameCtx);
 
-		src = vsapi->getFrameFilter(n, d->node, frameCtx);
+		traceEvent("request", d->name, "n", n, begin);
+	}
+	else if (activationReason == arAllFramesReady) {
+		int64_t begin = traceClock();
+		int64_t start = d->profile ? profileClock() : 0;
+		const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
 
 		// The reason we query this on a per frame basis is because we want our filter
 		// to accept clips with varying dimensions. If we reject such content using d->vi
@@ -73,11 +298,68 @@ static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **inst
 		int height = vsapi->getFrameHeight(src, 0);
 		int width = vsapi->getFrameWidth(src, 0);
 
-		VSFrameRef *dst = vsapi->copyFrame(src, core);
+		// With skip=1 only the tiles the summary of the mask flags are blurred, and a clean frame is
+		// passed through as is. A mask without a summary blurs the whole frame. MaskedBlur goes down
+		// to the flagged pixels, and only reads the summary with skip=1.
+		uint8_t *tileFlags = NULL;
+		const VSFrameRef *mask = NULL;
+		MaskRunsFunc maskRuns = NULL;
+
+		if (d->mask) {
+			mask = vsapi->getFrameFilter(n, d->mask, frameCtx);
+			const VSMap *props = vsapi->getFramePropsRO(mask);
+			tileFlags = d->maskRuns ? NULL : malloc((size_t)maskTileCount(width) * maskTileCount(height));
+			int64_t flagged = d->skip ? getMaskTileFlags(props, tileFlags, width, height, vsapi) : -1;
+
+			if (flagged == 0) {
+				free(tileFlags);
+				vsapi->freeFrame(mask);
+				traceEvent("getFrame", d->name, "n", n, begin);
+				profileFrame(d->profile, NULL, start, 0, vsapi);
+				return src;
+			}
+
+			if (flagged < 0) {
+				free(tileFlags);
+				tileFlags = NULL;
+			}
+
+			if (d->maskRuns) {
+				int err;
+				int64_t packedWidth = vsapi->propGetInt(props, PACKED_WIDTH_PROP, 0, &err);
+
+				if (err)
+					packedWidth = 0;
+
+				if ((packedWidth ? packedWidth : vsapi->getFrameWidth(mask, 0)) != width || vsapi->getFrameHeight(mask, 0) != height) {
+					char msg[128];
+					snprintf(msg, sizeof(msg), "MaskedBlur: frame %d of the mask does not have the dimensions of the clip", n);
+					vsapi->setFilterError(msg, frameCtx);
+					vsapi->freeFrame(mask);
+					vsapi->freeFrame(src);
+					return 0;
+				}
+
+				maskRuns = packedWidth ? d->packedMaskRuns : d->maskRuns;
+			}
+			else {
+				vsapi->freeFrame(mask);
+				mask = NULL;
+			}
+		}
 
-		blurDots(src, dst, vsapi);
+		// Every pixel is written by blurDots, so there is no need to copy the source first.
+		int64_t allocBegin = traceClock();
+		VSFrameRef *dst = vsapi->newVideoFrame(fi, width, height, src, core);
+		traceEvent("alloc", "newVideoFrame", "n", n, allocBegin);
 
+		blurDots(src, dst, tileFlags, mask, maskRuns, d, vsapi);
+
+		free(tileFlags);
+		vsapi->freeFrame(mask);
 		vsapi->freeFrame(src);
+		traceEvent("getFrame", d->name, "n", n, begin);
+		profileFrame(d->profile, dst, start, (int64_t)width * height, vsapi);
 		return dst;
 	}
 
@@ -88,32 +370,107 @@ static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **inst
 static void VS_CC freeResources(void *instanceData, VSCore *core, const VSAPI *vsapi) {
 	VideoData *d = (VideoData *)instanceData;
 	vsapi->freeNode(d->node);
+	vsapi->freeNode(d->mask);
+	freeThreadPool(d->pool);
+	freeProfile(d->profile, vsapi);
 	free(d);
 }
 
-// This function is responsible for validating arguments and creating a new filter
+// This function is responsible for validating arguments and creating a new filter. It creates Blur,
+// and MaskedBlur when userData is not 0.
 static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
 	VideoData d;
 	VideoData *data;
+	char msg[128];
+	int err;
 
 	// Get a clip reference from the input arguments. This must be freed later.
 	d.node = vsapi->propGetNode(in, "clip", 0, 0);
 	d.vi = vsapi->getVideoInfo(d.node);
+	d.name = userData ? "MaskedBlur" : "DotBlur";
 
-	// In this first version we only want to handle 8bit integer formats. Note that
+	// There are kernels for 8, 10, 12 and 16-bit integer formats. Note that
 	// vi->format can be 0 if the input clip can change format midstream.
-	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || d.vi->format->bitsPerSample != 8) {
-		vsapi->setError(out, "DotBlur: only constant format 8-bit integer input supported");
+	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || !isSupportedBitDepth(d.vi->format->bitsPerSample)) {
+		snprintf(msg, sizeof(msg), "%s: only constant format 8, 10, 12 or 16-bit integer input supported", d.name);
+		vsapi->setError(out, msg);
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	// Subsampled chroma is blurred over the same luma footprint, which needs at least 2 taps.
+	if (d.vi->format->colorFamily != cmYUV || d.vi->format->subSamplingW > 1) {
+		snprintf(msg, sizeof(msg), "%s: YUV input with at most 2x horizontal chroma subsampling is required", d.name);
+		vsapi->setError(out, msg);
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	int threads = int64ToIntS(vsapi->propGetInt(in, "threads", 0, &err));
+	if (err)
+		threads = 1;
+
+	if (threads < 0) {
+		snprintf(msg, sizeof(msg), "%s: threads must be a positive value", d.name);
+		vsapi->setError(out, msg);
 		vsapi->freeNode(d.node);
 		return;
 	}
 
-	if (d.vi->format->id != pfYUV444P8) {
-		vsapi->setError(out, "RainbowDetect: YUV444P8 input is required");
+	CpuLevel cpu;
+
+	if (!parseCpuLevel(vsapi->propGetData(in, "opt", 0, &err), &cpu)) {
+		snprintf(msg, sizeof(msg), "%s: opt must be auto, c, sse2, ssse3, avx2 or avx512bw, and supported by the CPU", d.name);
+		vsapi->setError(out, msg);
 		vsapi->freeNode(d.node);
 		return;
 	}
 
+	// The tiles of a mask summary are in mask pixels, so the mask must cover the luma plane pixel
+	// for pixel, as a mask of the same dimensions or a packed mask of the same width.
+	d.mask = vsapi->propGetNode(in, "mask", 0, &err);
+
+	if (d.mask) {
+		const VSVideoInfo *mvi = vsapi->getVideoInfo(d.mask);
+
+		if (mvi->height != d.vi->height || (mvi->width != d.vi->width && mvi->width != packedRowBytes(d.vi->width))) {
+			snprintf(msg, sizeof(msg), "%s: mask must have the dimensions of the clip, or be packed from a mask of its width", d.name);
+			vsapi->setError(out, msg);
+			vsapi->freeNode(d.mask);
+			vsapi->freeNode(d.node);
+			return;
+		}
+
+		// MaskedBlur reads the samples themselves, which any integer mask will do.
+		if (userData && (!isConstantFormat(mvi) || mvi->format->sampleType != stInteger)) {
+			vsapi->setError(out, "MaskedBlur: mask must be a constant format integer clip");
+			vsapi->freeNode(d.mask);
+			vsapi->freeNode(d.node);
+			return;
+		}
+	}
+
+	// Filters that copy properties while changing pixels leave a summary that no longer matches the
+	// mask, so it is only trusted with skip=1. Without it Blur blurs every frame and has no use for the mask.
+	d.skip = !!vsapi->propGetInt(in, "skip", 0, &err);
+
+	if (d.mask && !d.skip && !userData) {
+		vsapi->freeNode(d.mask);
+		d.mask = NULL;
+	}
+
+	// 0 uses as many threads as the core
+	if (threads == 0)
+		threads = vsapi->getCoreInfo(core)->numThreads;
+
+	d.blurRow = selectBlurRow(0, d.vi->format->bitsPerSample, cpu);
+	d.blurRowChroma = selectBlurRow(d.vi->format->subSamplingW, d.vi->format->bitsPerSample, cpu);
+	d.maskRuns = userData ? selectMaskRuns(vsapi->getVideoInfo(d.mask)->format->bytesPerSample, 0, cpu) : NULL;
+	d.packedMaskRuns = userData ? selectMaskRuns(1, 1, cpu) : NULL;
+	d.pool = createThreadPool(threads);
+
+	d.profile = vsapi->propGetInt(in, "profile", 0, &err) ? createProfile(d.name) : NULL;
+
 	// I usually keep the filter data struct on the stack and don't allocate it
 	// until all the input validation is done.
 	data = malloc(sizeof(d));
@@ -133,7 +490,7 @@ static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *co
 	// prefetch (such as a cache filter).
 	// If your filter is really fast (such as a filter that only resorts frames) you should set the
 	// nfNoCache flag to make the caching work smoother.
-	vsapi->createFilter(in, out, "DotBlur", init, getFrame, freeResources, fmParallel, 0, data, core);
+	vsapi->createFilter(in, out, d.name, init, getFrame, freeResources, fmParallel, 0, data, core);
 }
 
 //////////////////////////////////////////
@@ -163,6 +520,11 @@ static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *co
 // or not empty arrays are accepted
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin) {
+	// Kernels are selected per filter from the instruction set level of the CPU, detected once here,
+	// and UNCROSS_TRACE is read once per load.
+	initCpuLevel();
+	initTrace();
 	configFunc("github.com.rzumer.dotblue", "dotblur", "Dot Blur", VAPOURSYNTH_API_VERSION, 1, plugin);
-	registerFunc("Blur", "clip:clip;", create, 0, plugin);
+	registerFunc("Blur", "clip:clip;mask:clip:opt;skip:int:opt;threads:int:opt;opt:data:opt;profile:int:opt;", create, 0, plugin);
+	registerFunc("MaskedBlur", "clip:clip;mask:clip;skip:int:opt;threads:int:opt;opt:data:opt;profile:int:opt;", create, (void *)1, plugin);
 }
@@ -1,120 +1,138 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <VapourSynth.h>
 #include <VSHelper.h>
+#include "cpu.h"
+#include "dotcrawl.h"
+#include "packed.h"
+#include "profile.h"
+#include "threadpool.h"
+#include "tiles.h"
+#include "trace.h"
 
 typedef struct {
 	VSNodeRef *node;
 	const VSVideoInfo *vi;
+	VSVideoInfo outVi; // vi with the mask format
 
 	int threshold;
+	int lineDistance; // rows between the lines compared across, from the system
+	DotCrawlRowFunc dotCrawlRow;
+	PackMaskRowFunc packMaskRow; // NULL unless packed=1
+	CountMaskRowFunc countMaskRow; // counts the output rows for the tile summary of Detect
+	ThreadPool *pool; // NULL when frames are processed on a single thread
+	Profile *profile; // NULL unless profile=1
+
+	// TemporalDetect only: two map buffers, one of which holds the map of frame cachedN so it
+	// can be reused as the previous map when frame cachedN + 1 is produced next
+	uint8_t *maps[2];
+	int cached; // index of the cached map in maps
+	int cachedN; // -1 when nothing is cached
 } VideoData;
 
+// Packed TemporalDetect classification: detections in frame n add 128 and detections in frame n - 1
+// add 127, so 0 is neither, 127 and 128 are one, 255 is both and any non-zero value is either.
+#define TEMPORAL_CURRENT 128
+#define TEMPORAL_PREVIOUS 127
+
 // This function is called immediately after vsapi->createFilter(). This is the only place where the video
 // properties may be set. In this case we simply use the same as the input clip. You may pass an array
 // of VSVideoInfo if the filter has more than one output, like rgb+alpha as two separate clips.
 static void VS_CC init(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
 	VideoData *d = (VideoData *)* instanceData;
-	vsapi->setVideoInfo(d->vi, 1, node);
+	vsapi->setVideoInfo(&d->outVi, 1, node);
 }
 
-// Read plane data into a matrix.
-static int **readPlaneMatrix(const VSFrameRef *frame, int plane, const VSAPI *vsapi) {
-	int height = vsapi->getFrameHeight(frame, plane);
-	int width = vsapi->getFrameWidth(frame, plane);
-
-	// Allocate destination matrix.
-	int **planeData = malloc(height * sizeof *planeData);
-
-	for (int i = 0; i < height; i++) {
-		planeData[i] = malloc(width * sizeof *planeData[i]);
-	}
-
-	// Read the frame data into the matrix.
-	const uint8_t *srcp = vsapi->getReadPtr(frame, plane);
-	int stride = vsapi->getStride(frame, plane);
-
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			planeData[y][x] = srcp[x];
-		}
+// The plane pointers shared by the stripes of one dot crawl map.
+typedef struct {
+	const uint8_t *srcp;
+	int stride;
+	uint8_t *dstp;
+	int dstStride;
+	int width;
+	int height;
+	int *tileCounts; // NULL when the map is not summarized
+	const VideoData *context;
+} DotCrawlJob;
+
+// Map rows [start, end). The rows above and below a stripe are read straight from the source,
+// so only the frame edges lack a neighbour and stripes match a single pass over the frame.
+// Packed maps are written a row at a time into a buffer of the stripe and packed from there.
+// Stripes are whole rows of tiles, so each one only adds to the counts of its own tiles.
+static void dotCrawlStripe(void *userData, int start, int end) {
+	int64_t begin = traceClock();
+	const DotCrawlJob *job = (const DotCrawlJob *)userData;
+	const VideoData *context = job->context;
+	const uint8_t *srcp = job->srcp + start * job->stride;
+	uint8_t *dstp = job->dstp + start * job->dstStride;
+	int stride = job->stride;
+	int lines = context->lineDistance;
+	uint8_t *row = context->packMaskRow ? malloc(job->width * context->vi->format->bytesPerSample) : NULL;
+
+	for (int y = start; y < end; y++) {
+		const uint8_t *prevp = y >= lines ? srcp - lines * stride : NULL;
+		const uint8_t *nextp = y < job->height - lines ? srcp + lines * stride : NULL;
+
+		context->dotCrawlRow(srcp, prevp, nextp, row ? row : dstp, job->width, context->threshold);
+
+		if (row)
+			context->packMaskRow(row, dstp, job->width);
+
+		if (job->tileCounts)
+			context->countMaskRow(dstp, job->width, job->tileCounts + (y / MASK_TILE_SIZE) * maskTileCount(job->width));
 
 		srcp += stride;
+		dstp += job->dstStride;
 	}
 
-	return planeData;
+	free(row);
+	traceEvent("kernel", "dotCrawlStripe", "row", start, begin);
 }
 
-// Write plane data from a matrix to a frame.
-static void writePlaneMatrix(VSFrameRef *frame, int plane, int **planeData, const VSAPI *vsapi) {
-	int height = vsapi->getFrameHeight(frame, plane);
-	int width = vsapi->getFrameWidth(frame, plane);
-
-	uint8_t *dstp = vsapi->getWritePtr(frame, plane);
-	int stride = vsapi->getStride(frame, plane);
-
-	// Write frame data from the matrix.
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			dstp[x] = planeData[y][x];
-		}
-
-		dstp += stride;
-	}
+// Write the dot crawl map of the luma plane of a frame into a buffer of the same sample size,
+// adding the flagged pixels of each tile to tileCounts unless it is NULL.
+static void dotCrawlMap(const VSFrameRef *frame, uint8_t *dstp, int dstStride, int *tileCounts, VideoData *context, const VSAPI *vsapi) {
+	int plane = 0; // Y plane index assuming YUV or YIQ input
+	DotCrawlJob job;
+
+	job.srcp = vsapi->getReadPtr(frame, plane);
+	job.stride = vsapi->getStride(frame, plane);
+	job.dstp = dstp;
+	job.dstStride = dstStride;
+	job.width = vsapi->getFrameWidth(frame, plane);
+	job.height = vsapi->getFrameHeight(frame, plane);
+	job.tileCounts = tileCounts;
+	job.context = context;
+
+	runStripes(context->pool, job.height, MASK_TILE_SIZE, dotCrawlStripe, &job);
 }
 
-int **generateDotCrawlMap(const VSFrameRef *frame, int threshold, const VSAPI *vsapi) {
-	int plane = 0; // Y plane index assuming YUV or YIQ input
-	int height = vsapi->getFrameHeight(frame, plane);
-	int width = vsapi->getFrameWidth(frame, plane);
+// Write the dot crawl map of a frame directly into a destination plane and summarize it in the frame properties.
+void generateDotCrawlMap(const VSFrameRef *frame, VSFrameRef *dst, VideoData *context, const VSAPI *vsapi) {
+	int width = vsapi->getFrameWidth(frame, 0);
+	int height = vsapi->getFrameHeight(frame, 0);
+	int *tileCounts = calloc((size_t)maskTileCount(width) * maskTileCount(height), sizeof *tileCounts);
 
-	// Allocate destination matrix.
-	int **dcMap = malloc(height * sizeof *dcMap);
+	dotCrawlMap(frame, vsapi->getWritePtr(dst, 0), vsapi->getStride(dst, 0), tileCounts, context, vsapi);
+	setMaskTileProps(vsapi->getFramePropsRW(dst), tileCounts, width, height, vsapi);
+	free(tileCounts);
+}
 
-	for (int i = 0; i < height; i++) {
-		dcMap[i] = malloc(width * sizeof *dcMap[i]);
+// Pack the maps of frames n and n - 1 into one row of the classification.
+static void packTemporalRow(const uint8_t *curp, const uint8_t *prep, uint8_t *dstp, int width, int bytesPerSample) {
+	if (bytesPerSample == 1) {
+		// flagged pixels are 255, so the masks select the contribution of each map
+		for (int x = 0; x < width; x++) {
+			dstp[x] = (curp[x] & TEMPORAL_CURRENT) | (prep[x] & TEMPORAL_PREVIOUS);
+		}
 	}
+	else {
+		const uint16_t *cur16 = (const uint16_t *)curp, *pre16 = (const uint16_t *)prep;
 
-	// Read the frame data into the matrix.
-	const uint8_t *srcp = vsapi->getReadPtr(frame, plane);
-	int stride = vsapi->getStride(frame, plane);
-
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; (x + 5) < width; x++) {
-			dcMap[y][x] = 0;
-
-			if (y > 0) {
-				// compare values across rows
-				int curY = srcp[x];
-				srcp -= stride;
-				int prevY = srcp[x];
-				srcp += stride; // back to the current row
-
-				if (prevY == curY) {
-					continue;
-				}
-			}
-			if (y < height - 1) {
-				// compare values across rows
-				int curY = srcp[x];
-				srcp += stride;
-				int nextY = srcp[x];
-				srcp -= stride; // back to the current row
-
-				if (curY == nextY) {
-					continue;
-				}
-			}
-
-			if (abs(srcp[x] - srcp[x + 2]) - abs(-srcp[x + 2] + srcp[x + 4]) < threshold
-				&& abs(srcp[x + 1] - srcp[x + 3]) - abs(-srcp[x + 3] + srcp[x + 5]) < threshold) {
-				dcMap[y][x] = 255;
-			}
+		for (int x = 0; x < width; x++) {
+			dstp[x] = (cur16[x] ? TEMPORAL_CURRENT : 0) + (pre16[x] ? TEMPORAL_PREVIOUS : 0);
 		}
-
-		srcp += stride;
 	}
-
-	return dcMap;
 }
 
 // This is the main function that gets called when a frame should be produced. It will, in most cases, get
@@ -128,39 +146,114 @@ static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **inst
 	VideoData *d = (VideoData *)* instanceData;
 
 	if (activationReason == arInitial) {
+		int64_t begin = traceClock();
+
 		// Request the source frame on the first call
 
 		vsapi->requestFrameFilter(n, d->node, frameCtx);
+
+		traceEvent("request", "DotDetect", "n", n, begin);
 	}
 	else if (activationReason == arAllFramesReady) {
-
-		const VSFrameRef *src = malloc(sizeof(src));
-
-		src = vsapi->getFrameFilter(n, d->node, frameCtx);
+		int64_t begin = traceClock();
+		int64_t start = d->profile ? profileClock() : 0;
+		const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
 
 		// The reason we query this on a per frame basis is because we want our filter
 		// to accept clips with varying dimensions. If we reject such content using d->vi
 		// would be better.
-		const VSFormat *fi = d->vi->format;
+		const VSFormat *fi = d->outVi.format;
 		int height = vsapi->getFrameHeight(src, 0);
 		int width = vsapi->getFrameWidth(src, 0);
 
 		// When creating a new frame for output it is VERY EXTREMELY SUPER IMPORTANT to
 		// supply the "dominant" source frame to copy properties from. Frame props
 		// are an essential part of the filter chain and you should NEVER break it.
-		VSFrameRef *dst = vsapi->newVideoFrame(fi, width, height, src, core);
-
-		int **dcMap = generateDotCrawlMap(src, d->threshold, vsapi);
+		int64_t allocBegin = traceClock();
+		VSFrameRef *dst = vsapi->newVideoFrame(fi, d->packMaskRow ? packedRowBytes(width) : width, height, src, core);
+		traceEvent("alloc", "newVideoFrame", "n", n, allocBegin);
 
 		// write the DCMap in the Y plane
-		writePlaneMatrix(dst, 0, dcMap, vsapi);
+		generateDotCrawlMap(src, dst, d, vsapi);
+
+		if (d->packMaskRow)
+			vsapi->propSetInt(vsapi->getFramePropsRW(dst), PACKED_WIDTH_PROP, width, paReplace);
+
+		vsapi->freeFrame(src);
+		traceEvent("getFrame", "DotDetect", "n", n, begin);
+		profileFrame(d->profile, dst, start, (int64_t)width * height, vsapi);
+		return dst;
+	}
+
+	return 0;
+}
+
+// Produce the packed classification of frame n from the maps of frames n and n - 1. The filter runs
+// in fmParallelRequests mode, so frames are produced one at a time and the cache needs no locking.
+static const VSFrameRef *VS_CC temporalGetFrame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+	VideoData *d = (VideoData *)* instanceData;
+
+	if (activationReason == arInitial) {
+		int64_t begin = traceClock();
+
+		// Request the source frames on the first call. Frame n - 1 is needed
+		// whenever its map is not cached when frame n is produced.
+		if (n > 0) {
+			vsapi->requestFrameFilter(n - 1, d->node, frameCtx);
+		}
+
+		vsapi->requestFrameFilter(n, d->node, frameCtx);
+
+		traceEvent("request", "TemporalDetect", "n", n, begin);
+	}
+	else if (activationReason == arAllFramesReady) {
+		int64_t begin = traceClock();
+		int64_t start = d->profile ? profileClock() : 0;
+		const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+		int height = d->vi->height;
+		int64_t pixels = (int64_t)d->vi->width * height;
+		int width = d->vi->width;
+		int bytesPerSample = d->vi->format->bytesPerSample;
+		int mapStride = width * bytesPerSample;
+
+		// When creating a new frame for output it is VERY EXTREMELY SUPER IMPORTANT to
+		// supply the "dominant" source frame to copy properties from. Frame props
+		// are an essential part of the filter chain and you should NEVER break it.
+		int64_t allocBegin = traceClock();
+		VSFrameRef *dst = vsapi->newVideoFrame(d->outVi.format, width, height, src, core);
+		traceEvent("alloc", "newVideoFrame", "n", n, allocBegin);
+
+		uint8_t *curMap = d->maps[!d->cached];
+		uint8_t *preMap = d->maps[d->cached];
+
+		dotCrawlMap(src, curMap, mapStride, NULL, d, vsapi);
+
+		// frame 0 is its own previous frame, like dcmap[0] + dcmap in the script
+		if (n == 0) {
+			preMap = curMap;
+		}
+		else if (d->cachedN != n - 1) {
+			const VSFrameRef *pre = vsapi->getFrameFilter(n - 1, d->node, frameCtx);
+			dotCrawlMap(pre, preMap, mapStride, NULL, d, vsapi);
+			vsapi->freeFrame(pre);
+			pixels *= 2;
+		}
+
+		uint8_t *dstp = vsapi->getWritePtr(dst, 0);
+		int dstStride = vsapi->getStride(dst, 0);
 
-		// deallocate the dot crawl map
-		for (int i = 0; i < height; i++) {
-			free(dcMap[i]);
+		for (int y = 0; y < height; y++) {
+			packTemporalRow(curMap + y * mapStride, preMap + y * mapStride, dstp, width, bytesPerSample);
+			dstp += dstStride;
 		}
-		free(dcMap);
+
+		// the current map becomes the previous map of frame n + 1
+		d->cached = !d->cached;
+		d->cachedN = n;
+
 		vsapi->freeFrame(src);
+		traceEvent("getFrame", "TemporalDetect", "n", n, begin);
+		profileFrame(d->profile, dst, start, pixels, vsapi);
 		return dst;
 	}
 
@@ -171,9 +264,38 @@ static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **inst
 static void VS_CC freeResources(void *instanceData, VSCore *core, const VSAPI *vsapi) {
 	VideoData *d = (VideoData *)instanceData;
 	vsapi->freeNode(d->node);
+	freeThreadPool(d->pool);
+	freeProfile(d->profile, vsapi);
+	free(d->maps[0]);
+	free(d->maps[1]);
 	free(d);
 }
 
+// Read the threshold argument shared by Detect and TemporalDetect, in 8-bit sample values with a
+// default of 2, so the same value runs the same test in both. Returns 0 and sets an error on invalid input.
+static int getThreshold(const VSMap *in, VSMap *out, const char *name, int *threshold, const VSAPI *vsapi) {
+	int err;
+
+	// If a property read fails for some reason (index out of bounds/wrong type)
+	// then err will have flags set to indicate why and 0 will be returned. This
+	// can be very useful to know when having optional arguments. Since we have
+	// strict checking because of what we wrote in the argument string, the only
+	// reason this could fail is when the value wasn't set by the user.
+	// And when it's not set we want it to default to enabled.
+	*threshold = int64ToIntS(vsapi->propGetInt(in, "threshold", 0, &err));
+	if (err)
+		*threshold = 2;
+
+	if (*threshold < 0) {
+		char msg[128];
+		snprintf(msg, sizeof(msg), "%s: threshold must be a positive value", name);
+		vsapi->setError(out, msg);
+		return 0;
+	}
+
+	return 1;
+}
+
 // This function is responsible for validating arguments and creating a new filter
 static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
 	VideoData d;
@@ -184,26 +306,15 @@ static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *co
 	d.node = vsapi->propGetNode(in, "clip", 0, 0);
 	d.vi = vsapi->getVideoInfo(d.node);
 
-	// In this first version we only want to handle 8bit integer formats. Note that
+	// There are kernels for 8, 10, 12 and 16-bit integer formats. Note that
 	// vi->format can be 0 if the input clip can change format midstream.
-	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || d.vi->format->bitsPerSample != 8) {
-		vsapi->setError(out, "DotDetect: only constant format 8-bit integer input supported");
+	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || !isSupportedBitDepth(d.vi->format->bitsPerSample)) {
+		vsapi->setError(out, "DotDetect: only constant format 8, 10, 12 or 16-bit integer input supported");
 		vsapi->freeNode(d.node);
 		return;
 	}
-	
-	// If a property read fails for some reason (index out of bounds/wrong type)
-	// then err will have flags set to indicate why and 0 will be returned. This
-	// can be very useful to know when having optional arguments. Since we have
-	// strict checking because of what we wrote in the argument string, the only
-	// reason this could fail is when the value wasn't set by the user.
-	// And when it's not set we want it to default to enabled.
-	d.threshold = !!vsapi->propGetInt(in, "threshold", 0, &err);
-	if (err)
-		d.threshold = 2;
 
-	if (d.threshold < 0) {
-		vsapi->setError(out, "DotDetect: threshold must be a positive value");
+	if (!getThreshold(in, out, "DotDetect", &d.threshold, vsapi)) {
 		vsapi->freeNode(d.node);
 		return;
 	}
@@ -214,6 +325,69 @@ static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *co
 		return;
 	}
 
+	int threads = int64ToIntS(vsapi->propGetInt(in, "threads", 0, &err));
+	if (err)
+		threads = 1;
+
+	if (threads < 0) {
+		vsapi->setError(out, "DotDetect: threads must be a positive value");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	CpuLevel cpu;
+
+	if (!parseCpuLevel(vsapi->propGetData(in, "opt", 0, &err), &cpu)) {
+		vsapi->setError(out, "DotDetect: opt must be auto, c, sse2, ssse3, avx2 or avx512bw, and supported by the CPU");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	DotCrawlSystem system;
+
+	if (!parseDotCrawlSystem(vsapi->propGetData(in, "system", 0, &err), &system)) {
+		vsapi->setError(out, "DotDetect: system must be ntsc-4fsc, ntsc-13.5 or pal-4.43");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	// 0 uses as many threads as the core
+	if (threads == 0)
+		threads = vsapi->getCoreInfo(core)->numThreads;
+
+	// Masks are written to plane 0 of the input format unless gray output is requested,
+	// which saves allocating chroma planes that are never written.
+	d.outVi = *d.vi;
+
+	if (vsapi->propGetInt(in, "gray", 0, &err))
+		d.outVi.format = vsapi->registerFormat(cmGray, stInteger, d.vi->format->bitsPerSample, 0, 0, core);
+
+	// Packed masks hold one bit per pixel in a GRAY8 frame of a width rounded up to whole bytes.
+	d.packMaskRow = NULL;
+
+	if (vsapi->propGetInt(in, "packed", 0, &err)) {
+		if (d.outVi.format != d.vi->format) {
+			vsapi->setError(out, "DotDetect: packed and gray cannot be combined");
+			vsapi->freeNode(d.node);
+			return;
+		}
+
+		d.outVi.format = vsapi->getFormatPreset(pfGray8, core);
+		d.outVi.width = packedRowBytes(d.vi->width);
+		d.packMaskRow = selectPackMaskRow(d.vi->format->bytesPerSample, cpu);
+	}
+
+	d.countMaskRow = selectCountMaskRow(d.vi->format->bytesPerSample, d.packMaskRow != NULL, cpu);
+
+	// the threshold is given for 8-bit samples
+	d.threshold <<= d.vi->format->bitsPerSample - 8;
+	d.lineDistance = dotCrawlLineDistance(system);
+	d.dotCrawlRow = selectDotCrawlRow(system, d.vi->format->bitsPerSample, cpu);
+	d.maps[0] = d.maps[1] = NULL;
+	d.pool = createThreadPool(threads);
+
+	d.profile = vsapi->propGetInt(in, "profile", 0, &err) ? createProfile("DotDetect") : NULL;
+
 	// I usually keep the filter data struct on the stack and don't allocate it
 	// until all the input validation is done.
 	data = malloc(sizeof(d));
@@ -236,6 +410,95 @@ static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *co
 	vsapi->createFilter(in, out, "DotDetect", init, getFrame, freeResources, fmParallel, 0, data, core);
 }
 
+// This function is responsible for validating arguments and creating a new filter
+static void VS_CC temporalCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+	VideoData d;
+	VideoData *data;
+	int err;
+
+	// Get a clip reference from the input arguments. This must be freed later.
+	d.node = vsapi->propGetNode(in, "clip", 0, 0);
+	d.vi = vsapi->getVideoInfo(d.node);
+
+	// There are kernels for 8, 10, 12 and 16-bit integer formats. Note that
+	// vi->format can be 0 if the input clip can change format midstream.
+	// The cached maps also need constant dimensions, which isConstantFormat checks.
+	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || !isSupportedBitDepth(d.vi->format->bitsPerSample)) {
+		vsapi->setError(out, "TemporalDetect: only constant format 8, 10, 12 or 16-bit integer input supported");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	if (!getThreshold(in, out, "TemporalDetect", &d.threshold, vsapi)) {
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	if (d.vi->format->colorFamily != cmYUV) {
+		vsapi->setError(out, "TemporalDetect: YUV input is required");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	int threads = int64ToIntS(vsapi->propGetInt(in, "threads", 0, &err));
+	if (err)
+		threads = 1;
+
+	if (threads < 0) {
+		vsapi->setError(out, "TemporalDetect: threads must be a positive value");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	CpuLevel cpu;
+
+	if (!parseCpuLevel(vsapi->propGetData(in, "opt", 0, &err), &cpu)) {
+		vsapi->setError(out, "TemporalDetect: opt must be auto, c, sse2, ssse3, avx2 or avx512bw, and supported by the CPU");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	DotCrawlSystem system;
+
+	if (!parseDotCrawlSystem(vsapi->propGetData(in, "system", 0, &err), &system)) {
+		vsapi->setError(out, "TemporalDetect: system must be ntsc-4fsc, ntsc-13.5 or pal-4.43");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	// 0 uses as many threads as the core
+	if (threads == 0)
+		threads = vsapi->getCoreInfo(core)->numThreads;
+
+	// The classification is not a sample value, so it is always written to a GRAY8 frame.
+	d.outVi = *d.vi;
+	d.outVi.format = vsapi->getFormatPreset(pfGray8, core);
+
+	// the threshold is given for 8-bit samples
+	d.threshold <<= d.vi->format->bitsPerSample - 8;
+	d.lineDistance = dotCrawlLineDistance(system);
+	d.dotCrawlRow = selectDotCrawlRow(system, d.vi->format->bitsPerSample, cpu);
+	d.packMaskRow = NULL;
+	d.countMaskRow = NULL;
+	d.pool = createThreadPool(threads);
+
+	size_t mapSize = (size_t)d.vi->width * d.vi->height * d.vi->format->bytesPerSample;
+	d.maps[0] = malloc(mapSize);
+	d.maps[1] = malloc(mapSize);
+	d.cached = 0;
+	d.cachedN = -1;
+
+	d.profile = vsapi->propGetInt(in, "profile", 0, &err) ? createProfile("TemporalDetect") : NULL;
+
+	// I usually keep the filter data struct on the stack and don't allocate it
+	// until all the input validation is done.
+	data = malloc(sizeof(d));
+	*data = d;
+
+	// Maps are cached across frames, so frames must be produced one at a time.
+	vsapi->createFilter(in, out, "TemporalDetect", init, temporalGetFrame, freeResources, fmParallelRequests, 0, data, core);
+}
+
 //////////////////////////////////////////
 // Init
 
@@ -263,6 +526,11 @@ static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *co
 // or not empty arrays are accepted
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin) {
+	// Kernels are selected per filter from the instruction set level of the CPU, detected once here,
+	// and UNCROSS_TRACE is read once per load.
+	initCpuLevel();
+	initTrace();
 	configFunc("github.com.rzumer.dotdetect", "dotdetect", "Dot Detect", VAPOURSYNTH_API_VERSION, 1, plugin);
-	registerFunc("Detect", "clip:clip;threshold:int:opt;", create, 0, plugin);
+	registerFunc("Detect", "clip:clip;threshold:int:opt;gray:int:opt;packed:int:opt;system:data:opt;threads:int:opt;opt:data:opt;profile:int:opt;", create, 0, plugin);
+	registerFunc("TemporalDetect", "clip:clip;threshold:int:opt;system:data:opt;threads:int:opt;opt:data:opt;profile:int:opt;", temporalCreate, 0, plugin);
 }
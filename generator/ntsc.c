@@ -0,0 +1,256 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ntsc.h"
+
+#define PI 3.14159265358979323846
+
+void initNtscParams(NtscParams *params) {
+	params->samplesPerCycle = 4.0;
+	params->decoder = ntscNotch;
+	params->chromaGain = 1.0;
+	params->maskThreshold = 3;
+}
+
+int allocNtscFrame(NtscFrame *frame, int width, int height) {
+	size_t size = (size_t)width * height;
+
+	frame->width = width;
+	frame->height = height;
+	frame->y = malloc(size);
+	frame->u = malloc(size);
+	frame->v = malloc(size);
+
+	if (!frame->y || !frame->u || !frame->v) {
+		freeNtscFrame(frame);
+		return 0;
+	}
+
+	return 1;
+}
+
+void freeNtscFrame(NtscFrame *frame) {
+	free(frame->y);
+	free(frame->u);
+	free(frame->v);
+	frame->y = frame->u = frame->v = NULL;
+}
+
+static uint8_t clampSample(double value) {
+	return value <= 0 ? 0 : value >= 255 ? 255 : (uint8_t)(value + 0.5);
+}
+
+// 75% color bars in BT.601 limited range: white, yellow, cyan, green, magenta, red, blue.
+static const uint8_t bars[7][3] = {
+	{ 180, 128, 128 },
+	{ 162, 44, 142 },
+	{ 131, 156, 44 },
+	{ 112, 72, 58 },
+	{ 84, 184, 198 },
+	{ 65, 100, 212 },
+	{ 35, 212, 114 },
+};
+
+void drawNtscScene(NtscFrame *frame, int n) {
+	int width = frame->width;
+	int height = frame->height;
+	int barWidth = width / 7 > 0 ? width / 7 : 1;
+	int blockWidth = width / 12 > 8 ? width / 12 : 8;
+	int blockHeight = height / 12 > 4 ? height / 12 : 4;
+
+	for (int y = 0; y < height; y++) {
+		uint8_t *dstpy = frame->y + (size_t)y * width;
+		uint8_t *dstpu = frame->u + (size_t)y * width;
+		uint8_t *dstpv = frame->v + (size_t)y * width;
+		int band = y * 3 / height;
+
+		for (int x = 0; x < width; x++) {
+			double luma = 40 + 160.0 * x / width;
+			int u = 128;
+			int v = 128;
+
+			if (band == 0) {
+				// color bars scrolling left by 2 pixels per frame
+				int bar = (((x + 2 * n) / barWidth) % 7 + 7) % 7;
+				luma = bars[bar][0];
+				u = bars[bar][1];
+				v = bars[bar][2];
+			}
+			else if (band == 1 && x < width / 2) {
+				// vertical stripes with a period of 4 pixels, right at the subcarrier frequency at 4fsc
+				luma = 128 + 60 * cos(PI / 2 * (x + n));
+			}
+			else if (band == 1) {
+				// zone plate reaching half the sampling rate at the corners, moving up by one line per frame
+				double dx = x - width * 0.75;
+				double dy = y - height * 0.5 + n;
+				double k = PI / (width * 0.5);
+				luma = 128 + 60 * cos(k * (dx * dx + dy * dy));
+			}
+			else {
+				// saturated blocks moving right by 3 pixels per frame, with a fine checkerboard inside
+				int bx = x - 3 * n;
+				int cellX = ((bx / blockWidth) % 4 + 4) % 4;
+				int cellY = (y / blockHeight) % 2;
+
+				if ((cellX + cellY) % 2) {
+					const uint8_t *color = bars[1 + (cellX + 2 * cellY) % 6];
+					luma = color[0] + ((bx + y) & 1 ? 20 : -20);
+					u = color[1];
+					v = color[2];
+				}
+			}
+
+			dstpy[x] = clampSample(luma);
+			dstpu[x] = u;
+			dstpv[x] = v;
+		}
+	}
+}
+
+// Subcarrier of each sample of a line with even phase; lines of odd phase are the negation.
+typedef struct {
+	double *sine;
+	double *cosine;
+	double gain;
+	int window; // length of the low pass box filters, one subcarrier period
+} Subcarrier;
+
+static double lineSign(int y, int n) {
+	return ((y + n) & 1) ? -1.0 : 1.0;
+}
+
+static void encodeComposite(const NtscFrame *src, int n, const Subcarrier *carrier, int luma, int chroma, double *composite) {
+	for (int y = 0; y < src->height; y++) {
+		size_t row = (size_t)y * src->width;
+		double sign = lineSign(y, n) * carrier->gain;
+
+		for (int x = 0; x < src->width; x++) {
+			double value = luma ? src->y[row + x] : 0;
+
+			if (chroma) {
+				value += sign * ((src->u[row + x] - 128) * carrier->sine[x] + (src->v[row + x] - 128) * carrier->cosine[x]);
+			}
+
+			composite[row + x] = value;
+		}
+	}
+}
+
+// Demodulate the chroma of a line and filter out the components at twice the subcarrier frequency.
+static void demodulateLine(const double *chromap, int width, double sign, const Subcarrier *carrier, double *u, double *v, double *scratch) {
+	double *pu = scratch;
+	double *pv = scratch + width;
+	int before = carrier->window / 2;
+
+	for (int x = 0; x < width; x++) {
+		pu[x] = 2 * chromap[x] * sign * carrier->sine[x] / carrier->gain;
+		pv[x] = 2 * chromap[x] * sign * carrier->cosine[x] / carrier->gain;
+	}
+
+	for (int x = 0; x < width; x++) {
+		int start = x - before < 0 ? 0 : x - before;
+		int end = x - before + carrier->window > width ? width : x - before + carrier->window;
+		double sumU = 0;
+		double sumV = 0;
+
+		for (int k = start; k < end; k++) {
+			sumU += pu[k];
+			sumV += pv[k];
+		}
+
+		u[x] = sumU / (end - start);
+		v[x] = sumV / (end - start);
+	}
+}
+
+// Separate a composite frame into luma and chroma differences centered on 0.
+static void decodeComposite(const double *composite, int width, int height, int n, NtscDecoder decoder, const Subcarrier *carrier, double *y, double *u, double *v) {
+	double *chroma = malloc(width * 3 * sizeof(double));
+	double *scratch = chroma + width;
+
+	for (int line = 0; line < height; line++) {
+		size_t row = (size_t)line * width;
+		const double *srcp = composite + row;
+		double sign = lineSign(line, n);
+
+		if (decoder == ntscComb && height > 1) {
+			// the neighbouring line has the opposite phase: the difference is chroma and the sum is luma
+			const double *otherp = composite + (size_t)(line > 0 ? line - 1 : 1) * width;
+
+			for (int x = 0; x < width; x++) {
+				chroma[x] = (srcp[x] - otherp[x]) / 2;
+				y[row + x] = (srcp[x] + otherp[x]) / 2;
+			}
+
+			demodulateLine(chroma, width, sign, carrier, u + row, v + row, scratch);
+		}
+		else {
+			// the chroma is remodulated from the filtered differences and subtracted from the composite
+			demodulateLine(srcp, width, sign, carrier, u + row, v + row, scratch);
+
+			for (int x = 0; x < width; x++) {
+				double remodulated = sign * carrier->gain * (u[row + x] * carrier->sine[x] + v[row + x] * carrier->cosine[x]);
+				y[row + x] = srcp[x] - remodulated;
+			}
+		}
+	}
+
+	free(chroma);
+}
+
+void simulateNtsc(const NtscFrame *src, int n, const NtscParams *params, NtscFrame *dst, uint8_t *dotCrawlMask, uint8_t *rainbowMask) {
+	int width = src->width;
+	int height = src->height;
+	size_t size = (size_t)width * height;
+	Subcarrier carrier;
+
+	carrier.sine = malloc(width * 2 * sizeof(double));
+	carrier.cosine = carrier.sine + width;
+	carrier.gain = params->chromaGain > 0 ? params->chromaGain : 1.0;
+	carrier.window = (int)(params->samplesPerCycle + 0.5) > 2 ? (int)(params->samplesPerCycle + 0.5) : 2;
+
+	for (int x = 0; x < width; x++) {
+		double phase = 2 * PI * x / params->samplesPerCycle;
+		carrier.sine[x] = sin(phase);
+		carrier.cosine[x] = cos(phase);
+	}
+
+	double *composite = malloc(size * sizeof(double));
+	double *y = malloc(size * 3 * sizeof(double));
+	double *u = y + size;
+	double *v = u + size;
+
+	encodeComposite(src, n, &carrier, 1, 1, composite);
+	decodeComposite(composite, width, height, n, params->decoder, &carrier, y, u, v);
+
+	for (size_t i = 0; i < size; i++) {
+		dst->y[i] = clampSample(y[i]);
+		dst->u[i] = clampSample(u[i] + 128);
+		dst->v[i] = clampSample(v[i] + 128);
+	}
+
+	// chroma decoded as luma
+	if (dotCrawlMask) {
+		encodeComposite(src, n, &carrier, 0, 1, composite);
+		decodeComposite(composite, width, height, n, params->decoder, &carrier, y, u, v);
+
+		for (size_t i = 0; i < size; i++) {
+			dotCrawlMask[i] = fabs(y[i]) > params->maskThreshold ? 255 : 0;
+		}
+	}
+
+	// luma decoded as chroma
+	if (rainbowMask) {
+		encodeComposite(src, n, &carrier, 1, 0, composite);
+		decodeComposite(composite, width, height, n, params->decoder, &carrier, y, u, v);
+
+		for (size_t i = 0; i < size; i++) {
+			rainbowMask[i] = fabs(u[i]) > params->maskThreshold || fabs(v[i]) > params->maskThreshold ? 255 : 0;
+		}
+	}
+
+	free(y);
+	free(composite);
+	free(carrier.sine);
+}
@@ -0,0 +1,47 @@
+#ifndef UNCROSS_NTSC_H
+#define UNCROSS_NTSC_H
+
+#include <stdint.h>
+
+// Simulation of an NTSC composite round trip on 8-bit 4:4:4 frames. Luma and chroma are encoded into
+// one composite signal whose subcarrier phase advances by 2 pi / samplesPerCycle per pixel and flips
+// on every line and every frame, then separated again by a simple decoder. What the decoder gets wrong
+// is the artifact: chroma left in luma is dot crawl, luma taken for chroma is rainbows. The decoders are
+// linear, so each artifact is measured exactly by decoding the chroma or the luma part of the signal alone.
+
+typedef enum {
+	ntscNotch, // horizontal filters only: dot crawl along chroma edges, rainbows on fine luma detail
+	ntscComb, // two-line comb: clean on flat areas, dot crawl and rainbows on vertical changes
+} NtscDecoder;
+
+typedef struct {
+	double samplesPerCycle; // sampling rate over the subcarrier frequency: 4 at 4fsc, about 3.77 at 13.5 MHz
+	NtscDecoder decoder;
+	double chromaGain; // amplitude of the subcarrier relative to the chroma difference, 1 nominal
+	int maskThreshold; // error in 8-bit steps above which a pixel is flagged in the ground truth masks
+} NtscParams;
+
+// A frame of 8-bit 4:4:4 planes, all with a stride of width.
+typedef struct {
+	int width;
+	int height;
+	uint8_t *y;
+	uint8_t *u;
+	uint8_t *v;
+} NtscFrame;
+
+void initNtscParams(NtscParams *params);
+
+// Allocate and free the planes of a frame.
+int allocNtscFrame(NtscFrame *frame, int width, int height);
+void freeNtscFrame(NtscFrame *frame);
+
+// Draw frame n of a test scene: saturated color bars and blocks moving over a gradient for dot crawl,
+// and fine luma stripes and a zone plate near the subcarrier frequency for rainbows.
+void drawNtscScene(NtscFrame *frame, int n);
+
+// Encode frame n of src to composite and decode it into dst. The ground truth masks, which may be NULL,
+// are set to 255 where the dot crawl (luma) or rainbow (chroma) error exceeds the threshold, 0 elsewhere.
+void simulateNtsc(const NtscFrame *src, int n, const NtscParams *params, NtscFrame *dst, uint8_t *dotCrawlMask, uint8_t *rainbowMask);
+
+#endif
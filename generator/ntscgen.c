@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ntsc.h"
+
+// Writes a clip with simulated NTSC artifacts and its ground truth masks as YUV4MPEG2 files.
+//
+// Usage: ntscgen [options] output.y4m
+//   -i input.y4m   encode the frames of an 8-bit 4:2:0 or 4:4:4 clip instead of the test scene
+//   -w width, -h height, -n frames
+//                  dimensions and length of the test scene (720x480, 60 frames)
+//   -s rate        sampling rate: 4fsc, 13.5 (MHz) or a number of samples per subcarrier cycle (4fsc)
+//   -d decoder     notch or comb (notch)
+//   -g gain        subcarrier amplitude, 1 nominal
+//   -t threshold   ground truth threshold in 8-bit steps (3)
+//   -c chroma      420 or 444 output (420)
+//   -D file        write the dot crawl ground truth mask as a gray clip
+//   -R file        write the rainbow ground truth mask as a gray clip
+
+#define NTSC_FSC 3.579545 // MHz
+
+typedef struct {
+	FILE *file;
+	int width;
+	int height;
+	int subsampled; // 4:2:0 instead of 4:4:4
+} Y4MFile;
+
+static void usage(void) {
+	fprintf(stderr, "Usage: ntscgen [-i input.y4m] [-w width] [-h height] [-n frames] [-s 4fsc|13.5|samples] [-d notch|comb] [-g gain] [-t threshold] [-c 420|444] [-D dotcrawl.y4m] [-R rainbow.y4m] output.y4m\n");
+	exit(2);
+}
+
+static int openInput(Y4MFile *y4m, const char *path) {
+	char header[256];
+	const char *chroma;
+
+	y4m->file = fopen(path, "rb");
+
+	if (!y4m->file || !fgets(header, sizeof(header), y4m->file) || strncmp(header, "YUV4MPEG2 ", 10)) {
+		fprintf(stderr, "ntscgen: %s is not a YUV4MPEG2 file\n", path);
+		return 0;
+	}
+
+	y4m->width = 0;
+	y4m->height = 0;
+	y4m->subsampled = 1;
+
+	for (char *token = strtok(header + 10, " \n"); token; token = strtok(NULL, " \n")) {
+		if (token[0] == 'W') {
+			y4m->width = atoi(token + 1);
+		}
+		else if (token[0] == 'H') {
+			y4m->height = atoi(token + 1);
+		}
+		else if (token[0] == 'C') {
+			chroma = token + 1;
+
+			if (!strcmp(chroma, "444")) {
+				y4m->subsampled = 0;
+			}
+			else if (strncmp(chroma, "420", 3) || strstr(chroma, "p1") || strstr(chroma, "p9")) {
+				fprintf(stderr, "ntscgen: only 8-bit 4:2:0 and 4:4:4 input is supported\n");
+				return 0;
+			}
+		}
+	}
+
+	if (y4m->width <= 0 || y4m->height <= 0 || (y4m->subsampled && ((y4m->width | y4m->height) & 1))) {
+		fprintf(stderr, "ntscgen: invalid dimensions in %s\n", path);
+		return 0;
+	}
+
+	return 1;
+}
+
+// Read the next frame into 4:4:4 planes, repeating subsampled chroma. Returns 0 at the end of the file.
+static int readFrame(Y4MFile *y4m, NtscFrame *frame, uint8_t *scratch) {
+	char line[256];
+	int width = y4m->width;
+	int height = y4m->height;
+	size_t size = (size_t)width * height;
+
+	if (!fgets(line, sizeof(line), y4m->file) || strncmp(line, "FRAME", 5) || fread(frame->y, 1, size, y4m->file) != size) {
+		return 0;
+	}
+
+	if (!y4m->subsampled) {
+		return fread(frame->u, 1, size, y4m->file) == size && fread(frame->v, 1, size, y4m->file) == size;
+	}
+
+	int chromaWidth = width / 2;
+	size_t chromaSize = size / 4;
+	uint8_t *planes[2] = { frame->u, frame->v };
+
+	for (int p = 0; p < 2; p++) {
+		if (fread(scratch, 1, chromaSize, y4m->file) != chromaSize) {
+			return 0;
+		}
+
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				planes[p][(size_t)y * width + x] = scratch[(y / 2) * chromaWidth + x / 2];
+			}
+		}
+	}
+
+	return 1;
+}
+
+static FILE *openOutput(const char *path, int width, int height, const char *chroma) {
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		fprintf(stderr, "ntscgen: cannot write %s\n", path);
+		return NULL;
+	}
+
+	fprintf(file, "YUV4MPEG2 W%d H%d F30000:1001 Ip A1:1 C%s\n", width, height, chroma);
+	return file;
+}
+
+// Write a frame, averaging chroma over 2x2 pixels for 4:2:0 output.
+static void writeFrame(FILE *file, const NtscFrame *frame, int subsampled, uint8_t *scratch) {
+	int width = frame->width;
+	int height = frame->height;
+	size_t size = (size_t)width * height;
+	const uint8_t *planes[2] = { frame->u, frame->v };
+
+	fputs("FRAME\n", file);
+	fwrite(frame->y, 1, size, file);
+
+	for (int p = 0; p < 2; p++) {
+		if (!subsampled) {
+			fwrite(planes[p], 1, size, file);
+			continue;
+		}
+
+		for (int y = 0; y < height / 2; y++) {
+			const uint8_t *srcp = planes[p] + (size_t)y * 2 * width;
+
+			for (int x = 0; x < width / 2; x++) {
+				scratch[x] = (srcp[2 * x] + srcp[2 * x + 1] + srcp[width + 2 * x] + srcp[width + 2 * x + 1] + 2) >> 2;
+			}
+
+			fwrite(scratch, 1, width / 2, file);
+		}
+	}
+}
+
+static void writeMask(FILE *file, const uint8_t *mask, size_t size) {
+	fputs("FRAME\n", file);
+	fwrite(mask, 1, size, file);
+}
+
+int main(int argc, char **argv) {
+	NtscParams params;
+	Y4MFile input = { NULL, 720, 480, 0 };
+	const char *inputPath = NULL;
+	const char *dotCrawlPath = NULL;
+	const char *rainbowPath = NULL;
+	int numFrames = 60;
+	int subsampled = 1;
+	int i = 1;
+
+	initNtscParams(&params);
+
+	for (; i < argc && argv[i][0] == '-'; i += 2) {
+		if (i + 1 >= argc || argv[i][2]) {
+			usage();
+		}
+
+		const char *value = argv[i + 1];
+
+		switch (argv[i][1]) {
+		case 'i': inputPath = value; break;
+		case 'w': input.width = atoi(value); break;
+		case 'h': input.height = atoi(value); break;
+		case 'n': numFrames = atoi(value); break;
+		case 'g': params.chromaGain = atof(value); break;
+		case 't': params.maskThreshold = atoi(value); break;
+		case 'D': dotCrawlPath = value; break;
+		case 'R': rainbowPath = value; break;
+		case 's':
+			params.samplesPerCycle = !strcmp(value, "4fsc") ? 4.0 : atof(value) > 8 ? atof(value) / NTSC_FSC : atof(value);
+			break;
+		case 'd':
+			if (!strcmp(value, "notch")) {
+				params.decoder = ntscNotch;
+			}
+			else if (!strcmp(value, "comb")) {
+				params.decoder = ntscComb;
+			}
+			else {
+				usage();
+			}
+			break;
+		case 'c':
+			if (strcmp(value, "420") && strcmp(value, "444")) {
+				usage();
+			}
+			subsampled = !strcmp(value, "420");
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (argc - i != 1 || params.samplesPerCycle < 2) {
+		usage();
+	}
+
+	if (inputPath && !openInput(&input, inputPath)) {
+		return 1;
+	}
+
+	int width = input.width;
+	int height = input.height;
+	size_t size = (size_t)width * height;
+
+	if (width <= 0 || height <= 0 || numFrames <= 0 || (subsampled && ((width | height) & 1))) {
+		fprintf(stderr, "ntscgen: 4:2:0 output needs even dimensions\n");
+		return 1;
+	}
+
+	NtscFrame src;
+	NtscFrame dst;
+	uint8_t *dotCrawlMask = malloc(size);
+	uint8_t *rainbowMask = malloc(size);
+	uint8_t *scratch = malloc(size);
+
+	if (!allocNtscFrame(&src, width, height) || !allocNtscFrame(&dst, width, height) || !dotCrawlMask || !rainbowMask || !scratch) {
+		fprintf(stderr, "ntscgen: out of memory\n");
+		return 1;
+	}
+
+	FILE *output = openOutput(argv[i], width, height, subsampled ? "420jpeg" : "444");
+	FILE *dotCrawlOutput = dotCrawlPath ? openOutput(dotCrawlPath, width, height, "mono") : NULL;
+	FILE *rainbowOutput = rainbowPath ? openOutput(rainbowPath, width, height, "mono") : NULL;
+
+	if (!output || (dotCrawlPath && !dotCrawlOutput) || (rainbowPath && !rainbowOutput)) {
+		return 1;
+	}
+
+	int n = 0;
+
+	for (; inputPath || n < numFrames; n++) {
+		if (inputPath) {
+			if (!readFrame(&input, &src, scratch)) {
+				break;
+			}
+		}
+		else {
+			drawNtscScene(&src, n);
+		}
+
+		simulateNtsc(&src, n, &params, &dst, dotCrawlOutput ? dotCrawlMask : NULL, rainbowOutput ? rainbowMask : NULL);
+		writeFrame(output, &dst, subsampled, scratch);
+
+		if (dotCrawlOutput) {
+			writeMask(dotCrawlOutput, dotCrawlMask, size);
+		}
+		if (rainbowOutput) {
+			writeMask(rainbowOutput, rainbowMask, size);
+		}
+	}
+
+	fprintf(stderr, "ntscgen: wrote %d frames of %dx%d\n", n, width, height);
+
+	fclose(output);
+
+	if (dotCrawlOutput) {
+		fclose(dotCrawlOutput);
+	}
+	if (rainbowOutput) {
+		fclose(rainbowOutput);
+	}
+	if (input.file) {
+		fclose(input.file);
+	}
+
+	freeNtscFrame(&src);
+	freeNtscFrame(&dst);
+	free(dotCrawlMask);
+	free(rainbowMask);
+	free(scratch);
+	return 0;
+}
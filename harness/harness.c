@@ -0,0 +1,585 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vsmock.h"
+#include "simd.h"
+#include "ntsc.h"
+
+// Renders a filter of a plugin over a synthetic clip through the mock VSAPI and reports its cost.
+//
+// Usage: harness [options] plugin.so function [key=value ...]
+//   -w width, -h height  clip dimensions (1920x1080)
+//   -f format            yuv420p8, yuv422p8, yuv440p8, yuv444p8 or gray8, with 8, 10, 12 or 16 bits (yuv420p8)
+//   -n frames            clip length (100)
+//   -o order             sequential, reverse or random frame order (sequential)
+//   -j threads           thread count reported by the core, used by filters given threads=0 (1)
+//   -t list              run once per comma separated value of the threads argument, e.g. -t 1,2,4
+//   -s source            pattern, ntsc or ntsc-comb: the default pattern, or the NTSC test scene of the generator
+//                        decoded with the notch or comb decoder (pattern)
+//   -m mask              dotcrawl or rainbow: score the luma plane of the output against that ground truth
+//                        mask of the NTSC source, counting every non-zero sample as flagged
+//
+// Arguments are converted to the types the function was registered with. Clip arguments take the
+// value src, the synthetic clip, which is also passed to every required clip argument left unset.
+
+typedef enum {
+	orderSequential,
+	orderReverse,
+	orderRandom,
+} FrameOrder;
+
+typedef struct {
+	int width;
+	int height;
+	int numFrames;
+	const VSFormat *format;
+	FrameOrder order;
+	const char *threads; // values of the threads argument, NULL to leave it unset
+	const NtscParams *ntsc; // NULL for the default pattern
+	const char *truth; // ground truth mask to score the output against, NULL for none
+} Options;
+
+static double sourceSeconds; // spent filling source frames, which is not the filter's cost
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(void) {
+	fprintf(stderr, "Usage: harness [-w width] [-h height] [-f format] [-n frames] [-o order] [-j threads] [-t threads,...] [-s source] [-m mask] plugin.so function [key=value ...]\n");
+	exit(2);
+}
+
+// Parse names like yuv420p10 and gray16.
+static const VSFormat *parseFormat(const char *name, const VSAPI *vsapi) {
+	int bits = 0;
+
+	if (sscanf(name, "gray%d", &bits) == 1) {
+		return isSupportedBitDepth(bits) ? vsapi->registerFormat(cmGray, stInteger, bits, 0, 0, mockCore()) : NULL;
+	}
+
+	if (strncmp(name, "yuv", 3) || strlen(name) < 8 || name[6] != 'p' || sscanf(name + 7, "%d", &bits) != 1 || !isSupportedBitDepth(bits)) {
+		return NULL;
+	}
+
+	static const struct {
+		const char *name;
+		int ssW;
+		int ssH;
+	} subsamplings[] = {
+		{ "420", 1, 1 },
+		{ "422", 1, 0 },
+		{ "440", 0, 1 },
+		{ "444", 0, 0 },
+	};
+
+	for (size_t i = 0; i < sizeof subsamplings / sizeof *subsamplings; i++) {
+		if (!strncmp(name + 3, subsamplings[i].name, 3)) {
+			return vsapi->registerFormat(cmYUV, stInteger, bits, subsamplings[i].ssW, subsamplings[i].ssH, mockCore());
+		}
+	}
+
+	return NULL;
+}
+
+// A gradient moving right by 2 pixels per frame, with a fine checkerboard over every other 32x32
+// square for the dot crawl detector and chroma that shifts by a few values per frame for the rainbow detector.
+static void fillPattern(VSFrameRef *frame, int n, const VSAPI *vsapi) {
+	const VSFormat *fi = vsapi->getFrameFormat(frame);
+	int shift = fi->bitsPerSample - 8;
+
+	for (int plane = 0; plane < fi->numPlanes; plane++) {
+		uint8_t *dstp = vsapi->getWritePtr(frame, plane);
+		int stride = vsapi->getStride(frame, plane);
+		int width = vsapi->getFrameWidth(frame, plane);
+		int height = vsapi->getFrameHeight(frame, plane);
+
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				int sx = x - 2 * n;
+				int value;
+
+				if (plane) {
+					value = 128 + ((sx * 3 + y + n * 9 * plane) & 31) - 16;
+				}
+				else {
+					value = 32 + ((sx + 2 * y) & 127) + ((((sx >> 5) + (y >> 5)) & 1) ? ((sx + y) & 1) * 48 : 24);
+				}
+
+				if (fi->bytesPerSample == 1) {
+					dstp[x] = value;
+				}
+				else {
+					((uint16_t *)dstp)[x] = value << shift;
+				}
+			}
+
+			dstp += stride;
+		}
+	}
+}
+
+// Run the generator on frame n of its test scene. The masks may be NULL.
+static int simulateScene(int width, int height, int n, const NtscParams *params, NtscFrame *decoded, uint8_t *dotCrawlMask, uint8_t *rainbowMask) {
+	NtscFrame scene;
+
+	if (!allocNtscFrame(&scene, width, height)) {
+		return 0;
+	}
+
+	drawNtscScene(&scene, n);
+	simulateNtsc(&scene, n, params, decoded, dotCrawlMask, rainbowMask);
+	freeNtscFrame(&scene);
+	return 1;
+}
+
+// The decoded NTSC scene, with chroma averaged over the subsampled blocks.
+static void fillNtsc(VSFrameRef *frame, int n, const NtscParams *params, const VSAPI *vsapi) {
+	const VSFormat *fi = vsapi->getFrameFormat(frame);
+	int width = vsapi->getFrameWidth(frame, 0);
+	int height = vsapi->getFrameHeight(frame, 0);
+	int shift = fi->bitsPerSample - 8;
+	NtscFrame decoded;
+
+	if (!allocNtscFrame(&decoded, width, height) || !simulateScene(width, height, n, params, &decoded, NULL, NULL)) {
+		fprintf(stderr, "harness: out of memory\n");
+		exit(1);
+	}
+
+	const uint8_t *planes[3] = { decoded.y, decoded.u, decoded.v };
+
+	for (int plane = 0; plane < fi->numPlanes; plane++) {
+		uint8_t *dstp = vsapi->getWritePtr(frame, plane);
+		int stride = vsapi->getStride(frame, plane);
+		int ssW = plane ? fi->subSamplingW : 0;
+		int ssH = plane ? fi->subSamplingH : 0;
+
+		for (int y = 0; y < vsapi->getFrameHeight(frame, plane); y++) {
+			for (int x = 0; x < vsapi->getFrameWidth(frame, plane); x++) {
+				int sum = 0;
+
+				for (int dy = 0; dy < 1 << ssH; dy++) {
+					for (int dx = 0; dx < 1 << ssW; dx++) {
+						sum += planes[plane][(size_t)((y << ssH) + dy) * width + (x << ssW) + dx];
+					}
+				}
+
+				int value = (sum + (1 << (ssW + ssH)) / 2) >> (ssW + ssH);
+
+				if (fi->bytesPerSample == 1) {
+					dstp[x] = value;
+				}
+				else {
+					((uint16_t *)dstp)[x] = value << shift;
+				}
+			}
+
+			dstp += stride;
+		}
+	}
+
+	freeNtscFrame(&decoded);
+}
+
+static void fillFrame(VSFrameRef *frame, int n, void *userData, const VSAPI *vsapi) {
+	const Options *options = (const Options *)userData;
+	double start = now();
+
+	if (options->ntsc) {
+		fillNtsc(frame, n, options->ntsc, vsapi);
+	}
+	else {
+		fillPattern(frame, n, vsapi);
+	}
+
+	sourceSeconds += now() - start;
+}
+
+// Flagged samples of the output luma plane matching or missing the ground truth.
+typedef struct {
+	int64_t truePositives;
+	int64_t falsePositives;
+	int64_t falseNegatives;
+} Score;
+
+static void scoreFrame(const VSFrameRef *frame, int n, const Options *options, Score *score, const VSAPI *vsapi) {
+	int width = vsapi->getFrameWidth(frame, 0);
+	int height = vsapi->getFrameHeight(frame, 0);
+	int rainbow = !strcmp(options->truth, "rainbow");
+	const uint8_t *srcp = vsapi->getReadPtr(frame, 0);
+	int stride = vsapi->getStride(frame, 0);
+	int bytesPerSample = vsapi->getFrameFormat(frame)->bytesPerSample;
+	uint8_t *mask = malloc((size_t)width * height);
+	NtscFrame decoded;
+
+	if (!mask || !allocNtscFrame(&decoded, width, height)
+		|| !simulateScene(width, height, n, options->ntsc, &decoded, rainbow ? NULL : mask, rainbow ? mask : NULL)) {
+		fprintf(stderr, "harness: out of memory\n");
+		exit(1);
+	}
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			int flagged = bytesPerSample == 1 ? srcp[x] != 0 : ((const uint16_t *)srcp)[x] != 0;
+			int truth = mask[(size_t)y * width + x] != 0;
+
+			score->truePositives += flagged && truth;
+			score->falsePositives += flagged && !truth;
+			score->falseNegatives += !flagged && truth;
+		}
+
+		srcp += stride;
+	}
+
+	freeNtscFrame(&decoded);
+	free(mask);
+}
+
+// Find the type of an argument in a registration string such as "clip:clip;threshold:int:opt;".
+// Returns 0 if the function has no such argument.
+static int findArg(const char *args, const char *key, char *type, int typeSize, int *optional) {
+	const char *p = args;
+	size_t keyLength = strlen(key);
+
+	while (*p) {
+		const char *end = strchr(p, ';');
+		const char *colon = strchr(p, ':');
+
+		if (!end) {
+			end = p + strlen(p);
+		}
+
+		if (colon && colon < end && (size_t)(colon - p) == keyLength && !strncmp(p, key, keyLength)) {
+			const char *typeEnd = memchr(colon + 1, ':', end - colon - 1);
+			int length = (int)((typeEnd ? typeEnd : end) - colon - 1);
+
+			snprintf(type, typeSize, "%.*s", length, colon + 1);
+			*optional = typeEnd && !strncmp(typeEnd, ":opt", 4);
+			return 1;
+		}
+
+		p = *end ? end + 1 : end;
+	}
+
+	return 0;
+}
+
+// Fill the argument map of a function from key=value strings, then pass src to the required clips left unset.
+static int buildArgs(const char *args, int argc, char **argv, VSNodeRef *src, VSMap *in, const VSAPI *vsapi) {
+	for (int i = 0; i < argc; i++) {
+		char key[64];
+		char type[32];
+		int optional;
+		const char *value = strchr(argv[i], '=');
+
+		if (!value || value - argv[i] >= (int)sizeof(key)) {
+			fprintf(stderr, "harness: expected key=value instead of %s\n", argv[i]);
+			return 0;
+		}
+
+		snprintf(key, sizeof(key), "%.*s", (int)(value - argv[i]), argv[i]);
+		value++;
+
+		if (!findArg(args, key, type, sizeof(type), &optional)) {
+			fprintf(stderr, "harness: the function has no %s argument\n", key);
+			return 0;
+		}
+
+		if (!strncmp(type, "int", 3)) {
+			vsapi->propSetInt(in, key, strtoll(value, NULL, 10), paAppend);
+		}
+		else if (!strncmp(type, "float", 5)) {
+			vsapi->propSetFloat(in, key, strtod(value, NULL), paAppend);
+		}
+		else if (!strncmp(type, "data", 4)) {
+			vsapi->propSetData(in, key, value, -1, paAppend);
+		}
+		else if (!strncmp(type, "clip", 4) && !strcmp(value, "src")) {
+			vsapi->propSetNode(in, key, src, paAppend);
+		}
+		else {
+			fprintf(stderr, "harness: unsupported value for %s argument %s\n", type, key);
+			return 0;
+		}
+	}
+
+	// walk the registration string for required clips
+	for (const char *p = args; *p; ) {
+		const char *end = strchr(p, ';');
+		char entry[128];
+
+		if (!end) {
+			end = p + strlen(p);
+		}
+
+		snprintf(entry, sizeof(entry), "%.*s", (int)(end - p), p);
+
+		char *type = strchr(entry, ':');
+
+		if (type) {
+			*type++ = 0;
+
+			if (!strncmp(type, "clip", 4) && !strstr(type, ":opt") && vsapi->propNumElements(in, entry) < 0) {
+				vsapi->propSetNode(in, entry, src, paAppend);
+			}
+		}
+
+		p = *end ? end + 1 : end;
+	}
+
+	return 1;
+}
+
+// FNV-1a over the visible samples of every plane, to compare the output of runs.
+static uint64_t hashFrame(const VSFrameRef *frame, uint64_t hash, const VSAPI *vsapi) {
+	const VSFormat *fi = vsapi->getFrameFormat(frame);
+
+	for (int plane = 0; plane < fi->numPlanes; plane++) {
+		const uint8_t *srcp = vsapi->getReadPtr(frame, plane);
+		int rowSize = vsapi->getFrameWidth(frame, plane) * fi->bytesPerSample;
+
+		for (int y = 0; y < vsapi->getFrameHeight(frame, plane); y++) {
+			for (int x = 0; x < rowSize; x++) {
+				hash = (hash ^ srcp[x]) * 0x100000001b3ULL;
+			}
+
+			srcp += vsapi->getStride(frame, plane);
+		}
+	}
+
+	return hash;
+}
+
+// Create the filter, render every frame once in the requested order and print one line of results.
+static int run(VSPlugin *plugin, const char *function, const char *threads, int argc, char **argv, const Options *options, const VSAPI *vsapi) {
+	const char *args = mockFunctionArgs(plugin, function);
+	VSNodeRef *src = mockSourceClip(options->format, options->width, options->height, options->numFrames, fillFrame, (void *)options);
+	VSMap *in = vsapi->createMap();
+	MockStats before;
+	char errorMsg[1024];
+	int ok = 0;
+
+	// the peak is counted from the frames alive before the run
+	mockStats()->peakFramesAlive = mockStats()->framesAlive;
+	before = *mockStats();
+
+	if (!buildArgs(args, argc, argv, src, in, vsapi)) {
+		goto done;
+	}
+
+	if (threads) {
+		vsapi->propSetInt(in, "threads", atoi(threads), paReplace);
+	}
+
+	double start = now();
+	VSMap *out = vsapi->invoke(plugin, function, in);
+	double createSeconds = now() - start;
+
+	if (vsapi->getError(out)) {
+		fprintf(stderr, "harness: %s\n", vsapi->getError(out));
+		vsapi->freeMap(out);
+		goto done;
+	}
+
+	VSNodeRef *node = vsapi->propGetNode(out, "clip", 0, NULL);
+	VSVideoInfo vi = *vsapi->getVideoInfo(node);
+	vsapi->freeMap(out);
+
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	double minSeconds = 1e30;
+	double maxSeconds = 0;
+	double totalSeconds = 0;
+	double totalSource = 0;
+	uint32_t seed = 1;
+	Score score = { 0, 0, 0 };
+
+	for (int i = 0; i < vi.numFrames; i++) {
+		int n = i;
+
+		if (options->order == orderReverse) {
+			n = vi.numFrames - 1 - i;
+		}
+		else if (options->order == orderRandom) {
+			seed = seed * 1664525 + 1013904223;
+			n = (int)((uint64_t)(seed >> 8) * vi.numFrames >> 24);
+		}
+
+		double sourceBefore = sourceSeconds;
+		start = now();
+		const VSFrameRef *frame = vsapi->getFrame(n, node, errorMsg, sizeof(errorMsg));
+		double seconds = now() - start - (sourceSeconds - sourceBefore);
+
+		if (!frame) {
+			fprintf(stderr, "harness: frame %d: %s\n", n, errorMsg);
+			vsapi->freeNode(node);
+			goto done;
+		}
+
+		hash = hashFrame(frame, hash, vsapi);
+
+		if (options->truth) {
+			scoreFrame(frame, n, options, &score, vsapi);
+		}
+
+		vsapi->freeFrame(frame);
+
+		minSeconds = seconds < minSeconds ? seconds : minSeconds;
+		maxSeconds = seconds > maxSeconds ? seconds : maxSeconds;
+		totalSeconds += seconds;
+		totalSource += sourceSeconds - sourceBefore;
+	}
+
+	vsapi->freeNode(node);
+
+	const MockStats *after = mockStats();
+	double frames = vi.numFrames;
+	double meanSeconds = totalSeconds / frames;
+
+	printf("%-8s %9.3f %9.3f %9.3f %9.3f %9.1f %9.1f %9.3f %8.2f %8.2f %8lld %8.1f %016llx\n",
+		threads ? threads : "-", createSeconds * 1e3, meanSeconds * 1e3, minSeconds * 1e3, maxSeconds * 1e3,
+		1 / meanSeconds, vi.width * (double)vi.height / meanSeconds * 1e-6, totalSource / frames * 1e3,
+		(after->framesAllocated - before.framesAllocated) / frames, (after->getFrameCalls - before.getFrameCalls) / frames,
+		(long long)after->peakFramesAlive, (after->bytesAllocated - before.bytesAllocated) / frames / (1 << 20),
+		(unsigned long long)hash);
+
+	if (options->truth) {
+		int64_t flagged = score.truePositives + score.falsePositives;
+		int64_t truth = score.truePositives + score.falseNegatives;
+
+		printf("%-8s %s ground truth: precision %.3f, recall %.3f (%lld flagged, %lld in the mask)\n", "", options->truth,
+			flagged ? score.truePositives / (double)flagged : 0, truth ? score.truePositives / (double)truth : 0,
+			(long long)flagged, (long long)truth);
+	}
+
+	ok = 1;
+
+done:
+	vsapi->freeMap(in);
+	vsapi->freeNode(src);
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	const VSAPI *vsapi = mockGetAPI();
+	Options options = { 1920, 1080, 100, NULL, orderSequential, NULL, NULL, NULL };
+	NtscParams ntsc;
+	const char *formatName = "yuv420p8";
+	int i = 1;
+
+	for (; i < argc && argv[i][0] == '-'; i += 2) {
+		if (i + 1 >= argc || argv[i][2]) {
+			usage();
+		}
+
+		const char *value = argv[i + 1];
+
+		switch (argv[i][1]) {
+		case 'w': options.width = atoi(value); break;
+		case 'h': options.height = atoi(value); break;
+		case 'f': formatName = value; break;
+		case 'n': options.numFrames = atoi(value); break;
+		case 'j': vsapi->setThreadCount(atoi(value), mockCore()); break;
+		case 't': options.threads = value; break;
+		case 's':
+			initNtscParams(&ntsc);
+
+			if (!strcmp(value, "ntsc") || !strcmp(value, "ntsc-comb")) {
+				ntsc.decoder = strcmp(value, "ntsc") ? ntscComb : ntscNotch;
+				options.ntsc = &ntsc;
+			}
+			else if (!strcmp(value, "pattern")) {
+				options.ntsc = NULL;
+			}
+			else {
+				usage();
+			}
+			break;
+		case 'm':
+			if (strcmp(value, "dotcrawl") && strcmp(value, "rainbow")) {
+				usage();
+			}
+			options.truth = value;
+			break;
+		case 'o':
+			if (!strcmp(value, "sequential")) {
+				options.order = orderSequential;
+			}
+			else if (!strcmp(value, "reverse")) {
+				options.order = orderReverse;
+			}
+			else if (!strcmp(value, "random")) {
+				options.order = orderRandom;
+			}
+			else {
+				usage();
+			}
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (argc - i < 2 || options.width <= 0 || options.height <= 0 || options.numFrames <= 0) {
+		usage();
+	}
+
+	if (options.truth && !options.ntsc) {
+		fprintf(stderr, "harness: -m needs an NTSC source\n");
+		return 2;
+	}
+
+	options.format = parseFormat(formatName, vsapi);
+
+	if (!options.format) {
+		fprintf(stderr, "harness: unsupported format %s\n", formatName);
+		return 2;
+	}
+
+	char errorMsg[1024];
+	VSPlugin *plugin = mockLoadPlugin(argv[i], errorMsg, sizeof(errorMsg));
+	const char *function = argv[i + 1];
+
+	if (!plugin) {
+		fprintf(stderr, "harness: %s\n", errorMsg);
+		return 1;
+	}
+
+	if (!mockFunctionArgs(plugin, function)) {
+		fprintf(stderr, "harness: %s has no function %s\n", mockPluginNamespace(plugin), function);
+		mockUnloadPlugin(plugin);
+		return 1;
+	}
+
+	printf("%s.%s, %dx%d %s, %d frames in %s order\n", mockPluginNamespace(plugin), function, options.width, options.height,
+		options.format->name, options.numFrames, options.order == orderSequential ? "sequential" : options.order == orderReverse ? "reverse" : "random");
+	printf("%-8s %9s %9s %9s %9s %9s %9s %9s %8s %8s %8s %8s %s\n", "threads", "create ms", "mean ms", "min ms", "max ms",
+		"fps", "Mpix/s", "source ms", "frames/f", "calls/f", "peak", "MiB/f", "output hash");
+
+	int ok = 1;
+
+	if (options.threads) {
+		// one run per value of the list
+		char list[256];
+		snprintf(list, sizeof(list), "%s", options.threads);
+
+		for (char *threads = strtok(list, ","); threads && ok; threads = strtok(NULL, ",")) {
+			ok = run(plugin, function, threads, argc - i - 2, argv + i + 2, &options, vsapi);
+		}
+	}
+	else {
+		ok = run(plugin, function, NULL, argc - i - 2, argv + i + 2, &options, vsapi);
+	}
+
+	const MockStats *stats = mockStats();
+
+	if (ok && stats->framesAlive) {
+		fprintf(stderr, "harness: %lld frames were never freed\n", (long long)stats->framesAlive);
+		ok = 0;
+	}
+
+	mockUnloadPlugin(plugin);
+	return ok ? 0 : 1;
+}
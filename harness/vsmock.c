@@ -0,0 +1,1200 @@
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsmock.h"
+
+#define MOCK_ALIGNMENT 64
+#define MOCK_MAX_FORMATS 64
+#define MOCK_FILL_BYTE 0xA5 // new planes are filled with it, so output hashes do not depend on stale memory
+
+typedef struct {
+	int64_t i;
+	double f;
+	char *data;
+	int size;
+	VSNodeRef *node;
+	const VSFrameRef *frame;
+	VSFuncRef *func;
+} MockValue;
+
+typedef struct {
+	char *key;
+	char type;
+	int count;
+	int capacity;
+	MockValue *values;
+
+	// contiguous copies handed out by propGetIntArray and propGetFloatArray
+	int64_t *ints;
+	double *floats;
+} MockProp;
+
+struct VSMap {
+	MockProp *props;
+	int count;
+	int capacity;
+	char *error;
+};
+
+struct VSFrameRef {
+	int refs;
+	const VSFormat *format;
+	int width[3];
+	int height[3];
+	int stride[3];
+	uint8_t *data[3];
+	VSMap *props;
+};
+
+struct VSNode {
+	int refs;
+	char name[64];
+	VSVideoInfo vi;
+	VSFilterGetFrame getFrame;
+	VSFilterFree free;
+	void *instanceData;
+};
+
+struct VSNodeRef {
+	VSNode *node;
+};
+
+struct VSFuncRef {
+	int refs;
+	VSPublicFunction func;
+	void *userData;
+	VSFreeFuncData free;
+};
+
+typedef struct {
+	VSNode *node;
+	int n;
+	const VSFrameRef *frame;
+} MockRequest;
+
+struct VSFrameContext {
+	VSNode *node;
+	MockRequest *requests;
+	int numRequests;
+	int capacity;
+	char *error;
+};
+
+typedef struct {
+	char *name;
+	char *args;
+	VSPublicFunction func;
+	void *functionData;
+} MockFunction;
+
+struct VSPlugin {
+	void *handle;
+	char identifier[128];
+	char ns[64];
+	char name[128];
+	MockFunction *functions;
+	int numFunctions;
+};
+
+struct VSCore {
+	VSCoreInfo info;
+	VSFormat formats[MOCK_MAX_FORMATS];
+	int numFormats;
+	MockStats stats;
+};
+
+typedef struct {
+	MockFillFunc fill;
+	void *userData;
+} SourceData;
+
+static VSCore core = { { "vsmock", 0, VAPOURSYNTH_API_VERSION, 1, 0, 0 } };
+static const VSAPI api;
+
+static void fatal(const char *msg) {
+	fprintf(stderr, "vsmock: %s\n", msg);
+	abort();
+}
+
+static void *checkedAlloc(void *p) {
+	if (!p) {
+		fatal("out of memory");
+	}
+
+	return p;
+}
+
+static char *copyString(const char *s) {
+	size_t size = strlen(s) + 1;
+	return memcpy(checkedAlloc(malloc(size)), s, size);
+}
+
+// Maps
+
+static VSMap *VS_CC createMap(void) {
+	return checkedAlloc(calloc(1, sizeof(VSMap)));
+}
+
+static void VS_CC freeNode(VSNodeRef *ref);
+static void VS_CC freeFrame(const VSFrameRef *cf);
+static void VS_CC freeFunc(VSFuncRef *f);
+
+static void freeProp(MockProp *prop) {
+	for (int i = 0; i < prop->count; i++) {
+		MockValue *v = &prop->values[i];
+
+		free(v->data);
+		freeNode(v->node);
+		freeFrame(v->frame);
+		freeFunc(v->func);
+	}
+
+	free(prop->values);
+	free(prop->ints);
+	free(prop->floats);
+	free(prop->key);
+}
+
+static void VS_CC clearMap(VSMap *map) {
+	for (int i = 0; i < map->count; i++) {
+		freeProp(&map->props[i]);
+	}
+
+	free(map->props);
+	free(map->error);
+	memset(map, 0, sizeof(VSMap));
+}
+
+static void VS_CC freeMap(VSMap *map) {
+	if (map) {
+		clearMap(map);
+		free(map);
+	}
+}
+
+static MockProp *findProp(const VSMap *map, const char *key) {
+	for (int i = 0; i < map->count; i++) {
+		if (!strcmp(map->props[i].key, key)) {
+			return &map->props[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void VS_CC setError(VSMap *map, const char *errorMessage) {
+	clearMap(map);
+	map->error = copyString(errorMessage ? errorMessage : "Error: no error specified");
+}
+
+static const char *VS_CC getError(const VSMap *map) {
+	return map->error;
+}
+
+static int VS_CC propNumKeys(const VSMap *map) {
+	return map->count;
+}
+
+static const char *VS_CC propGetKey(const VSMap *map, int index) {
+	if (index < 0 || index >= map->count) {
+		fatal("propGetKey: index out of bounds");
+	}
+
+	return map->props[index].key;
+}
+
+static int VS_CC propNumElements(const VSMap *map, const char *key) {
+	const MockProp *prop = findProp(map, key);
+	return prop ? prop->count : -1;
+}
+
+static char VS_CC propGetType(const VSMap *map, const char *key) {
+	const MockProp *prop = findProp(map, key);
+	return prop ? prop->type : ptUnset;
+}
+
+static int VS_CC propDeleteKey(VSMap *map, const char *key) {
+	MockProp *prop = findProp(map, key);
+
+	if (!prop) {
+		return 0;
+	}
+
+	freeProp(prop);
+	memmove(prop, prop + 1, (map->props + map->count - (prop + 1)) * sizeof(MockProp));
+	map->count--;
+	return 1;
+}
+
+// Returns the value to write for a set operation, or NULL when the key holds another type.
+static MockValue *setValue(VSMap *map, const char *key, char type, int append) {
+	MockProp *prop = findProp(map, key);
+
+	if (prop && append == paReplace) {
+		propDeleteKey(map, key);
+		prop = NULL;
+	}
+
+	if (prop && prop->type != type) {
+		return NULL;
+	}
+
+	if (!prop) {
+		if (map->count == map->capacity) {
+			map->capacity = map->capacity ? map->capacity * 2 : 8;
+			map->props = checkedAlloc(realloc(map->props, map->capacity * sizeof(MockProp)));
+		}
+
+		prop = &map->props[map->count++];
+		memset(prop, 0, sizeof(MockProp));
+		prop->key = copyString(key);
+		prop->type = type;
+	}
+
+	if (append == paTouch) {
+		return prop->values;
+	}
+
+	if (prop->count == prop->capacity) {
+		prop->capacity = prop->capacity ? prop->capacity * 2 : 4;
+		prop->values = checkedAlloc(realloc(prop->values, prop->capacity * sizeof(MockValue)));
+	}
+
+	memset(&prop->values[prop->count], 0, sizeof(MockValue));
+	return &prop->values[prop->count++];
+}
+
+// Reads of a missing value without an error pointer are fatal, as in the real core.
+static const MockValue *getValue(const VSMap *map, const char *key, int index, char type, int *error) {
+	const MockProp *prop = findProp(map, key);
+	int err = 0;
+
+	if (!prop) {
+		err = peUnset;
+	}
+	else if (prop->type != type) {
+		err = peType;
+	}
+	else if (index < 0 || index >= prop->count) {
+		err = peIndex;
+	}
+
+	if (err && !error) {
+		fprintf(stderr, "vsmock: property read of '%s' failed without an error pointer\n", key);
+		abort();
+	}
+
+	if (error) {
+		*error = err;
+	}
+
+	return err ? NULL : &prop->values[index];
+}
+
+static int64_t VS_CC propGetInt(const VSMap *map, const char *key, int index, int *error) {
+	const MockValue *v = getValue(map, key, index, ptInt, error);
+	return v ? v->i : 0;
+}
+
+static double VS_CC propGetFloat(const VSMap *map, const char *key, int index, int *error) {
+	const MockValue *v = getValue(map, key, index, ptFloat, error);
+	return v ? v->f : 0;
+}
+
+static const char *VS_CC propGetData(const VSMap *map, const char *key, int index, int *error) {
+	const MockValue *v = getValue(map, key, index, ptData, error);
+	return v ? v->data : NULL;
+}
+
+static int VS_CC propGetDataSize(const VSMap *map, const char *key, int index, int *error) {
+	const MockValue *v = getValue(map, key, index, ptData, error);
+	return v ? v->size : -1;
+}
+
+static VSNodeRef *VS_CC cloneNodeRef(VSNodeRef *node);
+static const VSFrameRef *VS_CC cloneFrameRef(const VSFrameRef *f);
+static VSFuncRef *VS_CC cloneFuncRef(VSFuncRef *f);
+
+static VSNodeRef *VS_CC propGetNode(const VSMap *map, const char *key, int index, int *error) {
+	const MockValue *v = getValue(map, key, index, ptNode, error);
+	return v ? cloneNodeRef(v->node) : NULL;
+}
+
+static const VSFrameRef *VS_CC propGetFrame(const VSMap *map, const char *key, int index, int *error) {
+	const MockValue *v = getValue(map, key, index, ptFrame, error);
+	return v ? cloneFrameRef(v->frame) : NULL;
+}
+
+static VSFuncRef *VS_CC propGetFunc(const VSMap *map, const char *key, int index, int *error) {
+	const MockValue *v = getValue(map, key, index, ptFunction, error);
+	return v ? cloneFuncRef(v->func) : NULL;
+}
+
+static const int64_t *VS_CC propGetIntArray(const VSMap *map, const char *key, int *error) {
+	MockProp *prop = findProp(map, key);
+
+	if (!getValue(map, key, 0, ptInt, error)) {
+		return NULL;
+	}
+
+	free(prop->ints);
+	prop->ints = checkedAlloc(malloc(prop->count * sizeof(int64_t)));
+
+	for (int i = 0; i < prop->count; i++) {
+		prop->ints[i] = prop->values[i].i;
+	}
+
+	return prop->ints;
+}
+
+static const double *VS_CC propGetFloatArray(const VSMap *map, const char *key, int *error) {
+	MockProp *prop = findProp(map, key);
+
+	if (!getValue(map, key, 0, ptFloat, error)) {
+		return NULL;
+	}
+
+	free(prop->floats);
+	prop->floats = checkedAlloc(malloc(prop->count * sizeof(double)));
+
+	for (int i = 0; i < prop->count; i++) {
+		prop->floats[i] = prop->values[i].f;
+	}
+
+	return prop->floats;
+}
+
+static int VS_CC propSetInt(VSMap *map, const char *key, int64_t i, int append) {
+	MockValue *v = setValue(map, key, ptInt, append);
+
+	if (!v) {
+		return 1;
+	}
+	if (append != paTouch) {
+		v->i = i;
+	}
+
+	return 0;
+}
+
+static int VS_CC propSetFloat(VSMap *map, const char *key, double d, int append) {
+	MockValue *v = setValue(map, key, ptFloat, append);
+
+	if (!v) {
+		return 1;
+	}
+	if (append != paTouch) {
+		v->f = d;
+	}
+
+	return 0;
+}
+
+static int VS_CC propSetData(VSMap *map, const char *key, const char *data, int size, int append) {
+	MockValue *v = setValue(map, key, ptData, append);
+
+	if (!v) {
+		return 1;
+	}
+	if (append != paTouch) {
+		if (size < 0) {
+			size = (int)strlen(data);
+		}
+
+		v->data = checkedAlloc(malloc(size + 1));
+		memcpy(v->data, data, size);
+		v->data[size] = 0;
+		v->size = size;
+	}
+
+	return 0;
+}
+
+static int VS_CC propSetNode(VSMap *map, const char *key, VSNodeRef *node, int append) {
+	MockValue *v = setValue(map, key, ptNode, append);
+
+	if (!v) {
+		return 1;
+	}
+	if (append != paTouch) {
+		v->node = cloneNodeRef(node);
+	}
+
+	return 0;
+}
+
+static int VS_CC propSetFrame(VSMap *map, const char *key, const VSFrameRef *f, int append) {
+	MockValue *v = setValue(map, key, ptFrame, append);
+
+	if (!v) {
+		return 1;
+	}
+	if (append != paTouch) {
+		v->frame = cloneFrameRef(f);
+	}
+
+	return 0;
+}
+
+static int VS_CC propSetFunc(VSMap *map, const char *key, VSFuncRef *func, int append) {
+	MockValue *v = setValue(map, key, ptFunction, append);
+
+	if (!v) {
+		return 1;
+	}
+	if (append != paTouch) {
+		v->func = cloneFuncRef(func);
+	}
+
+	return 0;
+}
+
+static int VS_CC propSetIntArray(VSMap *map, const char *key, const int64_t *i, int size) {
+	propDeleteKey(map, key);
+
+	for (int j = 0; j < size; j++) {
+		propSetInt(map, key, i[j], paAppend);
+	}
+
+	return 0;
+}
+
+static int VS_CC propSetFloatArray(VSMap *map, const char *key, const double *d, int size) {
+	propDeleteKey(map, key);
+
+	for (int j = 0; j < size; j++) {
+		propSetFloat(map, key, d[j], paAppend);
+	}
+
+	return 0;
+}
+
+static void copyMap(const VSMap *src, VSMap *dst) {
+	clearMap(dst);
+
+	for (int i = 0; i < src->count; i++) {
+		const MockProp *prop = &src->props[i];
+
+		for (int j = 0; j < prop->count; j++) {
+			const MockValue *v = &prop->values[j];
+
+			switch (prop->type) {
+			case ptInt: propSetInt(dst, prop->key, v->i, paAppend); break;
+			case ptFloat: propSetFloat(dst, prop->key, v->f, paAppend); break;
+			case ptData: propSetData(dst, prop->key, v->data, v->size, paAppend); break;
+			case ptNode: propSetNode(dst, prop->key, v->node, paAppend); break;
+			case ptFrame: propSetFrame(dst, prop->key, v->frame, paAppend); break;
+			case ptFunction: propSetFunc(dst, prop->key, v->func, paAppend); break;
+			}
+		}
+	}
+}
+
+// Formats
+
+typedef struct {
+	int id;
+	int colorFamily;
+	int bitsPerSample;
+	int subSamplingW;
+	int subSamplingH;
+} MockPreset;
+
+// Registered formats matching a preset carry the id of the preset, as in the real core.
+static const MockPreset presets[] = {
+	{ pfGray8, cmGray, 8, 0, 0 },
+	{ pfGray16, cmGray, 16, 0, 0 },
+	{ pfYUV420P8, cmYUV, 8, 1, 1 },
+	{ pfYUV422P8, cmYUV, 8, 1, 0 },
+	{ pfYUV444P8, cmYUV, 8, 0, 0 },
+	{ pfYUV410P8, cmYUV, 8, 2, 2 },
+	{ pfYUV411P8, cmYUV, 8, 2, 0 },
+	{ pfYUV440P8, cmYUV, 8, 0, 1 },
+	{ pfYUV420P9, cmYUV, 9, 1, 1 },
+	{ pfYUV422P9, cmYUV, 9, 1, 0 },
+	{ pfYUV444P9, cmYUV, 9, 0, 0 },
+	{ pfYUV420P10, cmYUV, 10, 1, 1 },
+	{ pfYUV422P10, cmYUV, 10, 1, 0 },
+	{ pfYUV444P10, cmYUV, 10, 0, 0 },
+	{ pfYUV420P16, cmYUV, 16, 1, 1 },
+	{ pfYUV422P16, cmYUV, 16, 1, 0 },
+	{ pfYUV444P16, cmYUV, 16, 0, 0 },
+	{ pfRGB24, cmRGB, 8, 0, 0 },
+	{ pfRGB27, cmRGB, 9, 0, 0 },
+	{ pfRGB30, cmRGB, 10, 0, 0 },
+	{ pfRGB48, cmRGB, 16, 0, 0 },
+};
+
+static const VSFormat *VS_CC registerFormat(int colorFamily, int sampleType, int bitsPerSample, int subSamplingW, int subSamplingH, VSCore *c) {
+	static const char *families[] = { "Gray", "RGB", "YUV", "YCoCg" };
+
+	for (int i = 0; i < core.numFormats; i++) {
+		const VSFormat *f = &core.formats[i];
+
+		if (f->colorFamily == colorFamily && f->sampleType == sampleType && f->bitsPerSample == bitsPerSample
+			&& f->subSamplingW == subSamplingW && f->subSamplingH == subSamplingH) {
+			return f;
+		}
+	}
+
+	if (core.numFormats == MOCK_MAX_FORMATS || colorFamily < cmGray || colorFamily > cmYCoCg
+		|| bitsPerSample < 8 || bitsPerSample > 32 || subSamplingW < 0 || subSamplingW > 4 || subSamplingH < 0 || subSamplingH > 4) {
+		return NULL;
+	}
+
+	if ((colorFamily == cmGray || colorFamily == cmRGB) && (subSamplingW || subSamplingH)) {
+		return NULL;
+	}
+
+	VSFormat *f = &core.formats[core.numFormats];
+	memset(f, 0, sizeof(VSFormat));
+	f->id = colorFamily + 1000 + core.numFormats;
+	f->colorFamily = colorFamily;
+	f->sampleType = sampleType;
+	f->bitsPerSample = bitsPerSample;
+	f->bytesPerSample = bitsPerSample <= 8 ? 1 : bitsPerSample <= 16 ? 2 : 4;
+	f->subSamplingW = subSamplingW;
+	f->subSamplingH = subSamplingH;
+	f->numPlanes = colorFamily == cmGray ? 1 : 3;
+	snprintf(f->name, sizeof(f->name), "%s%s%d_%d%d", families[colorFamily / 1000000 - 1],
+		sampleType == stFloat ? "S" : "P", bitsPerSample, subSamplingW, subSamplingH);
+
+	for (size_t i = 0; i < sizeof presets / sizeof *presets; i++) {
+		const MockPreset *p = &presets[i];
+
+		if (sampleType == stInteger && p->colorFamily == colorFamily && p->bitsPerSample == bitsPerSample
+			&& p->subSamplingW == subSamplingW && p->subSamplingH == subSamplingH) {
+			f->id = p->id;
+		}
+	}
+
+	core.numFormats++;
+	return f;
+}
+
+static const VSFormat *VS_CC getFormatPreset(int id, VSCore *c) {
+	for (size_t i = 0; i < sizeof presets / sizeof *presets; i++) {
+		const MockPreset *p = &presets[i];
+
+		if (p->id == id) {
+			return registerFormat(p->colorFamily, stInteger, p->bitsPerSample, p->subSamplingW, p->subSamplingH, c);
+		}
+	}
+
+	return NULL;
+}
+
+// Frames
+
+static VSFrameRef *VS_CC newVideoFrame(const VSFormat *format, int width, int height, const VSFrameRef *propSrc, VSCore *c) {
+	if (!format || width <= 0 || height <= 0) {
+		fatal("newVideoFrame: invalid format or dimensions");
+	}
+
+	VSFrameRef *f = checkedAlloc(calloc(1, sizeof(VSFrameRef)));
+	f->refs = 1;
+	f->format = format;
+	f->props = createMap();
+
+	for (int plane = 0; plane < format->numPlanes; plane++) {
+		f->width[plane] = plane ? width >> format->subSamplingW : width;
+		f->height[plane] = plane ? height >> format->subSamplingH : height;
+		f->stride[plane] = (f->width[plane] * format->bytesPerSample + MOCK_ALIGNMENT - 1) & ~(MOCK_ALIGNMENT - 1);
+
+		size_t size = (size_t)f->stride[plane] * f->height[plane];
+
+		if (posix_memalign((void **)&f->data[plane], MOCK_ALIGNMENT, size)) {
+			fatal("out of memory");
+		}
+
+		memset(f->data[plane], MOCK_FILL_BYTE, size);
+		core.stats.bytesAllocated += size;
+	}
+
+	if (propSrc) {
+		copyMap(propSrc->props, f->props);
+	}
+
+	core.stats.framesAllocated++;
+	core.stats.framesAlive++;
+
+	if (core.stats.framesAlive > core.stats.peakFramesAlive) {
+		core.stats.peakFramesAlive = core.stats.framesAlive;
+	}
+
+	return f;
+}
+
+static void copyPlane(const VSFrameRef *src, int srcPlane, VSFrameRef *dst, int dstPlane) {
+	int rowSize = dst->width[dstPlane] * dst->format->bytesPerSample;
+
+	for (int y = 0; y < dst->height[dstPlane]; y++) {
+		memcpy(dst->data[dstPlane] + y * dst->stride[dstPlane], src->data[srcPlane] + y * src->stride[srcPlane], rowSize);
+	}
+}
+
+static VSFrameRef *VS_CC newVideoFrame2(const VSFormat *format, int width, int height, const VSFrameRef **planeSrc, const int *planes, const VSFrameRef *propSrc, VSCore *c) {
+	VSFrameRef *f = newVideoFrame(format, width, height, propSrc, c);
+
+	for (int plane = 0; plane < format->numPlanes; plane++) {
+		if (planeSrc[plane]) {
+			copyPlane(planeSrc[plane], planes[plane], f, plane);
+		}
+	}
+
+	return f;
+}
+
+static VSFrameRef *VS_CC copyFrame(const VSFrameRef *src, VSCore *c) {
+	VSFrameRef *f = newVideoFrame(src->format, src->width[0], src->height[0], src, c);
+
+	for (int plane = 0; plane < src->format->numPlanes; plane++) {
+		copyPlane(src, plane, f, plane);
+	}
+
+	return f;
+}
+
+static void VS_CC copyFrameProps(const VSFrameRef *src, VSFrameRef *dst, VSCore *c) {
+	copyMap(src->props, dst->props);
+}
+
+static const VSFrameRef *VS_CC cloneFrameRef(const VSFrameRef *f) {
+	((VSFrameRef *)f)->refs++;
+	return f;
+}
+
+static void VS_CC freeFrame(const VSFrameRef *cf) {
+	VSFrameRef *f = (VSFrameRef *)cf;
+
+	if (!f || --f->refs > 0) {
+		return;
+	}
+
+	for (int plane = 0; plane < 3; plane++) {
+		free(f->data[plane]);
+	}
+
+	freeMap(f->props);
+	free(f);
+	core.stats.framesFreed++;
+	core.stats.framesAlive--;
+}
+
+static int VS_CC getStride(const VSFrameRef *f, int plane) {
+	return f->stride[plane];
+}
+
+static const uint8_t *VS_CC getReadPtr(const VSFrameRef *f, int plane) {
+	return f->data[plane];
+}
+
+// Writing to a frame that is referenced elsewhere is a bug in the filter.
+static uint8_t *VS_CC getWritePtr(VSFrameRef *f, int plane) {
+	if (f->refs != 1) {
+		fatal("getWritePtr: frame is shared");
+	}
+
+	return f->data[plane];
+}
+
+static const VSFormat *VS_CC getFrameFormat(const VSFrameRef *f) {
+	return f->format;
+}
+
+static int VS_CC getFrameWidth(const VSFrameRef *f, int plane) {
+	return f->width[plane];
+}
+
+static int VS_CC getFrameHeight(const VSFrameRef *f, int plane) {
+	return f->height[plane];
+}
+
+static const VSMap *VS_CC getFramePropsRO(const VSFrameRef *f) {
+	return f->props;
+}
+
+static VSMap *VS_CC getFramePropsRW(VSFrameRef *f) {
+	return f->props;
+}
+
+// Nodes
+
+static VSNodeRef *newNodeRef(VSNode *node) {
+	VSNodeRef *ref = checkedAlloc(malloc(sizeof(VSNodeRef)));
+	ref->node = node;
+	node->refs++;
+	return ref;
+}
+
+static VSNodeRef *VS_CC cloneNodeRef(VSNodeRef *node) {
+	return newNodeRef(node->node);
+}
+
+static void VS_CC freeNode(VSNodeRef *ref) {
+	if (!ref) {
+		return;
+	}
+
+	VSNode *node = ref->node;
+	free(ref);
+
+	if (--node->refs > 0) {
+		return;
+	}
+
+	if (node->free) {
+		node->free(node->instanceData, &core, &api);
+	}
+
+	free(node);
+}
+
+static const VSVideoInfo *VS_CC getVideoInfo(VSNodeRef *node) {
+	return &node->node->vi;
+}
+
+static void VS_CC setVideoInfo(const VSVideoInfo *vi, int numOutputs, VSNode *node) {
+	if (numOutputs != 1) {
+		fatal("setVideoInfo: only single output filters are supported");
+	}
+
+	node->vi = *vi;
+}
+
+static void VS_CC createFilter(const VSMap *in, VSMap *out, const char *name, VSFilterInit init, VSFilterGetFrame getFrame, VSFilterFree free, int filterMode, int flags, void *instanceData, VSCore *c) {
+	VSNode *node = checkedAlloc(calloc(1, sizeof(VSNode)));
+
+	snprintf(node->name, sizeof(node->name), "%s", name);
+	node->getFrame = getFrame;
+	node->free = free;
+	node->instanceData = instanceData;
+
+	VSNodeRef *ref = newNodeRef(node);
+	init((VSMap *)in, out, &node->instanceData, node, &core, &api);
+
+	if (out->error || !node->vi.format || node->vi.numFrames <= 0) {
+		if (!out->error) {
+			setError(out, "Filter init did not set a constant format and length");
+		}
+
+		freeNode(ref);
+		return;
+	}
+
+	propSetNode(out, "clip", ref, paAppend);
+	freeNode(ref);
+}
+
+// Frame requests
+
+// Requests past either end of a clip return its first or last frame, as in the real core.
+static int clampFrame(const VSNode *node, int n) {
+	return n < 0 ? 0 : n >= node->vi.numFrames ? node->vi.numFrames - 1 : n;
+}
+
+static void VS_CC requestFrameFilter(int n, VSNodeRef *node, VSFrameContext *ctx) {
+	if (ctx->numRequests == ctx->capacity) {
+		ctx->capacity = ctx->capacity ? ctx->capacity * 2 : 4;
+		ctx->requests = checkedAlloc(realloc(ctx->requests, ctx->capacity * sizeof(MockRequest)));
+	}
+
+	MockRequest *r = &ctx->requests[ctx->numRequests++];
+	r->node = node->node;
+	r->n = clampFrame(node->node, n);
+	r->frame = NULL;
+	core.stats.requests++;
+}
+
+// Only frames requested in arInitial are available.
+static const VSFrameRef *VS_CC getFrameFilter(int n, VSNodeRef *node, VSFrameContext *ctx) {
+	n = clampFrame(node->node, n);
+
+	for (int i = 0; i < ctx->numRequests; i++) {
+		if (ctx->requests[i].node == node->node && ctx->requests[i].n == n && ctx->requests[i].frame) {
+			return cloneFrameRef(ctx->requests[i].frame);
+		}
+	}
+
+	return NULL;
+}
+
+static void VS_CC setFilterError(const char *errorMessage, VSFrameContext *ctx) {
+	free(ctx->error);
+	ctx->error = copyString(errorMessage);
+}
+
+static void VS_CC queryCompletedFrame(VSNodeRef **node, int *n, VSFrameContext *ctx) {
+	*node = NULL;
+	*n = -1;
+}
+
+static void VS_CC releaseFrameEarly(VSNodeRef *node, int n, VSFrameContext *ctx) {
+}
+
+static int VS_CC getOutputIndex(VSFrameContext *ctx) {
+	return 0;
+}
+
+// Produce frame n of a node: call it with arInitial, produce every frame it requested, then call it
+// again with arAllFramesReady. Filters that return a frame from arInitial are done in one call.
+static const VSFrameRef *produceFrame(VSNode *node, int n, char *errorMsg, int bufSize) {
+	VSFrameContext ctx;
+	void *frameData = NULL;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.node = node;
+
+	core.stats.getFrameCalls++;
+	const VSFrameRef *f = node->getFrame(n, arInitial, &node->instanceData, &frameData, &ctx, &core, &api);
+
+	if (!f && !ctx.error && ctx.numRequests) {
+		for (int i = 0; i < ctx.numRequests; i++) {
+			ctx.requests[i].frame = produceFrame(ctx.requests[i].node, ctx.requests[i].n, errorMsg, bufSize);
+
+			if (!ctx.requests[i].frame) {
+				ctx.error = copyString(errorMsg);
+				break;
+			}
+		}
+
+		if (!ctx.error) {
+			core.stats.getFrameCalls++;
+			f = node->getFrame(n, arAllFramesReady, &node->instanceData, &frameData, &ctx, &core, &api);
+		}
+	}
+
+	if (!f && !ctx.error) {
+		ctx.error = copyString("Filter returned no frame");
+	}
+
+	if (ctx.error) {
+		node->getFrame(n, arError, &node->instanceData, &frameData, &ctx, &core, &api);
+
+		if (errorMsg && bufSize > 0) {
+			snprintf(errorMsg, bufSize, "%s: %s", node->name, ctx.error);
+		}
+
+		freeFrame(f);
+		f = NULL;
+	}
+
+	for (int i = 0; i < ctx.numRequests; i++) {
+		freeFrame(ctx.requests[i].frame);
+	}
+
+	free(ctx.requests);
+	free(ctx.error);
+	return f;
+}
+
+static const VSFrameRef *VS_CC getFrame(int n, VSNodeRef *node, char *errorMsg, int bufSize) {
+	if (n < 0 || n >= node->node->vi.numFrames) {
+		if (errorMsg && bufSize > 0) {
+			snprintf(errorMsg, bufSize, "Requested frame %d is out of range", n);
+		}
+
+		return NULL;
+	}
+
+	return produceFrame(node->node, n, errorMsg, bufSize);
+}
+
+// Functions
+
+static VSFuncRef *VS_CC createFunc(VSPublicFunction func, void *userData, VSFreeFuncData free, VSCore *c, const VSAPI *vsapi) {
+	VSFuncRef *f = checkedAlloc(malloc(sizeof(VSFuncRef)));
+	f->refs = 1;
+	f->func = func;
+	f->userData = userData;
+	f->free = free;
+	return f;
+}
+
+static VSFuncRef *VS_CC cloneFuncRef(VSFuncRef *f) {
+	f->refs++;
+	return f;
+}
+
+static void VS_CC freeFunc(VSFuncRef *f) {
+	if (!f || --f->refs > 0) {
+		return;
+	}
+
+	if (f->free) {
+		f->free(f->userData);
+	}
+
+	free(f);
+}
+
+static void VS_CC callFunc(VSFuncRef *func, const VSMap *in, VSMap *out, VSCore *c, const VSAPI *vsapi) {
+	func->func(in, out, func->userData, &core, &api);
+}
+
+// Plugins
+
+static void VS_CC configPlugin(const char *identifier, const char *defaultNamespace, const char *name, int apiVersion, int readonly, VSPlugin *plugin) {
+	snprintf(plugin->identifier, sizeof(plugin->identifier), "%s", identifier);
+	snprintf(plugin->ns, sizeof(plugin->ns), "%s", defaultNamespace);
+	snprintf(plugin->name, sizeof(plugin->name), "%s", name);
+}
+
+static void VS_CC registerFunction(const char *name, const char *args, VSPublicFunction argsFunc, void *functionData, VSPlugin *plugin) {
+	plugin->functions = checkedAlloc(realloc(plugin->functions, (plugin->numFunctions + 1) * sizeof(MockFunction)));
+
+	MockFunction *f = &plugin->functions[plugin->numFunctions++];
+	f->name = copyString(name);
+	f->args = copyString(args);
+	f->func = argsFunc;
+	f->functionData = functionData;
+}
+
+static const MockFunction *findFunction(const VSPlugin *plugin, const char *name) {
+	for (int i = 0; i < plugin->numFunctions; i++) {
+		if (!strcmp(plugin->functions[i].name, name)) {
+			return &plugin->functions[i];
+		}
+	}
+
+	return NULL;
+}
+
+// Arguments are passed as is: unlike the real core, the mock does not check them against the registered types.
+static VSMap *VS_CC invoke(VSPlugin *plugin, const char *name, const VSMap *args) {
+	VSMap *out = createMap();
+	const MockFunction *f = findFunction(plugin, name);
+
+	if (f) {
+		f->func(args, out, f->functionData, &core, &api);
+	}
+	else {
+		setError(out, "Function not found");
+	}
+
+	return out;
+}
+
+static VSMap *VS_CC getFunctions(VSPlugin *plugin) {
+	VSMap *out = createMap();
+
+	for (int i = 0; i < plugin->numFunctions; i++) {
+		char signature[1024];
+		snprintf(signature, sizeof(signature), "%s;%s", plugin->functions[i].name, plugin->functions[i].args);
+		propSetData(out, plugin->functions[i].name, signature, -1, paReplace);
+	}
+
+	return out;
+}
+
+VSPlugin *mockLoadPlugin(const char *path, char *errorMsg, int bufSize) {
+	void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	VSInitPlugin initPlugin;
+
+	if (!handle) {
+		snprintf(errorMsg, bufSize, "%s", dlerror());
+		return NULL;
+	}
+
+	*(void **)&initPlugin = dlsym(handle, "VapourSynthPluginInit");
+
+	if (!initPlugin) {
+		snprintf(errorMsg, bufSize, "%s: no VapourSynthPluginInit", path);
+		dlclose(handle);
+		return NULL;
+	}
+
+	VSPlugin *plugin = checkedAlloc(calloc(1, sizeof(VSPlugin)));
+	plugin->handle = handle;
+	initPlugin(configPlugin, registerFunction, plugin);
+
+	return plugin;
+}
+
+void mockUnloadPlugin(VSPlugin *plugin) {
+	for (int i = 0; i < plugin->numFunctions; i++) {
+		free(plugin->functions[i].name);
+		free(plugin->functions[i].args);
+	}
+
+	free(plugin->functions);
+	dlclose(plugin->handle);
+	free(plugin);
+}
+
+const char *mockPluginNamespace(const VSPlugin *plugin) {
+	return plugin->ns;
+}
+
+const char *mockFunctionArgs(const VSPlugin *plugin, const char *name) {
+	const MockFunction *f = findFunction(plugin, name);
+	return f ? f->args : NULL;
+}
+
+// Source clips
+
+static const VSFrameRef *VS_CC sourceGetFrame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *c, const VSAPI *vsapi) {
+	SourceData *d = (SourceData *)* instanceData;
+	const VSVideoInfo *vi = &frameCtx->node->vi;
+
+	if (activationReason != arInitial) {
+		return NULL;
+	}
+
+	VSFrameRef *f = newVideoFrame(vi->format, vi->width, vi->height, NULL, c);
+
+	if (d->fill) {
+		d->fill(f, n, d->userData, vsapi);
+	}
+
+	return f;
+}
+
+static void VS_CC sourceFree(void *instanceData, VSCore *c, const VSAPI *vsapi) {
+	free(instanceData);
+}
+
+VSNodeRef *mockSourceClip(const VSFormat *format, int width, int height, int numFrames, MockFillFunc fill, void *userData) {
+	VSNode *node = checkedAlloc(calloc(1, sizeof(VSNode)));
+	SourceData *d = checkedAlloc(malloc(sizeof(SourceData)));
+
+	d->fill = fill;
+	d->userData = userData;
+
+	snprintf(node->name, sizeof(node->name), "MockSource");
+	node->vi.format = format;
+	node->vi.fpsNum = 30000;
+	node->vi.fpsDen = 1001;
+	node->vi.width = width;
+	node->vi.height = height;
+	node->vi.numFrames = numFrames;
+	node->getFrame = sourceGetFrame;
+	node->free = sourceFree;
+	node->instanceData = d;
+
+	return newNodeRef(node);
+}
+
+// Core
+
+static VSCore *VS_CC createCore(int threads) {
+	if (threads > 0) {
+		core.info.numThreads = threads;
+	}
+
+	return &core;
+}
+
+static void VS_CC freeCore(VSCore *c) {
+}
+
+static const VSCoreInfo *VS_CC getCoreInfo(VSCore *c) {
+	return &core.info;
+}
+
+static void VS_CC logMessage(int msgType, const char *msg) {
+	fprintf(stderr, "vsmock [%d]: %s\n", msgType, msg);
+}
+
+static void VS_CC setMessageHandler(VSMessageHandler handler, void *userData) {
+}
+
+// The thread count is only reported to filters through getCoreInfo: frames are still produced on the calling thread.
+static int VS_CC setThreadCount(int threads, VSCore *c) {
+	core.info.numThreads = threads > 0 ? threads : 1;
+	return core.info.numThreads;
+}
+
+static int64_t VS_CC setMaxCacheSize(int64_t bytes, VSCore *c) {
+	return bytes;
+}
+
+static const VSAPI api = {
+	createCore,
+	freeCore,
+	getCoreInfo,
+	cloneFrameRef,
+	cloneNodeRef,
+	cloneFuncRef,
+	freeFrame,
+	freeNode,
+	freeFunc,
+	newVideoFrame,
+	copyFrame,
+	copyFrameProps,
+	registerFunction,
+	NULL, // getPluginById
+	NULL, // getPluginByNs
+	NULL, // getPlugins
+	getFunctions,
+	createFilter,
+	setError,
+	getError,
+	setFilterError,
+	invoke,
+	getFormatPreset,
+	registerFormat,
+	getFrame,
+	NULL, // getFrameAsync
+	getFrameFilter,
+	requestFrameFilter,
+	queryCompletedFrame,
+	releaseFrameEarly,
+	getStride,
+	getReadPtr,
+	getWritePtr,
+	createFunc,
+	callFunc,
+	createMap,
+	freeMap,
+	clearMap,
+	getVideoInfo,
+	setVideoInfo,
+	getFrameFormat,
+	getFrameWidth,
+	getFrameHeight,
+	getFramePropsRO,
+	getFramePropsRW,
+	propNumKeys,
+	propGetKey,
+	propNumElements,
+	propGetType,
+	propGetInt,
+	propGetFloat,
+	propGetData,
+	propGetDataSize,
+	propGetNode,
+	propGetFrame,
+	propGetFunc,
+	propDeleteKey,
+	propSetInt,
+	propSetFloat,
+	propSetData,
+	propSetNode,
+	propSetFrame,
+	propSetFunc,
+	setMaxCacheSize,
+	getOutputIndex,
+	newVideoFrame2,
+	setMessageHandler,
+	setThreadCount,
+	NULL, // getPluginPath
+	propGetIntArray,
+	propGetFloatArray,
+	propSetIntArray,
+	propSetFloatArray,
+	logMessage,
+};
+
+const VSAPI *mockGetAPI(void) {
+	return &api;
+}
+
+VSCore *mockCore(void) {
+	return &core;
+}
+
+MockStats *mockStats(void) {
+	return &core.stats;
+}
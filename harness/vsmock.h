@@ -0,0 +1,42 @@
+#ifndef UNCROSS_VSMOCK_H
+#define UNCROSS_VSMOCK_H
+
+#include <stdint.h>
+#include <VapourSynth.h>
+
+// An in-process stand-in for the VSAPI function table, enough to load the plugins of this repository
+// and render their filters without a VapourSynth installation. Frames are produced synchronously on the
+// calling thread: arInitial records the requests of a filter, every requested frame is produced
+// recursively, then the filter is called again with arAllFramesReady. There is no frame cache, so a
+// frame requested by two consumers is produced twice.
+
+// Counters of everything the mock allocated or did since it was loaded.
+typedef struct {
+	int64_t framesAllocated;
+	int64_t framesFreed;
+	int64_t framesAlive;
+	int64_t peakFramesAlive;
+	int64_t bytesAllocated; // frame planes only
+	int64_t getFrameCalls; // calls of filter getFrame functions, all activation reasons included
+	int64_t requests; // frames requested with requestFrameFilter
+} MockStats;
+
+// Fills the planes of frame n of a source clip.
+typedef void (*MockFillFunc)(VSFrameRef *frame, int n, void *userData, const VSAPI *vsapi);
+
+const VSAPI *mockGetAPI(void);
+VSCore *mockCore(void);
+MockStats *mockStats(void);
+
+// Load a plugin and run its VapourSynthPluginInit. Returns NULL and sets errorMsg on failure.
+VSPlugin *mockLoadPlugin(const char *path, char *errorMsg, int bufSize);
+void mockUnloadPlugin(VSPlugin *plugin);
+
+// The namespace of a loaded plugin, and the argument string a function was registered with (NULL if not found).
+const char *mockPluginNamespace(const VSPlugin *plugin);
+const char *mockFunctionArgs(const VSPlugin *plugin, const char *name);
+
+// Create a clip of numFrames frames whose planes are written by fill when requested.
+VSNodeRef *mockSourceClip(const VSFormat *format, int width, int height, int numFrames, MockFillFunc fill, void *userData);
+
+#endif
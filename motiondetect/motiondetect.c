@@ -1,14 +1,31 @@
 #include <stdlib.h>
+#include <string.h>
 #include <VapourSynth.h>
 #include <VSHelper.h>
+#include "blend.h"
+#include "cpu.h"
+#include "motion.h"
+#include "packed.h"
+#include "profile.h"
+#include "threadpool.h"
+#include "trace.h"
 
 typedef struct {
 	VSNodeRef *node;
+	VSNodeRef *mask; // Blend: the motion mask, NULL to gate on the vectors of a search of its own
 	const VSVideoInfo *vi;
+	VSVideoInfo outVi; // vi with the mask format, or the input format when showing frames
 
 	int compensate;
 	int threshold;
 	int show; // whether to show the processed frame or just the mask
+
+	MotionSearch search;
+	CompensationErrorRowFunc errorRow;
+	PackMaskRowFunc packMaskRow; // NULL unless packed=1
+	TemporalBlendRowFunc blendRow; // NULL unless Blend
+	ThreadPool *pool; // NULL when frames are processed on a single thread
+	Profile *profile; // NULL unless profile=1
 } MotionData;
 
 // This function is called immediately after vsapi->createFilter(). This is the only place where the video
@@ -16,81 +33,269 @@ typedef struct {
 // of VSVideoInfo if the filter has more than one output, like rgb+alpha as two separate clips.
 static void VS_CC init(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
 	MotionData *d = (MotionData *)* instanceData;
-	vsapi->setVideoInfo(d->vi, 1, node);
+	vsapi->setVideoInfo(&d->outVi, 1, node);
 }
 
-// Read plane data into a matrix.
-static int **readPlaneMatrix(const VSFrameRef *frame, int plane, const VSAPI *vsapi) {
-	int height = vsapi->getFrameHeight(frame, plane);
-	int width = vsapi->getFrameWidth(frame, plane);
-
-	// Allocate destination matrix.
-	int **planeData = malloc(height * sizeof *planeData);
-
-	for (int i = 0; i < height; i++) {
-		planeData[i] = malloc(width * sizeof *planeData[i]);
+// The luma planes and vectors shared by the stripes of one frame.
+typedef struct {
+	const uint8_t *srcp;
+	int stride;
+	const uint8_t *refp;
+	int refStride;
+	uint8_t *dstp;
+	int dstStride;
+	int width;
+	int height;
+	MotionVector *vectors;
+	const MotionData *context;
+} MotionJob;
+
+// Search the rows of blocks starting in rows [start, end). Stripes are whole rows of blocks, and
+// candidates are read from the whole reference plane, so stripes match a single pass.
+static void estimateMotionStripe(void *userData, int start, int end) {
+	int64_t begin = traceClock();
+	const MotionJob *job = (const MotionJob *)userData;
+	int blockSize = job->context->search.blockSize;
+	int blocksX = (job->width + blockSize - 1) / blockSize;
+
+	for (int by = start; by < end; by += blockSize) {
+		estimateMotionRow(job->srcp, job->stride, job->refp, job->refStride, job->width, job->height, by,
+			job->vectors + (by / blockSize) * blocksX, &job->context->search);
 	}
 
-	// Read the frame data into the matrix.
-	const uint8_t *srcp = vsapi->getReadPtr(frame, plane);
-	int stride = vsapi->getStride(frame, plane);
+	traceEvent("kernel", "estimateMotionStripe", "row", start, begin);
+}
+
+// Find the best vector of every block of the luma plane in the previous frame.
+// Blocks are stored in raster order; partial blocks at the right and bottom edges are included.
+void estimateMotion(const VSFrameRef *frame, const VSFrameRef *pre, MotionVector *vectors, MotionData *context, const VSAPI *vsapi) {
+	int plane = 0; // Y plane index assuming YUV or YIQ input
+	MotionJob job;
+
+	job.srcp = vsapi->getReadPtr(frame, plane);
+	job.stride = vsapi->getStride(frame, plane);
+	job.refp = vsapi->getReadPtr(pre, plane);
+	job.refStride = vsapi->getStride(pre, plane);
+	job.width = vsapi->getFrameWidth(frame, plane);
+	job.height = vsapi->getFrameHeight(frame, plane);
+	job.vectors = vectors;
+	job.context = context;
+
+	runStripes(context->pool, job.height, context->search.blockSize, estimateMotionStripe, &job);
+}
 
+// Fill a rectangle of a plane with a constant value.
+static void fillRect(uint8_t *dstp, int stride, int width, int height, uint8_t value) {
 	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			planeData[y][x] = srcp[x];
+		memset(dstp, value, width);
+		dstp += stride;
+	}
+}
+
+// Write the motion compensated frame: every block of every plane is copied from the previous frame.
+void compensateFrame(const VSFrameRef *pre, const MotionVector *vectors, VSFrameRef *dst, MotionData *context, const VSAPI *vsapi) {
+	const VSFormat *fi = vsapi->getFrameFormat(dst);
+	int blockSize = context->search.blockSize;
+	int blocksX = (vsapi->getFrameWidth(dst, 0) + blockSize - 1) / blockSize;
+
+	for (int plane = 0; plane < fi->numPlanes; plane++) {
+		int ssW = plane ? fi->subSamplingW : 0;
+		int ssH = plane ? fi->subSamplingH : 0;
+		int height = vsapi->getFrameHeight(dst, plane);
+		int width = vsapi->getFrameWidth(dst, plane);
+		int blockWidth = blockSize >> ssW;
+		int blockHeight = blockSize >> ssH;
+
+		const uint8_t *refp = vsapi->getReadPtr(pre, plane);
+		int refStride = vsapi->getStride(pre, plane);
+		uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+		int dstStride = vsapi->getStride(dst, plane);
+		const MotionVector *mv = vectors;
+
+		for (int by = 0; by < height; by += blockHeight) {
+			int rows = VSMIN(blockHeight, height - by);
+
+			compensateRows(refp, refStride, dstp, dstStride, by, rows, width, mv, blockWidth, ssW, ssH, fi->bytesPerSample);
+
+			dstp += rows * dstStride;
+			mv += blocksX;
 		}
+	}
+}
 
-		srcp += stride;
+// Write rows [start, end) of the compensation error map without materializing the compensated
+// frame: each luma row is compensated into a scratch row of the stripe and compared right away.
+// Packed maps are compared into a second scratch row and packed from there.
+static void compensationMapStripe(void *userData, int start, int end) {
+	int64_t begin = traceClock();
+	const MotionJob *job = (const MotionJob *)userData;
+	const MotionData *context = job->context;
+	int blockSize = context->search.blockSize;
+	int blocksX = (job->width + blockSize - 1) / blockSize;
+	int bytesPerSample = context->search.bytesPerSample;
+
+	const uint8_t *srcp = job->srcp + start * job->stride;
+	uint8_t *dstp = job->dstp + start * job->dstStride;
+	uint8_t *comp = malloc(job->width * bytesPerSample);
+	uint8_t *row = context->packMaskRow ? malloc(job->width * bytesPerSample) : NULL;
+
+	for (int y = start; y < end; y++) {
+		compensateRows(job->refp, job->refStride, comp, 0, y, 1, job->width, job->vectors + (y / blockSize) * blocksX, blockSize, 0, 0, bytesPerSample);
+		context->errorRow(srcp, comp, row ? row : dstp, job->width, context->threshold);
+
+		if (row)
+			context->packMaskRow(row, dstp, job->width);
+
+		srcp += job->stride;
+		dstp += job->dstStride;
 	}
 
-	return planeData;
-}
+	free(comp);
+	free(row);
 
-// Write plane data from a matrix to a frame.
-static void writePlaneMatrix(VSFrameRef *frame, int plane, int **planeData, const VSAPI *vsapi) {
-	int height = vsapi->getFrameHeight(frame, plane);
-	int width = vsapi->getFrameWidth(frame, plane);
+	traceEvent("kernel", "compensationMapStripe", "row", start, begin);
+}
 
-	uint8_t *dstp = vsapi->getWritePtr(frame, plane);
-	int stride = vsapi->getStride(frame, plane);
+// Write the compensation error map into the destination plane.
+void generateCompensationMap(const VSFrameRef *frame, const VSFrameRef *pre, const MotionVector *vectors, VSFrameRef *dst, MotionData *context, const VSAPI *vsapi) {
+	int plane = 0; // Y plane index assuming YUV or YIQ input
+	MotionJob job;
+
+	job.srcp = vsapi->getReadPtr(frame, plane);
+	job.stride = vsapi->getStride(frame, plane);
+	job.refp = vsapi->getReadPtr(pre, plane);
+	job.refStride = vsapi->getStride(pre, plane);
+	job.dstp = vsapi->getWritePtr(dst, plane);
+	job.dstStride = vsapi->getStride(dst, plane);
+	job.width = vsapi->getFrameWidth(frame, plane);
+	job.height = vsapi->getFrameHeight(frame, plane);
+	job.vectors = (MotionVector *)vectors;
+	job.context = context;
+
+	runStripes(context->pool, job.height, 1, compensationMapStripe, &job);
+}
 
-	// Write frame data from the matrix.
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			dstp[x] = planeData[y][x];
+// Write the motion map into every plane of the destination: blocks whose vector is at least threshold
+// pixels long are set to the maximum value of the output format, the rest to 0. Chroma blocks cover the
+// same area as luma blocks, so the mask is complete at any subsampling without a separate resize.
+// width is the luma width of the source, which packed masks do not share.
+void generateMotionEstimationMap(const MotionVector *vectors, int width, VSFrameRef *dst, MotionData *context, const VSAPI *vsapi) {
+	const VSFormat *fi = vsapi->getFrameFormat(dst);
+	int blockSize = context->search.blockSize;
+	int blocksX = (width + blockSize - 1) / blockSize;
+
+	if (context->packMaskRow) {
+		// a single plane of bits, packed from 8-bit rows
+		int height = vsapi->getFrameHeight(dst, 0);
+		uint8_t *dstp = vsapi->getWritePtr(dst, 0);
+		int stride = vsapi->getStride(dst, 0);
+		uint8_t *row = malloc(width);
+
+		for (int y = 0; y < height; y++) {
+			motionMaskRow(vectors + (y / blockSize) * blocksX, row, width, blockSize, context->threshold, 8);
+			context->packMaskRow(row, dstp, width);
+			dstp += stride;
 		}
 
-		dstp += stride;
+		free(row);
+		return;
 	}
-}
 
-int **generateMotionEstimationMap(const VSFrameRef *frame, const VSFrameRef *pre, int threshold, const VSAPI *vsapi) {
-	int plane = 0; // Y plane index assuming YUV or YIQ input
-	int height = vsapi->getFrameHeight(frame, plane);
-	int width = vsapi->getFrameWidth(frame, plane);
+	for (int plane = 0; plane < fi->numPlanes; plane++) {
+		int height = vsapi->getFrameHeight(dst, plane);
+		int width = vsapi->getFrameWidth(dst, plane);
+		int blockWidth = blockSize >> (plane ? fi->subSamplingW : 0);
+		int blockHeight = blockSize >> (plane ? fi->subSamplingH : 0);
 
-	// Allocate destination matrix.
-	int **mMap = malloc(height * sizeof *mMap);
+		uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+		int stride = vsapi->getStride(dst, plane);
 
-	for (int i = 0; i < height; i++) {
-		mMap[i] = malloc(width * sizeof *mMap[i]);
+		for (int y = 0; y < height; y++) {
+			motionMaskRow(vectors + (y / blockHeight) * blocksX, dstp, width, blockWidth, context->threshold, fi->bitsPerSample);
+			dstp += stride;
+		}
 	}
+}
 
-	// Read the frame data into the matrix.
-	const uint8_t *srcp = vsapi->getReadPtr(frame, plane);
-	int stride = vsapi->getStride(frame, plane);
+// The planes shared by the stripes of a blended frame.
+typedef struct {
+	const uint8_t *srcp[3];
+	const uint8_t *prevp[3];
+	const uint8_t *maskp[3]; // NULL when the mask is expanded from vectors
+	uint8_t *dstp[3];
+	int stride[3];
+	int prevStride[3];
+	int maskStride[3];
+	int dstStride[3];
+	int width[3];
+	int ssW;
+	int ssH;
+	int bits;
+	const MotionVector *vectors; // NULL with a mask clip
+	const MotionData *context;
+} BlendJob;
+
+// Blend rows [start, end) of the luma plane and the chroma rows they cover. Without a mask clip
+// the mask row of each row of blocks is expanded from its vectors into a scratch row, once for all
+// of its rows, the same way Estimate writes it.
+static void blendStripe(void *userData, int start, int end) {
+	int64_t begin = traceClock();
+	const BlendJob *job = (const BlendJob *)userData;
+	const MotionData *context = job->context;
+	int blockSize = context->search.blockSize;
+	int blocksX = (job->width[0] + blockSize - 1) / blockSize;
+	uint8_t *row = job->vectors ? malloc((size_t)job->width[0] * context->search.bytesPerSample) : NULL;
+
+	for (int plane = 0; plane < 3; plane++) {
+		int ssW = plane ? job->ssW : 0;
+		int ssH = plane ? job->ssH : 0;
+		int blockWidth = blockSize >> ssW;
+		int blockHeight = blockSize >> ssH;
+		int width = job->width[plane];
+
+		for (int y = start >> ssH; y < end >> ssH; y++) {
+			const uint8_t *maskp = row;
+
+			if (!row)
+				maskp = job->maskp[plane] + y * job->maskStride[plane];
+			else if (y == start >> ssH || y % blockHeight == 0)
+				motionMaskRow(job->vectors + (y / blockHeight) * blocksX, row, width, blockWidth, context->threshold, job->bits);
+
+			context->blendRow(job->srcp[plane] + y * job->stride[plane], job->prevp[plane] + y * job->prevStride[plane],
+				maskp, job->dstp[plane] + y * job->dstStride[plane], width);
+		}
+	}
 
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; (x + 5) < width; x++) {
-			mMap[y][x] = 0;
+	free(row);
 
-			// check each block to find best mv based on SAD and compare its distance to thresh
-		}
+	traceEvent("kernel", "blendStripe", "row", start, begin);
+}
 
-		srcp += stride;
+// Average every plane with the previous frame where the motion mask is 0, and copy it elsewhere.
+// The mask is read from every plane of mask, or expanded from vectors when mask is NULL.
+void blendFrame(const VSFrameRef *frame, const VSFrameRef *pre, const VSFrameRef *mask, const MotionVector *vectors, VSFrameRef *dst, MotionData *context, const VSAPI *vsapi) {
+	const VSFormat *fi = vsapi->getFrameFormat(frame);
+	BlendJob job;
+
+	for (int plane = 0; plane < 3; plane++) {
+		job.srcp[plane] = vsapi->getReadPtr(frame, plane);
+		job.prevp[plane] = vsapi->getReadPtr(pre, plane);
+		job.maskp[plane] = mask ? vsapi->getReadPtr(mask, plane) : NULL;
+		job.dstp[plane] = vsapi->getWritePtr(dst, plane);
+		job.stride[plane] = vsapi->getStride(frame, plane);
+		job.prevStride[plane] = vsapi->getStride(pre, plane);
+		job.maskStride[plane] = mask ? vsapi->getStride(mask, plane) : 0;
+		job.dstStride[plane] = vsapi->getStride(dst, plane);
+		job.width[plane] = vsapi->getFrameWidth(frame, plane);
 	}
 
-	return mMap;
+	job.ssW = fi->subSamplingW;
+	job.ssH = fi->subSamplingH;
+	job.bits = fi->bitsPerSample;
+	job.vectors = vectors;
+	job.context = context;
+
+	runStripes(context->pool, vsapi->getFrameHeight(frame, 0), 1 << job.ssH, blendStripe, &job);
 }
 
 // This is the main function that gets called when a frame should be produced. It will, in most cases, get
@@ -104,38 +309,147 @@ static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **inst
 	MotionData *d = (MotionData *)* instanceData;
 
 	if (activationReason == arInitial) {
+		int64_t begin = traceClock();
+
 		// Request the source frames on the first call
 		if (n > 0) {
 			vsapi->requestFrameFilter(n - 1, d->node, frameCtx);
 		}
 
 		vsapi->requestFrameFilter(n, d->node, frameCtx);
+
+		traceEvent("request", d->compensate ? "MotionCompensate" : "MotionEstimate", "n", n, begin);
 	}
 	else if (activationReason == arAllFramesReady) {
+		int64_t begin = traceClock();
+		int64_t start = d->profile ? profileClock() : 0;
 		const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
 
 		// The reason we query this on a per frame basis is because we want our filter
 		// to accept clips with varying dimensions. If we reject such content using d->vi
 		// would be better.
-		const VSFormat *fi = d->vi->format;
+		const VSFormat *fi = d->outVi.format;
 		int height = vsapi->getFrameHeight(src, 0);
 		int width = vsapi->getFrameWidth(src, 0);
 
 		// When creating a new frame for output it is VERY EXTREMELY SUPER IMPORTANT to
 		// supply the "dominant" source frame to copy properties from. Frame props
 		// are an essential part of the filter chain and you should NEVER break it.
-		VSFrameRef *dst = d->compensate && d->show ? vsapi->copyFrame(src, core) : vsapi->newVideoFrame(fi, width, height, src, core);
+		if (n == 0 && d->compensate && d->show) {
+			// no previous frame to compensate from, so the source is its own compensation and is not profiled
+			traceEvent("getFrame", "MotionCompensate", "n", n, begin);
+			return src;
+		}
+
+		int64_t allocBegin = traceClock();
+		VSFrameRef *dst = vsapi->newVideoFrame(fi, d->packMaskRow ? packedRowBytes(width) : width, height, src, core);
+		traceEvent("alloc", "newVideoFrame", "n", n, allocBegin);
+
+		if (d->packMaskRow)
+			vsapi->propSetInt(vsapi->getFramePropsRW(dst), PACKED_WIDTH_PROP, width, paReplace);
 
 		if (n == 0) {
+			// no previous frame to search, so there is no motion
+			for (int plane = 0; plane < fi->numPlanes; plane++) {
+				fillRect(vsapi->getWritePtr(dst, plane), vsapi->getStride(dst, plane), vsapi->getFrameWidth(dst, plane) * fi->bytesPerSample, vsapi->getFrameHeight(dst, plane), 0);
+			}
+
+			vsapi->freeFrame(src);
+			traceEvent("getFrame", d->compensate ? "MotionCompensate" : "MotionEstimate", "n", n, begin);
+			profileFrame(d->profile, dst, start, (int64_t)width * height, vsapi);
 			return dst;
 		}
 
 		const VSFrameRef *pre = vsapi->getFrameFilter(n - 1, d->node, frameCtx);
 
-		// insert processing here
+		int blocksX = (width + d->search.blockSize - 1) / d->search.blockSize;
+		int blocksY = (height + d->search.blockSize - 1) / d->search.blockSize;
+		MotionVector *vectors = malloc(blocksX * blocksY * sizeof *vectors);
+
+		estimateMotion(src, pre, vectors, d, vsapi);
+
+		if (!d->compensate) {
+			// write the motion map in the Y plane
+			generateMotionEstimationMap(vectors, width, dst, d, vsapi);
+		}
+		else if (d->show) {
+			compensateFrame(pre, vectors, dst, d, vsapi);
+		}
+		else {
+			// write the compensation error map in the Y plane
+			generateCompensationMap(src, pre, vectors, dst, d, vsapi);
+		}
 
+		free(vectors);
 		vsapi->freeFrame(pre);
 		vsapi->freeFrame(src);
+		traceEvent("getFrame", d->compensate ? "MotionCompensate" : "MotionEstimate", "n", n, begin);
+		profileFrame(d->profile, dst, start, (int64_t)width * height, vsapi);
+		return dst;
+	}
+
+	return 0;
+}
+
+// Blend frame n with frame n - 1 where there is no motion. Frame 0 has no previous frame and is its
+// own average, so it is passed through.
+static const VSFrameRef *VS_CC blendGetFrame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+	MotionData *d = (MotionData *)* instanceData;
+
+	if (activationReason == arInitial) {
+		int64_t begin = traceClock();
+
+		// Request the source frames on the first call
+		if (n > 0) {
+			vsapi->requestFrameFilter(n - 1, d->node, frameCtx);
+		}
+
+		vsapi->requestFrameFilter(n, d->node, frameCtx);
+
+		if (n > 0 && d->mask) {
+			vsapi->requestFrameFilter(n, d->mask, frameCtx);
+		}
+
+		traceEvent("request", "MotionBlend", "n", n, begin);
+	}
+	else if (activationReason == arAllFramesReady) {
+		int64_t begin = traceClock();
+		int64_t start = d->profile ? profileClock() : 0;
+		const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+
+		if (n == 0) {
+			traceEvent("getFrame", "MotionBlend", "n", n, begin);
+			profileFrame(d->profile, NULL, start, 0, vsapi);
+			return src;
+		}
+
+		const VSFrameRef *pre = vsapi->getFrameFilter(n - 1, d->node, frameCtx);
+		const VSFrameRef *mask = d->mask ? vsapi->getFrameFilter(n, d->mask, frameCtx) : NULL;
+		int height = vsapi->getFrameHeight(src, 0);
+		int width = vsapi->getFrameWidth(src, 0);
+		MotionVector *vectors = NULL;
+
+		if (!mask) {
+			int blocksX = (width + d->search.blockSize - 1) / d->search.blockSize;
+			int blocksY = (height + d->search.blockSize - 1) / d->search.blockSize;
+			vectors = malloc(blocksX * blocksY * sizeof *vectors);
+
+			estimateMotion(src, pre, vectors, d, vsapi);
+		}
+
+		// Every pixel is written by blendFrame, so there is no need to copy the source first.
+		int64_t allocBegin = traceClock();
+		VSFrameRef *dst = vsapi->newVideoFrame(d->vi->format, width, height, src, core);
+		traceEvent("alloc", "newVideoFrame", "n", n, allocBegin);
+
+		blendFrame(src, pre, mask, vectors, dst, d, vsapi);
+
+		free(vectors);
+		vsapi->freeFrame(mask);
+		vsapi->freeFrame(pre);
+		vsapi->freeFrame(src);
+		traceEvent("getFrame", "MotionBlend", "n", n, begin);
+		profileFrame(d->profile, dst, start, (int64_t)width * height, vsapi);
 		return dst;
 	}
 
@@ -146,39 +460,153 @@ static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **inst
 static void VS_CC freeResources(void *instanceData, VSCore *core, const VSAPI *vsapi) {
 	MotionData *d = (MotionData *)instanceData;
 	vsapi->freeNode(d->node);
+	vsapi->freeNode(d->mask);
+	freeThreadPool(d->pool);
+	freeProfile(d->profile, vsapi);
 	free(d);
 }
 
+// Read the block matching, threading and kernel selection arguments shared by Estimate and Compensate. Returns 0 and sets an error on invalid input.
+static int getSearchArgs(const VSMap *in, VSMap *out, MotionData *d, int *threads, CpuLevel *cpu, const VSAPI *vsapi) {
+	int err;
+
+	d->search.blockSize = int64ToIntS(vsapi->propGetInt(in, "blksize", 0, &err));
+	if (err)
+		d->search.blockSize = 4;
+
+	if (d->search.blockSize != 4 && d->search.blockSize != 8 && d->search.blockSize != 16 && d->search.blockSize != 32) {
+		vsapi->setError(out, "MotionDetect: blksize must be 4, 8, 16 or 32");
+		return 0;
+	}
+
+	d->search.range = int64ToIntS(vsapi->propGetInt(in, "range", 0, &err));
+	if (err)
+		d->search.range = 2;
+
+	if (d->search.range < 0) {
+		vsapi->setError(out, "MotionDetect: range must be a positive value");
+		return 0;
+	}
+
+	*threads = int64ToIntS(vsapi->propGetInt(in, "threads", 0, &err));
+	if (err)
+		*threads = 1;
+
+	if (*threads < 0) {
+		vsapi->setError(out, "MotionDetect: threads must be a positive value");
+		return 0;
+	}
+
+	if (!parseCpuLevel(vsapi->propGetData(in, "opt", 0, &err), cpu)) {
+		vsapi->setError(out, "MotionDetect: opt must be auto, c, sse2, ssse3, avx2 or avx512bw, and supported by the CPU");
+		return 0;
+	}
+
+	initMotionSearch(&d->search, d->vi->format->bitsPerSample, *cpu);
+	return 1;
+}
+
 // This function is responsible for validating arguments and creating a new filter
 static void VS_CC estimateCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
 	MotionData d;
 	MotionData *data;
+	int threads;
+	CpuLevel cpu;
 	int err;
 
 	// Get a clip reference from the input arguments. This must be freed later.
 	d.node = vsapi->propGetNode(in, "clip", 0, 0);
+	d.mask = NULL;
 	d.vi = vsapi->getVideoInfo(d.node);
+	d.blendRow = NULL;
 
-	// In this first version we only want to handle 8bit integer formats. Note that
+	// There are kernels for 8, 10, 12 and 16-bit integer formats. Note that
 	// vi->format can be 0 if the input clip can change format midstream.
-	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || d.vi->format->bitsPerSample != 8) {
-		vsapi->setError(out, "MotionDetect: only constant format 8-bit integer input supported");
+	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || !isSupportedBitDepth(d.vi->format->bitsPerSample)) {
+		vsapi->setError(out, "MotionDetect: only constant format 8, 10, 12 or 16-bit integer input supported");
 		vsapi->freeNode(d.node);
 		return;
 	}
 
-	if (d.vi->format->id != pfYUV444P8) {
-		vsapi->setError(out, "MotionDetect: YUV444P8 input is required");
+	// Only the luma plane is searched, so any YUV subsampling works.
+	if (d.vi->format->colorFamily != cmYUV) {
+		vsapi->setError(out, "MotionDetect: YUV input is required");
 		vsapi->freeNode(d.node);
 		return;
 	}
 
-	d.threshold = !!vsapi->propGetInt(in, "threshold", 0, &err);
+	d.threshold = int64ToIntS(vsapi->propGetInt(in, "threshold", 0, &err));
 	if (err)
-		d.threshold = 2;
+		d.threshold = 1;
+
+	if (d.threshold < 0) {
+		vsapi->setError(out, "MotionDetect: threshold must be a positive value");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	if (!getSearchArgs(in, out, &d, &threads, &cpu, vsapi)) {
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	// The mask is written to every plane of the input format, of a Gray format of the same depth
+	// when gray output is requested, or of any Gray or YUV integer format passed as format.
+	d.outVi = *d.vi;
+
+	int gray = !!vsapi->propGetInt(in, "gray", 0, &err);
+	int formatId = int64ToIntS(vsapi->propGetInt(in, "format", 0, &err));
+
+	if (!err) {
+		const VSFormat *format = vsapi->getFormatPreset(formatId, core);
+
+		if (gray) {
+			vsapi->setError(out, "MotionDetect: gray and format cannot be used together");
+			vsapi->freeNode(d.node);
+			return;
+		}
+
+		if (!format || (format->colorFamily != cmGray && format->colorFamily != cmYUV) || format->sampleType != stInteger || !isSupportedBitDepth(format->bitsPerSample)) {
+			vsapi->setError(out, "MotionDetect: format must be a Gray or YUV integer format of 8, 10, 12 or 16 bits");
+			vsapi->freeNode(d.node);
+			return;
+		}
+
+		// The mask keeps the clip's dimensions, so they must fit the subsampling of the format.
+		if (d.vi->width % (1 << format->subSamplingW) || d.vi->height % (1 << format->subSamplingH)) {
+			vsapi->setError(out, "MotionDetect: clip dimensions must be divisible by the subsampling of format");
+			vsapi->freeNode(d.node);
+			return;
+		}
+
+		d.outVi.format = format;
+	}
+	else if (gray) {
+		d.outVi.format = vsapi->registerFormat(cmGray, stInteger, d.vi->format->bitsPerSample, 0, 0, core);
+	}
+
+	// Packed masks hold one bit per pixel in a GRAY8 frame of a width rounded up to whole bytes.
+	d.packMaskRow = NULL;
+
+	if (vsapi->propGetInt(in, "packed", 0, &err)) {
+		if (d.outVi.format != d.vi->format) {
+			vsapi->setError(out, "MotionDetect: packed cannot be combined with gray or format");
+			vsapi->freeNode(d.node);
+			return;
+		}
+
+		d.outVi.format = vsapi->getFormatPreset(pfGray8, core);
+		d.outVi.width = packedRowBytes(d.vi->width);
+		d.packMaskRow = selectPackMaskRow(1, cpu);
+	}
 
 	d.compensate = 0;
 
+	// 0 uses as many threads as the core
+	d.pool = createThreadPool(threads ? threads : vsapi->getCoreInfo(core)->numThreads);
+
+	d.profile = vsapi->propGetInt(in, "profile", 0, &err) ? createProfile("MotionEstimate") : NULL;
+
 	// I usually keep the filter data struct on the stack and don't allocate it
 	// until all the input validation is done.
 	data = malloc(sizeof(d));
@@ -205,22 +633,27 @@ static void VS_CC estimateCreate(const VSMap *in, VSMap *out, void *userData, VS
 static void VS_CC compensateCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
 	MotionData d;
 	MotionData *data;
+	int threads;
+	CpuLevel cpu;
 	int err;
 
 	// Get a clip reference from the input arguments. This must be freed later.
 	d.node = vsapi->propGetNode(in, "clip", 0, 0);
+	d.mask = NULL;
 	d.vi = vsapi->getVideoInfo(d.node);
+	d.blendRow = NULL;
 
-	// In this first version we only want to handle 8bit integer formats. Note that
+	// There are kernels for 8, 10, 12 and 16-bit integer formats. Note that
 	// vi->format can be 0 if the input clip can change format midstream.
-	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || d.vi->format->bitsPerSample != 8) {
-		vsapi->setError(out, "MotionDetect: only constant format 8-bit integer input supported");
+	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || !isSupportedBitDepth(d.vi->format->bitsPerSample)) {
+		vsapi->setError(out, "MotionDetect: only constant format 8, 10, 12 or 16-bit integer input supported");
 		vsapi->freeNode(d.node);
 		return;
 	}
 
-	if (d.vi->format->id != pfYUV444P8) {
-		vsapi->setError(out, "MotionDetect: YUV444P8 input is required");
+	// Chroma blocks and vectors are scaled by the subsampling, so any YUV format works.
+	if (d.vi->format->colorFamily != cmYUV) {
+		vsapi->setError(out, "MotionDetect: YUV input is required");
 		vsapi->freeNode(d.node);
 		return;
 	}
@@ -231,16 +664,62 @@ static void VS_CC compensateCreate(const VSMap *in, VSMap *out, void *userData,
 		return;
 	}
 
-	d.threshold = !!vsapi->propGetInt(in, "threshold", 0, &err);
+	d.threshold = int64ToIntS(vsapi->propGetInt(in, "threshold", 0, &err));
 	if (err)
 		d.threshold = 16;
 
-	d.show = !!vsapi->propGetInt(in, "show", 1, &err);
+	if (d.threshold < 0) {
+		vsapi->setError(out, "MotionDetect: threshold must be a positive value");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	d.show = !!vsapi->propGetInt(in, "show", 0, &err);
 	if (err)
 		d.show = 0;
 
+	if (!getSearchArgs(in, out, &d, &threads, &cpu, vsapi)) {
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	d.outVi = *d.vi;
+
+	if (vsapi->propGetInt(in, "gray", 0, &err)) {
+		if (d.show) {
+			vsapi->setError(out, "MotionDetect: gray only applies to masks and cannot be used with show");
+			vsapi->freeNode(d.node);
+			return;
+		}
+
+		d.outVi.format = vsapi->registerFormat(cmGray, stInteger, d.vi->format->bitsPerSample, 0, 0, core);
+	}
+
+	// Packed masks hold one bit per pixel in a GRAY8 frame of a width rounded up to whole bytes.
+	d.packMaskRow = NULL;
+
+	if (vsapi->propGetInt(in, "packed", 0, &err)) {
+		if (d.show || d.outVi.format != d.vi->format) {
+			vsapi->setError(out, "MotionDetect: packed only applies to masks and cannot be combined with gray or show");
+			vsapi->freeNode(d.node);
+			return;
+		}
+
+		d.outVi.format = vsapi->getFormatPreset(pfGray8, core);
+		d.outVi.width = packedRowBytes(d.vi->width);
+		d.packMaskRow = selectPackMaskRow(d.vi->format->bytesPerSample, cpu);
+	}
+
+	// the threshold is given for 8-bit samples
+	d.threshold <<= d.vi->format->bitsPerSample - 8;
 	d.compensate = 1;
 
+	// 0 uses as many threads as the core
+	d.pool = createThreadPool(threads ? threads : vsapi->getCoreInfo(core)->numThreads);
+	d.errorRow = selectCompensationErrorRow(d.vi->format->bitsPerSample, cpu);
+
+	d.profile = vsapi->propGetInt(in, "profile", 0, &err) ? createProfile("MotionCompensate") : NULL;
+
 	// I usually keep the filter data struct on the stack and don't allocate it
 	// until all the input validation is done.
 	data = malloc(sizeof(d));
@@ -263,6 +742,77 @@ static void VS_CC compensateCreate(const VSMap *in, VSMap *out, void *userData,
 	vsapi->createFilter(in, out, "MotionCompensate", init, getFrame, freeResources, fmParallel, 0, data, core);
 }
 
+// This function is responsible for validating arguments and creating a new filter. Blend replaces
+// merging the clip with a one frame delayed copy of itself under an inverted motion mask.
+static void VS_CC blendCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+	MotionData d;
+	MotionData *data;
+	int threads;
+	CpuLevel cpu;
+	int err;
+
+	// Get a clip reference from the input arguments. This must be freed later.
+	d.node = vsapi->propGetNode(in, "clip", 0, 0);
+	d.vi = vsapi->getVideoInfo(d.node);
+
+	// There are kernels for 8, 10, 12 and 16-bit integer formats. Note that
+	// vi->format can be 0 if the input clip can change format midstream.
+	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || !isSupportedBitDepth(d.vi->format->bitsPerSample)) {
+		vsapi->setError(out, "MotionDetect: only constant format 8, 10, 12 or 16-bit integer input supported");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	if (d.vi->format->colorFamily != cmYUV) {
+		vsapi->setError(out, "MotionDetect: YUV input is required");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	// Every plane is gated by the same plane of the mask, as Estimate writes it in the clip's format.
+	d.mask = vsapi->propGetNode(in, "mask", 0, &err);
+
+	if (d.mask && !isSameFormat(d.vi, vsapi->getVideoInfo(d.mask))) {
+		vsapi->setError(out, "MotionDetect: mask must have the format and dimensions of the clip");
+		vsapi->freeNode(d.mask);
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	d.threshold = int64ToIntS(vsapi->propGetInt(in, "threshold", 0, &err));
+	if (err)
+		d.threshold = 1;
+
+	if (d.threshold < 0) {
+		vsapi->setError(out, "MotionDetect: threshold must be a positive value");
+		vsapi->freeNode(d.mask);
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	if (!getSearchArgs(in, out, &d, &threads, &cpu, vsapi)) {
+		vsapi->freeNode(d.mask);
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	d.outVi = *d.vi;
+	d.compensate = 0;
+	d.show = 0;
+	d.packMaskRow = NULL;
+	d.blendRow = selectTemporalBlendRow(d.vi->format->bitsPerSample, cpu);
+
+	// 0 uses as many threads as the core
+	d.pool = createThreadPool(threads ? threads : vsapi->getCoreInfo(core)->numThreads);
+
+	d.profile = vsapi->propGetInt(in, "profile", 0, &err) ? createProfile("MotionBlend") : NULL;
+
+	data = malloc(sizeof(d));
+	*data = d;
+
+	vsapi->createFilter(in, out, "MotionBlend", init, blendGetFrame, freeResources, fmParallel, 0, data, core);
+}
+
 //////////////////////////////////////////
 // Init
 
@@ -290,7 +840,12 @@ static void VS_CC compensateCreate(const VSMap *in, VSMap *out, void *userData,
 // or not empty arrays are accepted
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin) {
+	// Kernels are selected per filter from the instruction set level of the CPU, detected once here,
+	// and UNCROSS_TRACE is read once per load.
+	initCpuLevel();
+	initTrace();
 	configFunc("github.com.rzumer.motiondetect", "motiondetect", "MotionDetect", VAPOURSYNTH_API_VERSION, 1, plugin);
-	registerFunc("Estimate", "clip:clip;threshold:int:opt;", estimateCreate, 0, plugin);
-	registerFunc("Compensate", "clip:clip;threshold:int:opt;show:int:opt;", compensateCreate, 0, plugin);
+	registerFunc("Estimate", "clip:clip;threshold:int:opt;blksize:int:opt;range:int:opt;gray:int:opt;format:int:opt;packed:int:opt;threads:int:opt;opt:data:opt;profile:int:opt;", estimateCreate, 0, plugin);
+	registerFunc("Compensate", "clip:clip;threshold:int:opt;show:int:opt;blksize:int:opt;range:int:opt;gray:int:opt;packed:int:opt;threads:int:opt;opt:data:opt;profile:int:opt;", compensateCreate, 0, plugin);
+	registerFunc("Blend", "clip:clip;mask:clip:opt;threshold:int:opt;blksize:int:opt;range:int:opt;threads:int:opt;opt:data:opt;profile:int:opt;", blendCreate, 0, plugin);
 }
@@ -1,16 +1,26 @@
 #include <stdlib.h>
+#include <string.h>
 #include <VapourSynth.h>
 #include <VSHelper.h>
+#include "cpu.h"
+#include "packed.h"
+#include "profile.h"
+#include "rainbow.h"
+#include "threadpool.h"
+#include "tiles.h"
+#include "trace.h"
 
 typedef struct {
 	VSNodeRef *node;
 	const VSVideoInfo *vi;
-
-	int threshY;
-	int threshU1;
-	int threshV1;
-	int threshU2;
-	int threshV2;
+	VSVideoInfo outVi; // vi with the mask format
+
+	RainbowParams params;
+	RainbowRowFunc rainbowRow;
+	PackMaskRowFunc packMaskRow; // NULL unless packed=1
+	CountMaskRowFunc countMaskRow; // counts the output rows for the tile summary
+	ThreadPool *pool; // NULL when frames are processed on a single thread
+	Profile *profile; // NULL unless profile=1
 } VideoData;
 
 // This function is called immediately after vsapi->createFilter(). This is the only place where the video
@@ -18,98 +28,79 @@ typedef struct {
 // of VSVideoInfo if the filter has more than one output, like rgb+alpha as two separate clips.
 static void VS_CC init(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
 	VideoData *d = (VideoData *)* instanceData;
-	vsapi->setVideoInfo(d->vi, 1, node);
+	vsapi->setVideoInfo(&d->outVi, 1, node);
 }
 
-// Read plane data into a matrix.
-static int **readPlaneMatrix(const VSFrameRef *frame, int plane, const VSAPI *vsapi) {
-	int height = vsapi->getFrameHeight(frame, plane);
-	int width = vsapi->getFrameWidth(frame, plane);
-
-	// Allocate destination matrix.
-	int **planeData = malloc(height * sizeof *planeData);
-
-	for (int i = 0; i < height; i++) {
-		planeData[i] = malloc(width * sizeof *planeData[i]);
-	}
-
-	// Read the frame data into the matrix.
-	const uint8_t *srcp = vsapi->getReadPtr(frame, plane);
-	int stride = vsapi->getStride(frame, plane);
-
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			planeData[y][x] = srcp[x];
-		}
-
-		srcp += stride;
+// The plane pointers shared by the stripes of one rainbow map.
+typedef struct {
+	const uint8_t *srcpy;
+	const uint8_t *srcpu;
+	const uint8_t *srcpv;
+	const uint8_t *prepu;
+	const uint8_t *prepv;
+	uint8_t *dstp;
+	int stride;
+	int chromaStride;
+	int preChromaStride;
+	int dstStride;
+	int width;
+	int ssH;
+	int *tileCounts;
+	const VideoData *context;
+} RainbowJob;
+
+// Map rows [start, end). Chroma is only read, so stripes need no alignment to the subsampling.
+// Packed maps are written a row at a time into a buffer of the stripe and packed from there.
+// Stripes are whole rows of tiles, so each one only adds to the counts of its own tiles.
+static void rainbowStripe(void *userData, int start, int end) {
+	int64_t begin = traceClock();
+	const RainbowJob *job = (const RainbowJob *)userData;
+	const VideoData *context = job->context;
+	const uint8_t *srcpy = job->srcpy + start * job->stride;
+	uint8_t *dstp = job->dstp + start * job->dstStride;
+	uint8_t *row = context->packMaskRow ? malloc(job->width * context->vi->format->bytesPerSample) : NULL;
+
+	for (int y = start; y < end; y++) {
+		int cy = y >> job->ssH;
+
+		context->rainbowRow(srcpy, job->srcpu + cy * job->chromaStride, job->srcpv + cy * job->chromaStride,
+			job->prepu + cy * job->preChromaStride, job->prepv + cy * job->preChromaStride, row ? row : dstp, job->width, &context->params);
+
+		if (row)
+			context->packMaskRow(row, dstp, job->width);
+
+		context->countMaskRow(dstp, job->width, job->tileCounts + (y / MASK_TILE_SIZE) * maskTileCount(job->width));
+
+		srcpy += job->stride;
+		dstp += job->dstStride;
 	}
 
-	return planeData;
+	free(row);
+	traceEvent("kernel", "rainbowStripe", "row", start, begin);
 }
 
-// Write plane data from a matrix to a frame.
-static void writePlaneMatrix(VSFrameRef *frame, int plane, int **planeData, const VSAPI *vsapi) {
-	int height = vsapi->getFrameHeight(frame, plane);
-	int width = vsapi->getFrameWidth(frame, plane);
-
-	uint8_t *dstp = vsapi->getWritePtr(frame, plane);
-	int stride = vsapi->getStride(frame, plane);
-
-	// Write frame data from the matrix.
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			dstp[x] = planeData[y][x];
-		}
-
-		dstp += stride;
-	}
-}
-
-int **generateRainbowMap(const VSFrameRef *frame, const VSFrameRef *previous, VideoData *context, const VSAPI *vsapi) {
-	int height = vsapi->getFrameHeight(frame, 0); // same for all planes with YUV444P8
-	int width = vsapi->getFrameWidth(frame, 0); // same for all planes with YUV444P8
-
-	// Allocate destination matrix.
-	int **rbMap = malloc(height * sizeof *rbMap);
-
-	for (int i = 0; i < height; i++) {
-		rbMap[i] = malloc(width * sizeof *rbMap[i]);
-	}
-
-	// Read the frame data into the matrix.
-	const uint8_t *srcpy = vsapi->getReadPtr(frame, 0); // y plane pointer
-	const uint8_t *srcpu = vsapi->getReadPtr(frame, 1); // u plane pointer
-	const uint8_t *srcpv = vsapi->getReadPtr(frame, 2); // v plane pointer
-	const uint8_t *prepu = vsapi->getReadPtr(previous, 1); // u previous plane pointer
-	const uint8_t *prepv = vsapi->getReadPtr(previous, 2); // v previous plane pointer
-
-	int stride = vsapi->getStride(frame, 0);
-
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			rbMap[y][x] = 0;
-
-			int du = abs(srcpu[x] - prepu[x]);
-			int dv = abs(srcpv[x] - prepv[x]);
-
-			if (
-				srcpy[x] > context->threshY
-				&& ((context->threshU1 < du && du < context->threshU2)
-				|| (context->threshV1 < dv && dv < context->threshV2))
-				) {
-				rbMap[y][x] = 255;
-			}
-		}
-
-		srcpy += stride;
-		srcpu += stride;
-		srcpv += stride;
-		prepu += stride;
-		prepv += stride;
-	}
-
-	return rbMap;
+// Write the rainbow map of a frame directly into a destination plane, adding the flagged pixels of each tile to tileCounts.
+// Each luma pixel is tested against the chroma sample covering it.
+void generateRainbowMap(const VSFrameRef *frame, const VSFrameRef *previous, VSFrameRef *dst, int *tileCounts, VideoData *context, const VSAPI *vsapi) {
+	RainbowJob job;
+
+	job.srcpy = vsapi->getReadPtr(frame, 0); // y plane pointer
+	job.srcpu = vsapi->getReadPtr(frame, 1); // u plane pointer
+	job.srcpv = vsapi->getReadPtr(frame, 2); // v plane pointer
+	job.prepu = vsapi->getReadPtr(previous, 1); // u previous plane pointer
+	job.prepv = vsapi->getReadPtr(previous, 2); // v previous plane pointer
+	job.dstp = vsapi->getWritePtr(dst, 0);
+
+	job.stride = vsapi->getStride(frame, 0);
+	job.chromaStride = vsapi->getStride(frame, 1);
+	job.preChromaStride = vsapi->getStride(previous, 1);
+	job.dstStride = vsapi->getStride(dst, 0);
+	job.width = vsapi->getFrameWidth(frame, 0);
+	job.ssH = vsapi->getFrameFormat(frame)->subSamplingH;
+	job.tileCounts = tileCounts;
+	job.context = context;
+
+	runStripes(context->pool, vsapi->getFrameHeight(frame, 0), MASK_TILE_SIZE, rainbowStripe, &job);
 }
 
 // This is the main function that gets called when a frame should be produced. It will, in most cases, get
@@ -123,47 +114,72 @@ static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **inst
 	VideoData *d = (VideoData *)* instanceData;
 
 	if (activationReason == arInitial) {
+		int64_t begin = traceClock();
+
 		// Request the source frames on the first call
 		if (n > 0) {
 			vsapi->requestFrameFilter(n - 1, d->node, frameCtx);
 		}
 
 		vsapi->requestFrameFilter(n, d->node, frameCtx);
+
+		traceEvent("request", "RainbowDetect", "n", n, begin);
 	}
 	else if (activationReason == arAllFramesReady) {
+		int64_t begin = traceClock();
+		int64_t start = d->profile ? profileClock() : 0;
 		const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
-		const VSFrameRef *pre = vsapi->getFrameFilter(n - 1, d->node, frameCtx);
 
 		// The reason we query this on a per frame basis is because we want our filter
 		// to accept clips with varying dimensions. If we reject such content using d->vi
 		// would be better.
-		const VSFormat *fi = d->vi->format;
+		const VSFormat *fi = d->outVi.format;
 		int height = vsapi->getFrameHeight(src, 0);
 		int width = vsapi->getFrameWidth(src, 0);
 
 		// When creating a new frame for output it is VERY EXTREMELY SUPER IMPORTANT to
 		// supply the "dominant" source frame to copy properties from. Frame props
 		// are an essential part of the filter chain and you should NEVER break it.
-		VSFrameRef *dst = vsapi->newVideoFrame(fi, width, height, src, core);
+		int64_t allocBegin = traceClock();
+		VSFrameRef *dst = vsapi->newVideoFrame(fi, d->packMaskRow ? packedRowBytes(width) : width, height, src, core);
+		traceEvent("alloc", "newVideoFrame", "n", n, allocBegin);
+
+		VSMap *props = vsapi->getFramePropsRW(dst);
+		int *tileCounts = calloc((size_t)maskTileCount(width) * maskTileCount(height), sizeof *tileCounts);
+
+		if (d->packMaskRow)
+			vsapi->propSetInt(props, PACKED_WIDTH_PROP, width, paReplace);
 
 		if (n == 0) {
-			vsapi->freeFrame(pre);
+			// no previous frame to compare against, so nothing is flagged
+			uint8_t *dstp = vsapi->getWritePtr(dst, 0);
+			int dstStride = vsapi->getStride(dst, 0);
+			int rowSize = vsapi->getFrameWidth(dst, 0) * fi->bytesPerSample;
+
+			for (int y = 0; y < height; y++) {
+				memset(dstp, 0, rowSize);
+				dstp += dstStride;
+			}
+
+			setMaskTileProps(props, tileCounts, width, height, vsapi);
+			free(tileCounts);
 			vsapi->freeFrame(src);
+			traceEvent("getFrame", "RainbowDetect", "n", n, begin);
+			profileFrame(d->profile, dst, start, (int64_t)width * height, vsapi);
 			return dst;
 		}
 
-		int **rbMap = generateRainbowMap(src, pre, d, vsapi);
+		const VSFrameRef *pre = vsapi->getFrameFilter(n - 1, d->node, frameCtx);
 
-		// write the DCMap in the Y plane
-		writePlaneMatrix(dst, 0, rbMap, vsapi);
+		// write the RBMap in the Y plane
+		generateRainbowMap(src, pre, dst, tileCounts, d, vsapi);
+		setMaskTileProps(props, tileCounts, width, height, vsapi);
+		free(tileCounts);
 
-		// deallocate the rainbow map
-		for (int i = 0; i < height; i++) {
-			free(rbMap[i]);
-		}
-		free(rbMap);
 		vsapi->freeFrame(pre);
 		vsapi->freeFrame(src);
+		traceEvent("getFrame", "RainbowDetect", "n", n, begin);
+		profileFrame(d->profile, dst, start, (int64_t)width * height, vsapi);
 		return dst;
 	}
 
@@ -174,9 +190,31 @@ static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **inst
 static void VS_CC freeResources(void *instanceData, VSCore *core, const VSAPI *vsapi) {
 	VideoData *d = (VideoData *)instanceData;
 	vsapi->freeNode(d->node);
+	freeThreadPool(d->pool);
+	freeProfile(d->profile, vsapi);
 	free(d);
 }
 
+// Read an optional non-negative integer argument. If a property read fails for some reason
+// (index out of bounds/wrong type) then err will have flags set to indicate why and 0 will be
+// returned. Since we have strict checking because of what we wrote in the argument string, the
+// only reason this could fail is when the value wasn't set by the user, and then it takes its
+// default. Returns 0 and sets an error on invalid input.
+static int getThreshold(const VSMap *in, VSMap *out, const char *name, int defaultValue, int *value, const VSAPI *vsapi) {
+	int err;
+
+	*value = int64ToIntS(vsapi->propGetInt(in, name, 0, &err));
+	if (err)
+		*value = defaultValue;
+
+	if (*value < 0) {
+		vsapi->setError(out, "RainbowDetect: threshold must be a positive value");
+		return 0;
+	}
+
+	return 1;
+}
+
 // This function is responsible for validating arguments and creating a new filter
 static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
 	VideoData d;
@@ -187,58 +225,96 @@ static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *co
 	d.node = vsapi->propGetNode(in, "clip", 0, 0);
 	d.vi = vsapi->getVideoInfo(d.node);
 
-	// In this first version we only want to handle 8bit integer formats. Note that
+	// There are kernels for 8, 10, 12 and 16-bit integer formats. Note that
 	// vi->format can be 0 if the input clip can change format midstream.
-	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || d.vi->format->bitsPerSample != 8) {
-		vsapi->setError(out, "RainbowDetect: only constant format 8-bit integer input supported");
+	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || !isSupportedBitDepth(d.vi->format->bitsPerSample)) {
+		vsapi->setError(out, "RainbowDetect: only constant format 8, 10, 12 or 16-bit integer input supported");
 		vsapi->freeNode(d.node);
 		return;
 	}
-	
-	// If a property read fails for some reason (index out of bounds/wrong type)
-	// then err will have flags set to indicate why and 0 will be returned. This
-	// can be very useful to know when having optional arguments. Since we have
-	// strict checking because of what we wrote in the argument string, the only
-	// reason this could fail is when the value wasn't set by the user.
-	// And when it's not set we want it to default to enabled.
-	d.threshY = !!vsapi->propGetInt(in, "threshY", 0, &err);
-	if (err)
-		d.threshY = 10;
 
-	d.threshU1 = !!vsapi->propGetInt(in, "threshU1", 1, &err);
-	if (err)
-		d.threshU1 = 5;
+	// Defaults are those of uncross.Process, which runs the same test.
+	if (!getThreshold(in, out, "threshY", 10, &d.params.threshY, vsapi)
+		|| !getThreshold(in, out, "threshU1", 5, &d.params.threshU1, vsapi)
+		|| !getThreshold(in, out, "threshV1", 5, &d.params.threshV1, vsapi)
+		|| !getThreshold(in, out, "threshU2", 20, &d.params.threshU2, vsapi)
+		|| !getThreshold(in, out, "threshV2", 20, &d.params.threshV2, vsapi)) {
+		vsapi->freeNode(d.node);
+		return;
+	}
 
-	d.threshV1 = !!vsapi->propGetInt(in, "threshV1", 2, &err);
-	if (err)
-		d.threshV1 = 5;
+	if (d.params.threshU2 < d.params.threshU1 || d.params.threshV2 < d.params.threshV1) {
+		vsapi->setError(out, "RainbowDetect: thresh2 must be greater than thresh1");
+		vsapi->freeNode(d.node);
+		return;
+	}
 
-	d.threshU2 = !!vsapi->propGetInt(in, "threshU2", 3, &err);
-	if (err)
-		d.threshU2 = 20;
+	if (d.vi->format->colorFamily != cmYUV || d.vi->format->subSamplingW > 1) {
+		vsapi->setError(out, "RainbowDetect: YUV input with at most 2x horizontal chroma subsampling is required");
+		vsapi->freeNode(d.node);
+		return;
+	}
 
-	d.threshV2 = !!vsapi->propGetInt(in, "threshV2", 4, &err);
+	int threads = int64ToIntS(vsapi->propGetInt(in, "threads", 0, &err));
 	if (err)
-		d.threshV2 = 20;
+		threads = 1;
 
-	if (d.threshY < 0 || d.threshU1 < 0 || d.threshU2 < 0 || d.threshV1 < 0 || d.threshV2 < 0) {
-		vsapi->setError(out, "RainbowDetect: threshold must be a positive value");
+	if (threads < 0) {
+		vsapi->setError(out, "RainbowDetect: threads must be a positive value");
 		vsapi->freeNode(d.node);
 		return;
 	}
 
-	if (d.threshU2 < d.threshU1 || d.threshV2 < d.threshV1) {
-		vsapi->setError(out, "RainbowDetect: thresh2 must be greater than thresh1");
+	CpuLevel cpu;
+
+	if (!parseCpuLevel(vsapi->propGetData(in, "opt", 0, &err), &cpu)) {
+		vsapi->setError(out, "RainbowDetect: opt must be auto, c, sse2, ssse3, avx2 or avx512bw, and supported by the CPU");
 		vsapi->freeNode(d.node);
 		return;
 	}
 
-	if (d.vi->format->id != pfYUV444P8) {
-		vsapi->setError(out, "RainbowDetect: YUV444P8 input is required");
-		vsapi->freeNode(d.node);
-		return;
+	// 0 uses as many threads as the core
+	if (threads == 0)
+		threads = vsapi->getCoreInfo(core)->numThreads;
+
+	// Masks are written to plane 0 of the input format unless gray output is requested,
+	// which saves allocating chroma planes that are never written.
+	d.outVi = *d.vi;
+
+	if (vsapi->propGetInt(in, "gray", 0, &err))
+		d.outVi.format = vsapi->registerFormat(cmGray, stInteger, d.vi->format->bitsPerSample, 0, 0, core);
+
+	// Packed masks hold one bit per pixel in a GRAY8 frame of a width rounded up to whole bytes.
+	d.packMaskRow = NULL;
+
+	if (vsapi->propGetInt(in, "packed", 0, &err)) {
+		if (d.outVi.format != d.vi->format) {
+			vsapi->setError(out, "RainbowDetect: packed and gray cannot be combined");
+			vsapi->freeNode(d.node);
+			return;
+		}
+
+		d.outVi.format = vsapi->getFormatPreset(pfGray8, core);
+		d.outVi.width = packedRowBytes(d.vi->width);
+		d.packMaskRow = selectPackMaskRow(d.vi->format->bytesPerSample, cpu);
 	}
 
+	d.countMaskRow = selectCountMaskRow(d.vi->format->bytesPerSample, d.packMaskRow != NULL, cpu);
+
+	// thresholds are given for 8-bit samples
+	int shift = d.vi->format->bitsPerSample - 8;
+	d.params.threshY <<= shift;
+	d.params.threshU1 <<= shift;
+	d.params.threshV1 <<= shift;
+	d.params.threshU2 <<= shift;
+	d.params.threshV2 <<= shift;
+
+	initRainbowRanges(&d.params, d.vi->format->bitsPerSample);
+	d.rainbowRow = selectRainbowRow(d.vi->format->subSamplingW, d.vi->format->bitsPerSample, cpu);
+	d.pool = createThreadPool(threads);
+
+	d.profile = vsapi->propGetInt(in, "profile", 0, &err) ? createProfile("RainbowDetect") : NULL;
+
 	// I usually keep the filter data struct on the stack and don't allocate it
 	// until all the input validation is done.
 	data = malloc(sizeof(d));
@@ -288,6 +364,10 @@ static void VS_CC create(const VSMap *in, VSMap *out, void *userData, VSCore *co
 // or not empty arrays are accepted
 
 VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin) {
+	// Kernels are selected per filter from the instruction set level of the CPU, detected once here,
+	// and UNCROSS_TRACE is read once per load.
+	initCpuLevel();
+	initTrace();
 	configFunc("github.com.rzumer.rainbowdetect", "rainbowdetect", "Rainbow Detect", VAPOURSYNTH_API_VERSION, 1, plugin);
-	registerFunc("Detect", "clip:clip;threshY:int:opt;threshU1:int:opt;threshV1:int:opt;threshU2:int:opt;threshV2:int:opt;", create, 0, plugin);
+	registerFunc("Detect", "clip:clip;threshY:int:opt;threshU1:int:opt;threshV1:int:opt;threshU2:int:opt;threshV2:int:opt;gray:int:opt;packed:int:opt;threads:int:opt;opt:data:opt;profile:int:opt;", create, 0, plugin);
 }
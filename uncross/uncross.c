@@ -0,0 +1,854 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <VapourSynth.h>
+#include <VSHelper.h>
+#include "blur.h"
+#include "cpu.h"
+#include "dotcrawl.h"
+#include "logic.h"
+#include "motion.h"
+#include "packed.h"
+#include "rainbow.h"
+#include "tiles.h"
+
+// Mask value used by MaskedMerge for a 50% blend, as produced by Levels(0, 255, 1, 0, 127) on a 255 mask.
+#define HALF_MASK 127
+
+typedef struct {
+	VSNodeRef *node;
+	const VSVideoInfo *vi;
+
+	int dcThreshold;
+	int dcLineDistance; // rows between the lines compared across by the dot crawl test
+	int motionThreshold;
+	int compensationThreshold;
+	RainbowParams rainbow;
+	MotionSearch search;
+
+	DotCrawlRowFunc dotCrawlRow;
+	RainbowRowFunc rainbowRow; // NULL when chroma is subsampled more than 2x horizontally
+	CompensationErrorRowFunc errorRow;
+	BlurRowFunc blurRow;
+	BlurRowFunc blurRowChroma; // NULL when chroma is subsampled more than 2x horizontally
+	LogicRowFunc andRow;
+} UncrossData;
+
+// Per frame working memory. Masks are kept for one row of motion blocks at a time, so the
+// whole frame is processed in a single pass over horizontal bands of blockSize luma rows.
+typedef struct {
+	MotionVector *vectors; // current frame against the previous one
+	MotionVector *vectorsPre; // previous frame against the one before it
+
+	// luma band buffers, blockSize rows of width pixels
+	uint8_t *compY;
+	uint8_t *nomotionMask;
+	uint8_t *temporalMask;
+	uint8_t *spatialMask;
+
+	// luma row buffers
+	uint8_t *motion;
+	uint8_t *motionPre;
+	uint8_t *compensationError;
+	uint8_t *dotCrawl;
+	uint8_t *dotCrawlPre;
+	uint8_t *rainbow;
+	uint8_t *blurred;
+
+	// chroma row buffers
+	uint8_t *compC;
+	uint8_t *blurredC;
+	uint8_t *nomotionMaskC;
+	uint8_t *temporalMaskC;
+	uint8_t *spatialMaskC;
+
+	uint8_t *memory;
+} BandBuffers;
+
+// This function is called immediately after vsapi->createFilter(). This is the only place where the video
+// properties may be set. In this case we simply use the same as the input clip. You may pass an array
+// of VSVideoInfo if the filter has more than one output, like rgb+alpha as two separate clips.
+static void VS_CC init(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
+	UncrossData *d = (UncrossData *)* instanceData;
+	vsapi->setVideoInfo(d->vi, 1, node);
+}
+
+static void allocBandBuffers(BandBuffers *b, int width, int chromaWidth, int blockSize) {
+	int blocksX = (width + blockSize - 1) / blockSize;
+	size_t band = (size_t)width * blockSize;
+	uint8_t *p;
+
+	b->vectors = malloc(2 * blocksX * sizeof *b->vectors);
+	b->vectorsPre = b->vectors + blocksX;
+
+	p = b->memory = malloc(4 * band + 7 * (size_t)width + 5 * (size_t)chromaWidth);
+	b->compY = p; p += band;
+	b->nomotionMask = p; p += band;
+	b->temporalMask = p; p += band;
+	b->spatialMask = p; p += band;
+	b->motion = p; p += width;
+	b->motionPre = p; p += width;
+	b->compensationError = p; p += width;
+	b->dotCrawl = p; p += width;
+	b->dotCrawlPre = p; p += width;
+	b->rainbow = p; p += width;
+	b->blurred = p; p += width;
+	b->compC = p; p += chromaWidth;
+	b->blurredC = p; p += chromaWidth;
+	b->nomotionMaskC = p; p += chromaWidth;
+	b->temporalMaskC = p; p += chromaWidth;
+	b->spatialMaskC = p;
+}
+
+static void freeBandBuffers(BandBuffers *b) {
+	free(b->vectors);
+	free(b->memory);
+}
+
+// Combine the detection rows into the three blend masks of script.vpy:
+//   nomotion = !motion
+//   temporal = motion & !compensationError & ((dc & dcPre) | (rainbow & !dc & !dcPre))
+//   spatial  = dc ^ dcPre
+// where dc and dcPre are the dot crawl maps of this and the previous frame, restricted to moving blocks.
+static void combineMasksRow(const BandBuffers *b, uint8_t *nomotionp, uint8_t *temporalp, uint8_t *spatialp, int width) {
+	for (int x = 0; x < width; x++) {
+		uint8_t dc = b->dotCrawl[x], dcPre = b->dotCrawlPre[x];
+		uint8_t both = dc & dcPre;
+		uint8_t rainbowOnly = b->rainbow[x] & ~(dc | dcPre);
+		uint8_t temporal = b->motion[x] & ~b->compensationError[x] & (both | rainbowOnly);
+
+		nomotionp[x] = b->motion[x] ? 0 : HALF_MASK;
+		temporalp[x] = temporal ? HALF_MASK : 0;
+		spatialp[x] = (dc ^ dcPre) ? HALF_MASK : 0;
+	}
+}
+
+// Blend mergep into dstp in place with the same arithmetic as std.MaskedMerge for 8-bit clips.
+static void maskedMergeRow(uint8_t *dstp, const uint8_t *mergep, const uint8_t *maskp, int width) {
+	for (int x = 0; x < width; x++) {
+		int m = maskp[x] > 2 ? maskp[x] + 1 : maskp[x];
+		dstp[x] = dstp[x] + (((mergep[x] - dstp[x]) * m + 128) >> 8);
+	}
+}
+
+// Average a luma mask down to one chroma row, like std.MaskedMerge with first_plane=True.
+static void subsampleMaskRow(const uint8_t *maskp, int stride, uint8_t *dstp, int width, int ssW, int ssH) {
+	int count = 1 << (ssW + ssH);
+
+	for (int x = 0; x < width; x++) {
+		int sum = 0;
+
+		for (int j = 0; j < (1 << ssH); j++) {
+			for (int i = 0; i < (1 << ssW); i++) {
+				sum += maskp[j * stride + (x << ssW) + i];
+			}
+		}
+
+		dstp[x] = (sum + count / 2) >> (ssW + ssH);
+	}
+}
+
+// Filter one band of luma rows starting at y0 and the matching chroma rows, writing the final result.
+static void processBand(const VSFrameRef *src, const VSFrameRef *pre, const VSFrameRef *prePre, VSFrameRef *dst,
+	int y0, BandBuffers *b, UncrossData *d, const VSAPI *vsapi) {
+	const VSFormat *fi = vsapi->getFrameFormat(src);
+	int height = vsapi->getFrameHeight(src, 0);
+	int width = vsapi->getFrameWidth(src, 0);
+	int blockSize = d->search.blockSize;
+	int rows = VSMIN(blockSize, height - y0);
+	int ssW = fi->subSamplingW;
+	int ssH = fi->subSamplingH;
+
+	const uint8_t *srcpy = vsapi->getReadPtr(src, 0);
+	const uint8_t *prepy = vsapi->getReadPtr(pre, 0);
+	int stride = vsapi->getStride(src, 0);
+	int preStride = vsapi->getStride(pre, 0);
+	uint8_t *dstpy = vsapi->getWritePtr(dst, 0);
+	int dstStride = vsapi->getStride(dst, 0);
+
+	const uint8_t *srcpu = vsapi->getReadPtr(src, 1);
+	const uint8_t *srcpv = vsapi->getReadPtr(src, 2);
+	const uint8_t *prepu = vsapi->getReadPtr(pre, 1);
+	const uint8_t *prepv = vsapi->getReadPtr(pre, 2);
+	int chromaStride = vsapi->getStride(src, 1);
+	int preChromaStride = vsapi->getStride(pre, 1);
+
+	estimateMotionRow(srcpy, stride, prepy, preStride, width, height, y0, b->vectors, &d->search);
+
+	if (prePre) {
+		estimateMotionRow(prepy, preStride, vsapi->getReadPtr(prePre, 0), vsapi->getStride(prePre, 0), width, height, y0, b->vectorsPre, &d->search);
+		motionMaskRow(b->vectorsPre, b->motionPre, width, blockSize, d->motionThreshold, 8);
+	}
+
+	motionMaskRow(b->vectors, b->motion, width, blockSize, d->motionThreshold, 8);
+	compensateRows(prepy, preStride, b->compY, width, y0, rows, width, b->vectors, blockSize, 0, 0, 1);
+
+	for (int i = 0; i < rows; i++) {
+		int y = y0 + i;
+		const uint8_t *srcp = srcpy + y * stride;
+		uint8_t *dstp = dstpy + y * dstStride;
+		uint8_t *compp = b->compY + i * width;
+		uint8_t *nomotionp = b->nomotionMask + i * width;
+		uint8_t *temporalp = b->temporalMask + i * width;
+		uint8_t *spatialp = b->spatialMask + i * width;
+
+		d->errorRow(srcp, compp, b->compensationError, width, d->compensationThreshold);
+
+		// dot crawl in moving areas, for this frame and the previous one
+		int lines = d->dcLineDistance;
+
+		d->dotCrawlRow(srcp, y >= lines ? srcp - lines * stride : NULL, y < height - lines ? srcp + lines * stride : NULL, b->dotCrawl, width, d->dcThreshold);
+
+		d->andRow(b->dotCrawl, b->motion, b->dotCrawl, width);
+
+		if (prePre) {
+			const uint8_t *prep = prepy + y * preStride;
+
+			d->dotCrawlRow(prep, y >= lines ? prep - lines * preStride : NULL, y < height - lines ? prep + lines * preStride : NULL, b->dotCrawlPre, width, d->dcThreshold);
+
+			d->andRow(b->dotCrawlPre, b->motionPre, b->dotCrawlPre, width);
+		}
+		else {
+			// the frame before the first one is the first one, which has no motion
+			memset(b->dotCrawlPre, 0, width);
+		}
+
+		int cy = y >> ssH;
+
+		if (d->rainbowRow) {
+			d->rainbowRow(srcp, srcpu + cy * chromaStride, srcpv + cy * chromaStride, prepu + cy * preChromaStride, prepv + cy * preChromaStride,
+				b->rainbow, width, &d->rainbow);
+		}
+		else {
+			rainbowRowSubsampled_c(srcp, srcpu + cy * chromaStride, srcpv + cy * chromaStride, prepu + cy * preChromaStride, prepv + cy * preChromaStride,
+				b->rainbow, width, ssW, &d->rainbow);
+		}
+
+		combineMasksRow(b, nomotionp, temporalp, spatialp, width);
+
+		// temporal blend with the previous frame in static areas, then the compensated and blurred pixels
+		d->blurRow(srcp, b->blurred, width);
+		memcpy(dstp, srcp, width);
+		maskedMergeRow(dstp, prepy + y * preStride, nomotionp, width);
+		maskedMergeRow(dstp, compp, temporalp, width);
+		maskedMergeRow(dstp, b->blurred, spatialp, width);
+	}
+
+	// chroma planes use the luma masks averaged down to their resolution
+	int chromaWidth = vsapi->getFrameWidth(src, 1);
+	int chromaBlockWidth = blockSize >> ssW;
+
+	for (int i = 0; i < rows; i += 1 << ssH) {
+		int cy = (y0 + i) >> ssH;
+
+		subsampleMaskRow(b->nomotionMask + i * width, width, b->nomotionMaskC, chromaWidth, ssW, ssH);
+		subsampleMaskRow(b->temporalMask + i * width, width, b->temporalMaskC, chromaWidth, ssW, ssH);
+		subsampleMaskRow(b->spatialMask + i * width, width, b->spatialMaskC, chromaWidth, ssW, ssH);
+
+		for (int plane = 1; plane < fi->numPlanes; plane++) {
+			const uint8_t *srcp = vsapi->getReadPtr(src, plane) + cy * vsapi->getStride(src, plane);
+			const uint8_t *prepc = vsapi->getReadPtr(pre, plane);
+			int preStrideC = vsapi->getStride(pre, plane);
+			uint8_t *dstp = vsapi->getWritePtr(dst, plane) + cy * vsapi->getStride(dst, plane);
+
+			compensateRows(prepc, preStrideC, b->compC, 0, cy, 1, chromaWidth, b->vectors, chromaBlockWidth, ssW, ssH, 1);
+
+			if (d->blurRowChroma) {
+				d->blurRowChroma(srcp, b->blurredC, chromaWidth);
+			}
+			else {
+				blurRowTaps_c(srcp, b->blurredC, chromaWidth, 4 >> ssW);
+			}
+
+			memcpy(dstp, srcp, chromaWidth);
+			maskedMergeRow(dstp, prepc + cy * preStrideC, b->nomotionMaskC, chromaWidth);
+			maskedMergeRow(dstp, b->compC, b->temporalMaskC, chromaWidth);
+			maskedMergeRow(dstp, b->blurredC, b->spatialMaskC, chromaWidth);
+		}
+	}
+}
+
+// This is the main function that gets called when a frame should be produced. It will, in most cases, get
+// called several times to produce one frame. This state is being kept track of by the value of
+// activationReason. The first call to produce a certain frame n is always arInitial. In this state
+// you should request all the input frames you need. Always do it in ascending order to play nice with the
+// upstream filters.
+// Once all frames are ready, the filter will be called with arAllFramesReady. It is now time to
+// do the actual processing.
+static const VSFrameRef *VS_CC getFrame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+	UncrossData *d = (UncrossData *)* instanceData;
+
+	if (activationReason == arInitial) {
+		// Request the source frames on the first call. The dot crawl map of the previous frame
+		// needs its own motion mask, so two frames back are required.
+		if (n > 1) {
+			vsapi->requestFrameFilter(n - 2, d->node, frameCtx);
+		}
+		if (n > 0) {
+			vsapi->requestFrameFilter(n - 1, d->node, frameCtx);
+		}
+
+		vsapi->requestFrameFilter(n, d->node, frameCtx);
+	}
+	else if (activationReason == arAllFramesReady) {
+		const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+
+		if (n == 0) {
+			// no previous frame means no motion and no temporal artifacts, so every blend is a no-op
+			return src;
+		}
+
+		const VSFrameRef *pre = vsapi->getFrameFilter(n - 1, d->node, frameCtx);
+		const VSFrameRef *prePre = n > 1 ? vsapi->getFrameFilter(n - 2, d->node, frameCtx) : NULL;
+
+		// The reason we query this on a per frame basis is because we want our filter
+		// to accept clips with varying dimensions. If we reject such content using d->vi
+		// would be better.
+		const VSFormat *fi = d->vi->format;
+		int height = vsapi->getFrameHeight(src, 0);
+		int width = vsapi->getFrameWidth(src, 0);
+
+		// When creating a new frame for output it is VERY EXTREMELY SUPER IMPORTANT to
+		// supply the "dominant" source frame to copy properties from. Frame props
+		// are an essential part of the filter chain and you should NEVER break it.
+		VSFrameRef *dst = vsapi->newVideoFrame(fi, width, height, src, core);
+
+		BandBuffers b;
+		allocBandBuffers(&b, width, vsapi->getFrameWidth(src, 1), d->search.blockSize);
+
+		for (int y = 0; y < height; y += d->search.blockSize) {
+			processBand(src, pre, prePre, dst, y, &b, d, vsapi);
+		}
+
+		freeBandBuffers(&b);
+		vsapi->freeFrame(prePre);
+		vsapi->freeFrame(pre);
+		vsapi->freeFrame(src);
+		return dst;
+	}
+
+	return 0;
+}
+
+// Free all allocated data on filter destruction
+static void VS_CC freeResources(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+	UncrossData *d = (UncrossData *)instanceData;
+	vsapi->freeNode(d->node);
+	free(d);
+}
+
+// Read an optional non-negative integer argument. Returns 0 and sets an error on invalid input.
+static int getThreshold(const VSMap *in, VSMap *out, const char *name, int defaultValue, int *value, const VSAPI *vsapi) {
+	int err;
+
+	*value = int64ToIntS(vsapi->propGetInt(in, name, 0, &err));
+	if (err)
+		*value = defaultValue;
+
+	if (*value < 0) {
+		vsapi->setError(out, "Uncross: thresholds must be positive values");
+		return 0;
+	}
+
+	return 1;
+}
+
+// This function is responsible for validating arguments and creating a new filter
+static void VS_CC processCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+	UncrossData d;
+	UncrossData *data;
+	int err;
+
+	// Get a clip reference from the input arguments. This must be freed later.
+	d.node = vsapi->propGetNode(in, "clip", 0, 0);
+	d.vi = vsapi->getVideoInfo(d.node);
+
+	// In this first version we only want to handle 8bit integer formats. Note that
+	// vi->format can be 0 if the input clip can change format midstream.
+	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || d.vi->format->bitsPerSample != 8) {
+		vsapi->setError(out, "Uncross: only constant format 8-bit integer input supported");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	if (d.vi->format->colorFamily != cmYUV) {
+		vsapi->setError(out, "Uncross: YUV input is required");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	// Defaults are those of the individual detection filters.
+	if (!getThreshold(in, out, "dcthreshold", 2, &d.dcThreshold, vsapi)
+		|| !getThreshold(in, out, "threshY", 10, &d.rainbow.threshY, vsapi)
+		|| !getThreshold(in, out, "threshU1", 5, &d.rainbow.threshU1, vsapi)
+		|| !getThreshold(in, out, "threshV1", 5, &d.rainbow.threshV1, vsapi)
+		|| !getThreshold(in, out, "threshU2", 20, &d.rainbow.threshU2, vsapi)
+		|| !getThreshold(in, out, "threshV2", 20, &d.rainbow.threshV2, vsapi)
+		|| !getThreshold(in, out, "mthreshold", 1, &d.motionThreshold, vsapi)
+		|| !getThreshold(in, out, "mcthreshold", 16, &d.compensationThreshold, vsapi)) {
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	if (d.rainbow.threshU2 < d.rainbow.threshU1 || d.rainbow.threshV2 < d.rainbow.threshV1) {
+		vsapi->setError(out, "Uncross: thresh2 must be greater than thresh1");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	d.search.blockSize = int64ToIntS(vsapi->propGetInt(in, "blksize", 0, &err));
+	if (err)
+		d.search.blockSize = 4;
+
+	if (d.search.blockSize != 4 && d.search.blockSize != 8 && d.search.blockSize != 16 && d.search.blockSize != 32) {
+		vsapi->setError(out, "Uncross: blksize must be 4, 8, 16 or 32");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	d.search.range = int64ToIntS(vsapi->propGetInt(in, "range", 0, &err));
+	if (err)
+		d.search.range = 2;
+
+	if (d.search.range < 0) {
+		vsapi->setError(out, "Uncross: range must be a positive value");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	CpuLevel cpu;
+
+	if (!parseCpuLevel(vsapi->propGetData(in, "opt", 0, &err), &cpu)) {
+		vsapi->setError(out, "Uncross: opt must be auto, c, sse2, ssse3, avx2 or avx512bw, and supported by the CPU");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	DotCrawlSystem system;
+
+	if (!parseDotCrawlSystem(vsapi->propGetData(in, "system", 0, &err), &system)) {
+		vsapi->setError(out, "Uncross: system must be ntsc-4fsc, ntsc-13.5 or pal-4.43");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	initRainbowRanges(&d.rainbow, 8);
+	initMotionSearch(&d.search, 8, cpu);
+	d.dcLineDistance = dotCrawlLineDistance(system);
+	d.dotCrawlRow = selectDotCrawlRow(system, 8, cpu);
+	d.rainbowRow = d.vi->format->subSamplingW <= 1 ? selectRainbowRow(d.vi->format->subSamplingW, 8, cpu) : NULL;
+	d.errorRow = selectCompensationErrorRow(8, cpu);
+	d.blurRow = selectBlurRow(0, 8, cpu);
+	d.blurRowChroma = d.vi->format->subSamplingW <= 1 ? selectBlurRow(d.vi->format->subSamplingW, 8, cpu) : NULL;
+	d.andRow = selectLogicRow(logicAnd, cpu);
+
+	// I usually keep the filter data struct on the stack and don't allocate it
+	// until all the input validation is done.
+	data = malloc(sizeof(d));
+	*data = d;
+
+	// Creates a new filter and returns a reference to it. Always pass on the in and out
+	// arguments or unexpected things may happen. The name should be something that's
+	// easy to connect to the filter, like its function name.
+	// The three function pointers handle initialization, frame processing and filter destruction.
+	// The filtermode is very important to get right as it controls how threading of the filter
+	// is handled. In general you should only use fmParallel whenever possible. This is if you
+	// need to modify no shared data at all when the filter is running.
+	// For more complicated filters, fmParallelRequests is usually easier to achieve as it can
+	// be prefetched in parallel but the actual processing is serialized.
+	// The others can be considered special cases where fmSerial is useful to source filters and
+	// fmUnordered is useful when a filter's state may change even when deciding which frames to
+	// prefetch (such as a cache filter).
+	// If your filter is really fast (such as a filter that only resorts frames) you should set the
+	// nfNoCache flag to make the caching work smoother.
+	vsapi->createFilter(in, out, "Uncross", init, getFrame, freeResources, fmParallel, 0, data, core);
+}
+
+//////////////////////////////////////////
+// Mask operators
+
+typedef struct {
+	VSNodeRef **nodes;
+	int numNodes;
+	const VSVideoInfo *vi;
+	LogicOp op;
+	int skip; // trust the summaries of the input frames, skip=1
+	LogicRowFunc logicRow;
+	CountMaskRowFunc countMaskRow;
+	CountMaskRowFunc countPackedMaskRow;
+} LogicData;
+
+static const char *logicNames[] = { "And", "Or", "Xor", "AndNot", "Not" };
+
+// The unpacked width of a packed mask, or 0 for a mask of one sample per pixel.
+static int64_t getPackedWidth(const VSFrameRef *frame, const VSAPI *vsapi) {
+	int err;
+	int64_t width = vsapi->propGetInt(vsapi->getFramePropsRO(frame), PACKED_WIDTH_PROP, 0, &err);
+	return err ? 0 : width;
+}
+
+static void VS_CC logicInit(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
+	LogicData *d = (LogicData *)* instanceData;
+	vsapi->setVideoInfo(d->vi, 1, node);
+}
+
+// The clip whose frame is the result as is, judging from the flagged pixel counts of the summaries of
+// the frames (-1 without one), or -1 when the frames have to be combined. Masks without flagged
+// pixels are all 0 in their luma plane, so they absorb And and drop out of the other operators.
+static int passThroughClip(LogicOp op, const int64_t *flagged, int numNodes) {
+	if (op == logicNot)
+		return -1;
+
+	if (op == logicAnd) {
+		for (int i = 0; i < numNodes; i++) {
+			if (flagged[i] == 0)
+				return i;
+		}
+	}
+
+	if (op == logicAndNot && flagged[0] == 0)
+		return 0;
+
+	// the first clip unless another one is left, or the only other one when the first is clean
+	int other = -1;
+
+	for (int i = 1; i < numNodes; i++) {
+		if (flagged[i] != 0) {
+			if (other >= 0)
+				return -1;
+			other = i;
+		}
+	}
+
+	if (other < 0)
+		return 0;
+
+	return (op == logicOr || op == logicXor) && flagged[0] == 0 ? other : -1;
+}
+
+// Fold the clips into the output one row at a time: dst = ((a op b) op c) op ...
+// Packed masks are combined the same way, eight pixels per byte, and keep the properties of the first clip.
+// The luma plane of the result is summarized again, after clean frames have been used to skip the others
+// with skip=1. Without it the summaries of the inputs are not read, as if none had one.
+static const VSFrameRef *VS_CC logicGetFrame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+	LogicData *d = (LogicData *)* instanceData;
+
+	if (activationReason == arInitial) {
+		for (int i = 0; i < d->numNodes; i++) {
+			vsapi->requestFrameFilter(n, d->nodes[i], frameCtx);
+		}
+	}
+	else if (activationReason == arAllFramesReady) {
+		const VSFrameRef *first = vsapi->getFrameFilter(n, d->nodes[0], frameCtx);
+		int64_t packedWidth = getPackedWidth(first, vsapi);
+		int maskWidth = packedWidth ? (int)packedWidth : vsapi->getFrameWidth(first, 0);
+		int maskHeight = vsapi->getFrameHeight(first, 0);
+		int64_t *flagged = malloc(d->numNodes * sizeof *flagged);
+
+		flagged[0] = d->skip ? getMaskTileFlags(vsapi->getFramePropsRO(first), NULL, maskWidth, maskHeight, vsapi) : -1;
+
+		// packed and unpacked masks of the same format would be combined without an error otherwise
+		for (int i = 1; i < d->numNodes; i++) {
+			const VSFrameRef *frame = vsapi->getFrameFilter(n, d->nodes[i], frameCtx);
+			int mismatch = getPackedWidth(frame, vsapi) != packedWidth;
+
+			flagged[i] = d->skip ? getMaskTileFlags(vsapi->getFramePropsRO(frame), NULL, maskWidth, maskHeight, vsapi) : -1;
+			vsapi->freeFrame(frame);
+
+			if (mismatch) {
+				char msg[128];
+				snprintf(msg, sizeof(msg), "%s: packed masks can only be combined with packed masks of the same width", logicNames[d->op]);
+				vsapi->setFilterError(msg, frameCtx);
+				vsapi->freeFrame(first);
+				free(flagged);
+				return 0;
+			}
+		}
+
+		// a single mask is its own conjunction, disjunction and so on
+		int through = d->numNodes == 1 && d->op != logicNot ? 0 : passThroughClip(d->op, flagged, d->numNodes);
+
+		if (through >= 0) {
+			free(flagged);
+
+			if (through == 0)
+				return first;
+
+			vsapi->freeFrame(first);
+			return vsapi->getFrameFilter(n, d->nodes[through], frameCtx);
+		}
+
+		const VSFormat *fi = d->vi->format;
+		VSFrameRef *dst = vsapi->newVideoFrame(fi, vsapi->getFrameWidth(first, 0), vsapi->getFrameHeight(first, 0), first, core);
+
+		for (int plane = 0; plane < fi->numPlanes; plane++) {
+			int width = vsapi->getFrameWidth(dst, plane);
+			int height = vsapi->getFrameHeight(dst, plane);
+			int stride = vsapi->getStride(dst, plane);
+			uint8_t *dstp = vsapi->getWritePtr(dst, plane);
+			const uint8_t *ap = vsapi->getReadPtr(first, plane);
+			int aStride = vsapi->getStride(first, plane);
+
+			if (d->op == logicNot) {
+				for (int y = 0; y < height; y++) {
+					d->logicRow(ap + y * aStride, NULL, dstp + y * stride, width);
+				}
+				continue;
+			}
+
+			for (int i = 1; i < d->numNodes; i++) {
+				// clean masks change nothing but the result of And, which is passed through above
+				if (flagged[i] == 0)
+					continue;
+
+				const VSFrameRef *frame = vsapi->getFrameFilter(n, d->nodes[i], frameCtx);
+				const uint8_t *bp = vsapi->getReadPtr(frame, plane);
+				int bStride = vsapi->getStride(frame, plane);
+
+				for (int y = 0; y < height; y++) {
+					d->logicRow(ap + y * aStride, bp + y * bStride, dstp + y * stride, width);
+				}
+
+				// later clips are combined with the result so far
+				ap = dstp;
+				aStride = stride;
+				vsapi->freeFrame(frame);
+			}
+		}
+
+		// the summary copied from the first clip no longer holds
+		const uint8_t *dstp = vsapi->getReadPtr(dst, 0);
+		int stride = vsapi->getStride(dst, 0);
+		int *tileCounts = calloc((size_t)maskTileCount(maskWidth) * maskTileCount(maskHeight), sizeof *tileCounts);
+		CountMaskRowFunc countMaskRow = packedWidth ? d->countPackedMaskRow : d->countMaskRow;
+
+		for (int y = 0; y < maskHeight; y++) {
+			countMaskRow(dstp + y * stride, maskWidth, tileCounts + (y / MASK_TILE_SIZE) * maskTileCount(maskWidth));
+		}
+
+		setMaskTileProps(vsapi->getFramePropsRW(dst), tileCounts, maskWidth, maskHeight, vsapi);
+		free(tileCounts);
+		free(flagged);
+		vsapi->freeFrame(first);
+		return dst;
+	}
+
+	return 0;
+}
+
+static void freeLogicNodes(LogicData *d, const VSAPI *vsapi) {
+	for (int i = 0; i < d->numNodes; i++) {
+		vsapi->freeNode(d->nodes[i]);
+	}
+	free(d->nodes);
+}
+
+static void VS_CC logicFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+	LogicData *d = (LogicData *)instanceData;
+	freeLogicNodes(d, vsapi);
+	free(d);
+}
+
+// Creates And, Or, Xor, AndNot and Not, selected by userData. AndNot clears the bits of every
+// later clip from the first one. All clips must share the first clip's format and dimensions.
+static void VS_CC logicCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+	LogicData d;
+	LogicData *data;
+	CpuLevel cpu;
+	char msg[128];
+	int err;
+
+	d.op = (LogicOp)(intptr_t)userData;
+
+	if (d.op == logicNot) {
+		d.numNodes = 1;
+		d.nodes = malloc(sizeof(VSNodeRef *));
+		d.nodes[0] = vsapi->propGetNode(in, "clip", 0, 0);
+	}
+	else {
+		d.numNodes = vsapi->propNumElements(in, "clips");
+		d.nodes = malloc(d.numNodes * sizeof(VSNodeRef *));
+
+		for (int i = 0; i < d.numNodes; i++) {
+			d.nodes[i] = vsapi->propGetNode(in, "clips", i, 0);
+		}
+	}
+
+	d.vi = vsapi->getVideoInfo(d.nodes[0]);
+
+	if (!isConstantFormat(d.vi) || d.vi->format->sampleType != stInteger || d.vi->format->bitsPerSample != 8) {
+		snprintf(msg, sizeof(msg), "%s: only constant format 8-bit integer input supported", logicNames[d.op]);
+		vsapi->setError(out, msg);
+		freeLogicNodes(&d, vsapi);
+		return;
+	}
+
+	for (int i = 1; i < d.numNodes; i++) {
+		const VSVideoInfo *vi = vsapi->getVideoInfo(d.nodes[i]);
+
+		if (!isSameFormat(d.vi, vi)) {
+			snprintf(msg, sizeof(msg), "%s: all clips must have the same format and dimensions", logicNames[d.op]);
+			vsapi->setError(out, msg);
+			freeLogicNodes(&d, vsapi);
+			return;
+		}
+	}
+
+	if (!parseCpuLevel(vsapi->propGetData(in, "opt", 0, &err), &cpu)) {
+		snprintf(msg, sizeof(msg), "%s: opt must be auto, c, sse2, ssse3, avx2 or avx512bw, and supported by the CPU", logicNames[d.op]);
+		vsapi->setError(out, msg);
+		freeLogicNodes(&d, vsapi);
+		return;
+	}
+
+	// Not has no skip argument, and reads no summary either.
+	d.skip = !!vsapi->propGetInt(in, "skip", 0, &err);
+	d.logicRow = selectLogicRow(d.op, cpu);
+	d.countMaskRow = selectCountMaskRow(1, 0, cpu);
+	d.countPackedMaskRow = selectCountMaskRow(1, 1, cpu);
+
+	data = malloc(sizeof(d));
+	*data = d;
+
+	vsapi->createFilter(in, out, logicNames[d.op], logicInit, logicGetFrame, logicFree, fmParallel, 0, data, core);
+}
+
+typedef struct {
+	VSNodeRef *node;
+	VSVideoInfo vi; // the GRAY8 mask of the unpacked width
+	UnpackMaskRowFunc unpackRow;
+} UnpackData;
+
+static void VS_CC unpackInit(VSMap *in, VSMap *out, void **instanceData, VSNode *node, VSCore *core, const VSAPI *vsapi) {
+	UnpackData *d = (UnpackData *)* instanceData;
+	vsapi->setVideoInfo(&d->vi, 1, node);
+}
+
+// Expand a packed mask into a GRAY8 mask of 0 and 255.
+static const VSFrameRef *VS_CC unpackGetFrame(int n, int activationReason, void **instanceData, void **frameData, VSFrameContext *frameCtx, VSCore *core, const VSAPI *vsapi) {
+	UnpackData *d = (UnpackData *)* instanceData;
+
+	if (activationReason == arInitial) {
+		vsapi->requestFrameFilter(n, d->node, frameCtx);
+	}
+	else if (activationReason == arAllFramesReady) {
+		const VSFrameRef *src = vsapi->getFrameFilter(n, d->node, frameCtx);
+		int width = d->vi.width;
+		int height = d->vi.height;
+
+		if (getPackedWidth(src, vsapi) != width) {
+			char msg[128];
+			snprintf(msg, sizeof(msg), "Unpack: frame %d is not a packed mask of width %d", n, width);
+			vsapi->setFilterError(msg, frameCtx);
+			vsapi->freeFrame(src);
+			return 0;
+		}
+
+		VSFrameRef *dst = vsapi->newVideoFrame(d->vi.format, width, height, src, core);
+		const uint8_t *srcp = vsapi->getReadPtr(src, 0);
+		int srcStride = vsapi->getStride(src, 0);
+		uint8_t *dstp = vsapi->getWritePtr(dst, 0);
+		int dstStride = vsapi->getStride(dst, 0);
+
+		for (int y = 0; y < height; y++) {
+			d->unpackRow(srcp, dstp, width);
+			srcp += srcStride;
+			dstp += dstStride;
+		}
+
+		vsapi->propDeleteKey(vsapi->getFramePropsRW(dst), PACKED_WIDTH_PROP);
+		vsapi->freeFrame(src);
+		return dst;
+	}
+
+	return 0;
+}
+
+static void VS_CC unpackFree(void *instanceData, VSCore *core, const VSAPI *vsapi) {
+	UnpackData *d = (UnpackData *)instanceData;
+	vsapi->freeNode(d->node);
+	free(d);
+}
+
+// Creates Unpack. The width of the mask is not part of the format of a packed clip, so it defaults
+// to eight pixels per byte and must be passed for widths that are not a multiple of 8.
+static void VS_CC unpackCreate(const VSMap *in, VSMap *out, void *userData, VSCore *core, const VSAPI *vsapi) {
+	UnpackData d;
+	UnpackData *data;
+	CpuLevel cpu;
+	int err;
+
+	d.node = vsapi->propGetNode(in, "clip", 0, 0);
+	d.vi = *vsapi->getVideoInfo(d.node);
+
+	if (!isConstantFormat(&d.vi) || d.vi.format->id != pfGray8) {
+		vsapi->setError(out, "Unpack: only constant format GRAY8 packed masks supported");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	int width = int64ToIntS(vsapi->propGetInt(in, "width", 0, &err));
+	if (err)
+		width = d.vi.width * 8;
+
+	if (width <= 0 || packedRowBytes(width) != d.vi.width) {
+		vsapi->setError(out, "Unpack: width must round up to the width of the clip in bytes");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	if (!parseCpuLevel(vsapi->propGetData(in, "opt", 0, &err), &cpu)) {
+		vsapi->setError(out, "Unpack: opt must be auto, c, sse2, ssse3, avx2 or avx512bw, and supported by the CPU");
+		vsapi->freeNode(d.node);
+		return;
+	}
+
+	d.vi.width = width;
+	d.unpackRow = selectUnpackMaskRow(cpu);
+
+	data = malloc(sizeof(d));
+	*data = d;
+
+	vsapi->createFilter(in, out, "Unpack", unpackInit, unpackGetFrame, unpackFree, fmParallel, 0, data, core);
+}
+
+//////////////////////////////////////////
+// Init
+
+// This is the entry point that is called when a plugin is loaded. You are only supposed
+// to call the two provided functions here.
+// configFunc sets the id, namespace, and long name of the plugin (the last 3 arguments
+// never need to be changed for a normal plugin).
+//
+// id: Needs to be a "reverse" url and unique among all plugins.
+//   It is inspired by how android packages identify themselves.
+//   If you don't own a domain then make one up that's related
+//   to the plugin name.
+//
+// namespace: Should only use [a-z_] and not be too long.
+//
+// full name: Any name that describes the plugin nicely.
+//
+// registerFunc is called once for each function you want to register. Function names
+// should be PascalCase. The argument string has this format:
+// name:type; or name:type:flag1:flag2....;
+// All argument name should be lowercase and only use [a-z_].
+// The valid types are int,float,data,clip,frame,func. [] can be appended to allow arrays
+// of type to be passed (numbers:int[])
+// The available flags are opt, to make an argument optional, empty, which controls whether
+// or not empty arrays are accepted
+
+VS_EXTERNAL_API(void) VapourSynthPluginInit(VSConfigPlugin configFunc, VSRegisterFunction registerFunc, VSPlugin *plugin) {
+	// Kernels are selected per filter from the instruction set level of the CPU, detected once here.
+	initCpuLevel();
+	configFunc("github.com.rzumer.uncross", "uncross", "Uncross", VAPOURSYNTH_API_VERSION, 1, plugin);
+	registerFunc("Process", "clip:clip;dcthreshold:int:opt;threshY:int:opt;threshU1:int:opt;threshV1:int:opt;threshU2:int:opt;threshV2:int:opt;"
+		"mthreshold:int:opt;mcthreshold:int:opt;blksize:int:opt;range:int:opt;system:data:opt;opt:data:opt;", processCreate, 0, plugin);
+	registerFunc("And", "clips:clip[];skip:int:opt;opt:data:opt;", logicCreate, (void *)(intptr_t)logicAnd, plugin);
+	registerFunc("Or", "clips:clip[];skip:int:opt;opt:data:opt;", logicCreate, (void *)(intptr_t)logicOr, plugin);
+	registerFunc("Xor", "clips:clip[];skip:int:opt;opt:data:opt;", logicCreate, (void *)(intptr_t)logicXor, plugin);
+	registerFunc("AndNot", "clips:clip[];skip:int:opt;opt:data:opt;", logicCreate, (void *)(intptr_t)logicAndNot, plugin);
+	registerFunc("Not", "clip:clip;opt:data:opt;", logicCreate, (void *)(intptr_t)logicNot, plugin);
+	registerFunc("Unpack", "clip:clip;width:int:opt;opt:data:opt;", unpackCreate, 0, plugin);
+}